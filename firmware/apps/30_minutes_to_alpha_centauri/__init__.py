@@ -6,6 +6,7 @@ os.chdir("/system/apps/30_minutes_to_alpha_centauri")
 
 import math
 import random
+from array import array
 from badgeware import run
 import cutscene
 import time
@@ -26,8 +27,9 @@ class GameState:
     WIN_SCREEN = 4
 
 
-# It's a bit quicker to just store the diferent brightnesses for the distance shadow, so we list them here.
-BRIGHTNESSES = (3.1875, 6.375, 9.5625, 12.75, 15.9375, 19.125, 22.3125, 25.5, 28.6875, 31.875, 35.0625, 38.25, 41.4375, 44.625, 47.8125, 51, 54.1875, 57.375, 60.5625, 63.75, 66.9375, 70.125, 73.3125, 76.5, 79.6875, 82.875, 86.0625, 89.25, 92.4375, 95.625, 98.8125, 102, 105.1875, 108.375, 111.5625, 114.75, 117.9375, 121.125, 124.3125, 127.5, 130.6875, 133.875, 137.0625, 140.25, 143.4375, 146.625, 149.8125, 153, 156.1875, 159.375, 162.5625, 165.75, 168.9375, 172.125, 175.3125, 178.5, 181.6875, 184.875, 188.0625, 191.25, 194.4375, 197.625, 200.8125, 204, 207.1875, 210.375, 213.5625, 216.75, 219.9375, 223.125, 226.3125, 229.5, 232.6875, 235.875, 239.0625, 242.25, 245.4375, 248.625, 251.8125, 255, 255, 251.8125, 248.625, 245.4375, 242.25, 239.0625, 235.875, 232.6875, 229.5, 226.3125, 223.125, 219.9375, 216.75, 213.5625, 210.375, 207.1875, 204, 200.8125, 197.625, 194.4375, 191.25, 188.0625, 184.875, 181.6875, 178.5, 175.3125, 172.125, 168.9375, 165.75, 162.5625, 159.375, 156.1875, 153, 149.8125, 146.625, 143.4375, 140.25, 137.0625, 133.875, 130.6875, 127.5, 124.3125, 121.125, 117.9375, 114.75, 111.5625, 108.375, 105.1875, 102, 98.8125, 95.625, 92.4375, 89.25, 86.0625, 82.875, 79.6875, 76.5, 73.3125, 70.125, 66.9375, 63.75, 60.5625, 57.375, 54.1875, 51, 47.8125, 44.625, 41.4375, 38.25, 35.0625, 31.875, 28.6875, 25.5, 22.3125, 19.125, 15.9375, 12.75, 9.5625, 6.375, 3.1875)
+# Brightness of the walls by the height of each column on screen, taller columns are nearer so get more light.
+# This is applied by vspan_tex_batch() as it draws so we don't need to darken the walls afterwards.
+WALL_SHADE = bytes(min(255, int(h * 1.59375)) for h in range(161))
 TEXTURE_SIZE = 64
 
 # Here we're setting up texture packs that will be filled in when the game selects a level.
@@ -354,23 +356,21 @@ def create_centre_points():
     return segments
 
 
-# Takes four points and draws vertical strips between them, sampling the texture for each one.
-# It then also draws a semitransparent black line over it to darken the texture more toward the centre of the screen.
+# Takes four points and works out the vertical strips between them, then draws them all sampling the texture in one go.
+# The strips are darkened more toward the centre of the screen (where they're shorter) by the WALL_SHADE table.
 @micropython.native
 def draw_wall(image, topleft, bottomleft, topright, bottomright, tex):
     width = topright.x - topleft.x
     tile = wall_tex.sprite(tex, 0)
+    columns = array("h")
     for i in range(width):
         x_pos = math.floor(topleft.x + i)
         if x_pos > 0 and x_pos < screen.width:
             t = i / width
-            toppoint = topleft.y + ((topright.y - topleft.y) * t)
+            toppoint = math.floor(topleft.y + ((topright.y - topleft.y) * t))
             bottompoint = math.floor(bottomleft.y + ((bottomright.y - bottomleft.y) * t))
-            u = t * TEXTURE_SIZE
-            image.vspan_tex(tile, x_pos, toppoint, bottompoint - toppoint, u, 0, u, TEXTURE_SIZE - 1)
-            seg_brightness = BRIGHTNESSES[x_pos]
-            screen.pen = color.rgb(0, 0, 0, seg_brightness)
-            screen.line(vec2(x_pos, toppoint), vec2(x_pos, bottompoint))
+            columns.extend((x_pos, toppoint, bottompoint - toppoint, int(t * TEXTURE_SIZE)))
+    image.vspan_tex_batch(tile, columns, WALL_SHADE)
 
 
 # Just calculates the time since the start of gameplay.
@@ -4,7 +4,7 @@ skull = image.load("/system/assets/skull.png")
 
 def update():
   t = mat3().translate(-12, -12).rotate(io.ticks / 100).translate(80, 60).scale(math.sin(io.ticks / 1000) * 4)
-  imgbrush = brush.image(skull, t)
+  imgbrush = brush.image(skull, t, True)  # tile the skull across the circle
 
   screen.pen = imgbrush
   screen.shape(shape.circle(80, 60, 50))
@@ -0,0 +1,29 @@
+import math
+
+# a fountain of sparks, integrated and drawn natively
+sparks = particles(400)
+sparks.gravity = vec2(0, 120)
+sparks.colors = [
+  color.rgb(255, 255, 200),
+  color.rgb(255, 180, 40),
+  color.rgb(200, 40, 20, 160),
+  color.rgb(80, 20, 20, 0)
+]
+
+last = None
+
+
+def update():
+  global last
+
+  dt = 0 if last is None else (io.ticks - last) / 1000
+  last = io.ticks
+
+  t = io.ticks / 1000
+  origin = vec2(screen.width / 2 + math.sin(t) * 40, screen.height - 10)
+  sparks.emit(8, origin, vec2(math.sin(t * 3) * 20, -110), 30, 1.2, 0.4)
+  sparks.update(dt)
+
+  screen.pen = color.rgb(0, 0, 0)
+  screen.clear()
+  sparks.draw(screen, 1)
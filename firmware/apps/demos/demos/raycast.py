@@ -1,4 +1,5 @@
 from picovector import algorithm
+from array import array
 import math
 
 
@@ -72,6 +73,15 @@ def clear(buf: ptr32, length: int):
 
 d_proj = (screen.width / 2) / math.tan(player.fov * (math.pi / 180) / 2)
 
+# brightness for each on screen wall height, fading out with distance
+wall_shade = bytes(255 - min(255, int(20 * d_proj / max(h, 1))) for h in range(screen.height + 1))
+sky = color.rgb(128, 128, 255)
+ground = color.rgb(60, 60, 60)
+
+# distance, x, y, tile, edge and offset of the wall hit in each column
+HIT_FIELDS = 6
+hits = array("f", bytes(screen.width * HIT_FIELDS * 4))
+
 
 @micropython.native
 def update():
@@ -94,26 +104,16 @@ def update():
     minimap_overlay.line(minimap_pos, minimap_pos + player.vector(offset = -player.fov / 2, length=2.5 * minimap_scale))
     minimap_overlay.line(minimap_pos, minimap_pos + player.vector(offset = player.fov / 2, length=2.5 * minimap_scale))
 
-  # draw the sky
-  screen.pen = color.rgb(128, 128, 255)
-  screen.rectangle(0, 0, screen.width, screen.height / 2)
-
-  # cast rays for player sight
-  num_rays = screen.width
-  result = algorithm.dda(player.pos, player.angle, player.fov, num_rays, 20, world_map, MAP_SIZE_X, MAP_SIZE_Y)
-
-  for screen_x, ray in enumerate(result):
-    for (tile_id, cb_p, _cb_g, _edge, _offset, distance) in ray:
-      if tile_id == 1:
-          height = (2 / distance) * d_proj
-          b = min(255, distance * 20)
-          screen.pen = color.rgb(255 - b, 255 - b, 255 - b)
-          screen.rectangle(screen_x, (screen.height / 2) - (height / 2), 1, height)
-
-          if display_minimap:
-            minimap_overlay.pen = color.rgb(255, 255, 255, b)
-            minimap_overlay.put(cb_p * minimap_scale)
-          break
+  algorithm.raycast(screen, world_map, MAP_SIZE_X, MAP_SIZE_Y, player.pos, player.angle, player.fov,
+                    walls=color.rgb(255, 255, 255), floor=ground, ceiling=sky,
+                    max_steps=20, hits=hits, shade=wall_shade)
+
+  if display_minimap:
+    # mark where every fourth ray hit a wall
+    for i in range(0, len(hits), HIT_FIELDS * 4):
+      if hits[i + 3]:
+        minimap_overlay.pen = color.rgb(255, 255, 255, min(255, int(hits[i] * 20)))
+        minimap_overlay.put(vec2(hits[i + 1], hits[i + 2]) * minimap_scale)
 
   if display_minimap:
     # draw the minimap over the top
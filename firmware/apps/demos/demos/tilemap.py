@@ -0,0 +1,34 @@
+import math
+import random
+
+TILE = 8
+MAP_W = 64
+MAP_H = 48
+
+# build a small tileset of four coloured tiles
+tileset = image(TILE * 4, TILE)
+for i, (r, g, b) in enumerate(((40, 120, 40), (60, 160, 60), (120, 90, 50), (70, 70, 200))):
+  tileset.pen = color.rgb(r, g, b)
+  tileset.rectangle(i * TILE, 0, TILE, TILE)
+  tileset.pen = color.rgb(r // 2, g // 2, b // 2)
+  tileset.rectangle(i * TILE, TILE - 1, TILE, 1)
+  tileset.rectangle(i * TILE + TILE - 1, 0, 1, TILE)
+
+random.seed(1)
+world = bytearray(random.randint(1, 4) for _ in range(MAP_W * MAP_H))
+
+# only cells that change or scroll into view are redrawn into the cache
+level = tilemap(tileset, TILE, TILE, world, MAP_W, True)
+
+
+def update():
+  t = io.ticks / 1000
+  scroll = vec2(
+    (math.sin(t / 3) + 1) * (MAP_W * TILE - screen.width) / 2,
+    (math.cos(t / 4) + 1) * (MAP_H * TILE - screen.height) / 2
+  )
+
+  # animate some water
+  world[random.randint(0, len(world) - 1)] = 4
+
+  level.draw(screen, scroll)
@@ -1,3 +1,4 @@
+from array import array
 from badgeware import SpriteSheet
 from obstacle import Obstacle
 
@@ -5,6 +6,10 @@ sprites = SpriteSheet("assets/chicken.png", 7, 2)
 alive = sprites.animation(0, 0, 7)
 dead = sprites.animation(0, 1, 5)
 
+# the obstacles' hit boxes, rebuilt every frame
+obstacle_grid = collision_grid(32, 64)
+hits = array("H", [0])
+
 
 class Chicken:
     def __init__(self):
@@ -40,22 +45,18 @@ class Chicken:
 
         self.last_update = io.ticks
 
-        # check if we've passed or hit any obstacles
-        chicken_bounds = self.bounds()
+        # check if we've hit any obstacles, their hit boxes go into a collision
+        # grid so chicken's hit box is only tested against the ones nearby
+        obstacle_grid.clear()
         for obstacle in Obstacle.obstacles:
-            # perform an intersection test between chicken's hit box and the hit box
-            # of this obstacles top and bottom sections
             for obstacle_bounds in obstacle.bounds():
-                x1 = max(obstacle_bounds[0], chicken_bounds[0])
-                y1 = max(obstacle_bounds[1], chicken_bounds[1])
-                x2 = min(
-                    obstacle_bounds[0] + obstacle_bounds[2], chicken_bounds[0] + chicken_bounds[2])
-                y2 = min(
-                    obstacle_bounds[1] + obstacle_bounds[3], chicken_bounds[1] + chicken_bounds[3])
+                obstacle_grid.add(0, rect(*obstacle_bounds))
 
-                if x1 < x2 and y1 < y2:  # true if the two bounds overlap
-                    self.die()
+        if obstacle_grid.query(rect(*self.bounds()), hits):
+            self.die()
 
+        # check if we've passed any obstacles
+        for obstacle in Obstacle.obstacles:
             # if we haven't passed this obstacle before but we are past it now then
             # let's have some sweet sweet points!
             if not obstacle.passed and obstacle.x < self.pos[0] - 16:
@@ -11,4 +11,37 @@ namespace picovector {
 
   //typedef bool (*dda_callback_t)(float, float, int, int, int, float, float);
   void dda(vec2_t p, vec2_t v, dda_callback_t cb);
+
+  class image_t;
+
+  // a wall, floor or ceiling for raycast(), drawn with `texture` if there is
+  // one or filled with `color` (premultiplied) if not
+  struct raycast_surface_t {
+    image_t *texture = nullptr;
+    uint32_t color = 0xffffffff;
+  };
+
+  struct raycast_camera_t {
+    vec2_t p;
+    float angle;    // in degrees
+    float fov;      // horizontal, in degrees
+    int max_steps;  // grid cells a ray may cross before giving up
+  };
+
+  // what the ray for one column hit. all floats so a buffer of them can be
+  // read from python as a flat array("f")
+  struct raycast_hit_t {
+    float distance; // perpendicular to the camera plane
+    float x;
+    float y;
+    float tile;     // map value, 0 if nothing was hit
+    float edge;     // 0=top, 1=right, 2=bottom, 3=left
+    float offset;   // 0..1 along the edge
+  };
+
+  int raycast_columns(image_t *target);
+  void raycast(image_t *target, const uint8_t *map, int map_w, int map_h, const raycast_camera_t &camera,
+               const raycast_surface_t *walls, int wall_count,
+               const raycast_surface_t *floor, const raycast_surface_t *ceiling,
+               const uint8_t *shade, int shade_count, raycast_hit_t *hits);
 }
\ No newline at end of file
@@ -0,0 +1,324 @@
+#include <math.h>
+#include "algorithms.hpp"
+#include "../image.hpp"
+#include "../blit.hpp"
+
+namespace picovector {
+
+  struct raycast_view_t {
+    int x, y, w, h;   // the target's clip rect, one ray per column
+    float cy;         // horizon
+    float d_proj;     // distance to the projection plane in pixels
+    vec2_t p;
+    vec2_t dir;
+    vec2_t plane;     // half the camera plane, dir +/- plane are the edge rays
+  };
+
+  // calls `f` with a null pointer of the target's pixel type
+  template<typename F>
+  static void raycast_dispatch_target(image_t *target, F f) {
+    switch(target->pixel_format()) {
+      case RGBA8888: f((uint32_t *)nullptr); break;
+      case RGB565:   f((uint16_t *)nullptr); break;
+      case A8:       f((uint8_t *)nullptr); break;
+      default: break;
+    }
+  }
+
+  static uint32_t raycast_shade(const uint8_t *shade, int shade_count, int h) {
+    return shade_count > 0 ? shade[std::clamp(h, 0, shade_count - 1)] : 255;
+  }
+
+  template<typename T>
+  static void raycast_fill_column(image_t *target, int x, int y0, int y1, uint32_t c) {
+    T *pd = (T *)target->ptr(x, y0);
+    int stride = target->row_stride() / sizeof(T);
+    blend_func_t bf = target->_blend_func;
+    for(int y = y0; y < y1; y++) {
+      _blend_pixel(pd, bf, _r(c), _g(c), _b(c), _a(c));
+      pd += stride;
+    }
+  }
+
+  /*
+    draws the floor (or ceiling) a row at a time into the pixels that the
+    walls left uncovered in columns i0 to i1 of the view, `edges` holds the
+    first pixel below (or the last pixel above) the wall in each of them.
+
+    the world position under each pixel of a row steps linearly so textures
+    are walked in 16:16 fixed point, wrapping every map cell. rows are shaded
+    as if they were a wall at the same distance.
+  */
+  template<typename T, typename S>
+  static void raycast_plane(const S &fetch, uint32_t alpha, image_t *tex, image_t *target, const raycast_view_t &view, int i0, int i1, const int16_t *edges, bool floor, const uint8_t *shade, int shade_count) {
+    const raycast_view_t &vp = view;
+    blend_func_t bf = target->_blend_func;
+
+    float tw = 0.0f, th = 0.0f;
+    if(tex) {
+      tw = tex->bounds().w;
+      th = tex->bounds().h;
+    }
+
+    for(int y = vp.y; y < vp.y + vp.h; y++) {
+      // pixels between this row and the horizon, the eye is half a wall up
+      float p = floor ? (y + 0.5f) - view.cy : view.cy - (y + 0.5f);
+      if(p <= 0.0f) {
+        continue;
+      }
+
+      float row_distance = 0.5f * view.d_proj / p;
+      uint32_t sh = raycast_shade(shade, shade_count, int(p * 2.0f));
+      T *pd = (T *)target->ptr(vp.x + i0, y);
+
+      if(!tex) {
+        uint32_t c = sh != 255 ? _premul_shade(fetch(0), sh) : fetch(0);
+        for(int i = 0; i < i1 - i0; i++) {
+          if(floor ? y >= edges[i] : y < edges[i]) {
+            _blend_pixel(pd + i, bf, _r(c), _g(c), _b(c), _a(c));
+          }
+        }
+        continue;
+      }
+
+      vec2_t w = view.p + (view.dir + view.plane * (1.0f / vp.w - 1.0f)) * row_distance;
+      vec2_t step = view.plane * (2.0f / vp.w) * row_distance;
+
+      float fu = w.x * tw;
+      float fv = w.y * th;
+      fu -= floorf(fu / tw) * tw;
+      fv -= floorf(fv / th) * th;
+
+      fx16_t tw16 = int(tw) << 16;
+      fx16_t th16 = int(th) << 16;
+      fx16_t u = std::clamp(fx16_t(fu * 65536.0f), 0, tw16 - 1);
+      fx16_t v = std::clamp(fx16_t(fv * 65536.0f), 0, th16 - 1);
+      fx16_t du = fx16_t(fmodf(step.x * tw, tw) * 65536.0f);
+      fx16_t dv = fx16_t(fmodf(step.y * th, th) * 65536.0f);
+
+      // skip to column i0, the same as stepping there and wrapping each time
+      u = fx16_t((int64_t(u) + int64_t(du) * i0) % tw16);
+      v = fx16_t((int64_t(v) + int64_t(dv) * i0) % th16);
+      if(u < 0) u += tw16;
+      if(v < 0) v += th16;
+
+      for(int i = 0; i < i1 - i0; i++) {
+        if(floor ? y >= edges[i] : y < edges[i]) {
+          uint32_t c = fetch(*(const typename S::pixel_t *)tex->ptr(u >> 16, v >> 16));
+          if(sh != 255) c = _premul_shade(c, sh);
+          if(alpha != 255) c = _premul_mul_alpha(c, alpha);
+          _blend_pixel(pd + i, bf, _r(c), _g(c), _b(c), _a(c));
+        }
+
+        u += du;
+        if(u >= tw16) u -= tw16; else if(u < 0) u += tw16;
+        v += dv;
+        if(v >= th16) v -= th16; else if(v < 0) v += th16;
+      }
+    }
+  }
+
+  // returns a flat colour as if it were a pixel so raycast_plane() can fill
+  // untextured floors and ceilings
+  struct fetch_flat_t {
+    typedef uint32_t pixel_t;
+    uint32_t c;
+    inline uint32_t operator()(uint32_t) const { return c; }
+  };
+
+  static void raycast_surface(image_t *target, const raycast_surface_t *surface, const raycast_view_t &view, int i0, int i1, const int16_t *edges, bool floor, const uint8_t *shade, int shade_count) {
+    if(!surface) {
+      return;
+    }
+
+    if(surface->texture) {
+      blit_dispatch(surface->texture, target, [&](const auto &fetch, uint32_t alpha, auto *dst_type) {
+        typedef typename std::remove_pointer<decltype(dst_type)>::type T;
+        raycast_plane<T>(fetch, alpha, surface->texture, target, view, i0, i1, edges, floor, shade, shade_count);
+      });
+      return;
+    }
+
+    raycast_dispatch_target(target, [&](auto *dst_type) {
+      typedef typename std::remove_pointer<decltype(dst_type)>::type T;
+      raycast_plane<T>(fetch_flat_t{surface->color}, 255, nullptr, target, view, i0, i1, edges, floor, shade, shade_count);
+    });
+  }
+
+  // the whole pixels inside the target's clip rect
+  static void raycast_viewport(image_t *target, raycast_view_t &view) {
+    rect_t clip = target->clip().intersection(target->bounds());
+    view.x = ceilf(clip.x);
+    view.y = ceilf(clip.y);
+    view.w = std::max(int(floorf(clip.x + clip.w)) - view.x, 0);
+    view.h = std::max(int(floorf(clip.y + clip.h)) - view.y, 0);
+  }
+
+  // how many columns (and so hits) raycast() will produce for a target
+  int raycast_columns(image_t *target) {
+    raycast_view_t view;
+    raycast_viewport(target, view);
+    return view.h > 0 ? view.w : 0;
+  }
+
+  /*
+    renders a first person view of a grid map into the target's clip rect,
+    casting one ray per column with dda().
+
+    any non zero map value is a wall, drawn with walls[value - 1] (values past
+    the end of the list use the last entry). textures are stretched across
+    each face of a map cell and the floor and ceiling are tiled once per cell,
+    either can be null to leave those pixels alone. `shade` is an optional
+    brightness table indexed by the on screen height of a wall, as used by
+    image_t::vspan_tex_batch(), and also shades the floor and ceiling.
+
+    if `hits` isn't null it receives what each column's ray hit.
+
+    the view is drawn in strips of PV_RAYCAST_STRIP columns so the per column
+    state fits on the stack, with the textured walls in each strip drawn with
+    one vspan_tex_batch() per texture.
+  */
+  void raycast(image_t *target, const uint8_t *map, int map_w, int map_h, const raycast_camera_t &camera,
+               const raycast_surface_t *walls, int wall_count,
+               const raycast_surface_t *floor, const raycast_surface_t *ceiling,
+               const uint8_t *shade, int shade_count, raycast_hit_t *hits) {
+    raycast_view_t view;
+    raycast_viewport(target, view);
+    if(view.w <= 0 || view.h <= 0) {
+      return;
+    }
+
+    float a = camera.angle * (M_PI / 180.0f);
+    float half_fov = tanf(camera.fov * (M_PI / 180.0f) / 2.0f);
+    view.p = camera.p;
+    view.dir = vec2_t(cosf(a), sinf(a));
+    view.plane = vec2_t(-view.dir.y, view.dir.x) * half_fov;
+    view.d_proj = (view.w / 2.0f) / half_fov;
+    view.cy = view.y + view.h / 2.0f;
+
+    int y0 = view.y;
+    int y1 = view.y + view.h;
+    int horizon = std::clamp(int(floorf(view.cy + 0.5f)), y0, y1);
+
+    // the top and bottom of the wall in each column of a strip, used to skip
+    // covered floor and ceiling pixels
+    int16_t tops[PV_RAYCAST_STRIP];
+    int16_t bottoms[PV_RAYCAST_STRIP];
+
+    // the textured wall columns of a strip and the texture of each
+    vspan_t spans[PV_RAYCAST_STRIP];
+    image_t *textures[PV_RAYCAST_STRIP];
+
+    target->mark_dirty();
+
+    // state shared with the dda() callback, captured by a single reference so
+    // the std::function doesn't need to allocate
+    struct {
+      const uint8_t *map;
+      int map_w, map_h;
+      int steps, max_steps;
+      raycast_hit_t hit;
+    } ray;
+    ray.map = map;
+    ray.map_w = map_w;
+    ray.map_h = map_h;
+    ray.max_steps = camera.max_steps;
+
+    for(int i0 = 0; i0 < view.w; i0 += PV_RAYCAST_STRIP) {
+      int i1 = std::min(i0 + PV_RAYCAST_STRIP, view.w);
+      int span_count = 0;
+
+      for(int i = i0; i < i1; i++) {
+        int x = view.x + i;
+        int16_t &column_top = tops[i - i0];
+        int16_t &column_bottom = bottoms[i - i0];
+        float camera_x = (2.0f * i + 1.0f) / view.w - 1.0f;
+        vec2_t v = view.dir + view.plane * camera_x;
+
+        ray.steps = 0;
+        ray.hit = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+        dda(camera.p, v, [&ray](float hit_x, float hit_y, int gx, int gy, int edge, float offset, float distance) -> bool {
+          if(gx < 0 || gy < 0 || gx >= ray.map_w || gy >= ray.map_h) {
+            return false;
+          }
+
+          uint8_t tile = ray.map[gy * ray.map_w + gx];
+          if(tile) {
+            ray.hit = {distance, hit_x, hit_y, float(tile), float(edge), offset};
+            return false;
+          }
+
+          return ++ray.steps < ray.max_steps;
+        });
+
+        raycast_hit_t &hit = ray.hit;
+        if(hit.tile == 0.0f) {
+          column_top = column_bottom = horizon;
+          if(hits) {
+            hits[i] = hit;
+          }
+          continue;
+        }
+
+        // dda() measures along the ray, which isn't unit length, so this gives
+        // the distance to the camera plane and avoids fisheye distortion
+        hit.distance = std::max(hit.distance / sqrtf(v.x * v.x + v.y * v.y), 1e-3f);
+        if(hits) {
+          hits[i] = hit;
+        }
+
+        int h = std::min(int(view.d_proj / hit.distance + 0.5f), 16384);
+        int top = int(floorf(view.cy - h / 2.0f + 0.5f));
+        column_top = std::clamp(top, y0, y1);
+        column_bottom = std::clamp(top + h, y0, y1);
+
+        const raycast_surface_t *wall = nullptr;
+        if(wall_count > 0) {
+          wall = &walls[std::min(int(hit.tile), wall_count) - 1];
+        }
+
+        if(wall && wall->texture) {
+          // flip the faces seen while looking towards -x or +y so every
+          // texture reads left to right
+          int edge = hit.edge;
+          float offset = (edge == 0 || edge == 1) ? 1.0f - hit.offset : hit.offset;
+          int tw = wall->texture->bounds().w;
+          spans[span_count] = {int16_t(x), int16_t(top), int16_t(h), int16_t(std::clamp(int(offset * tw), 0, tw - 1))};
+          textures[span_count] = wall->texture;
+          span_count++;
+          continue;
+        }
+
+        if(column_top < column_bottom) {
+          uint32_t c = wall ? wall->color : 0xffffffff;
+          uint32_t sh = raycast_shade(shade, shade_count, h);
+          if(sh != 255) c = _premul_shade(c, sh);
+          raycast_dispatch_target(target, [&](auto *dst_type) {
+            typedef typename std::remove_pointer<decltype(dst_type)>::type T;
+            raycast_fill_column<T>(target, x, column_top, column_bottom, c);
+          });
+        }
+      }
+
+      // gather the spans of each texture together and draw them in one batch,
+      // the columns don't overlap so the order doesn't matter
+      for(int first = 0; first < span_count;) {
+        image_t *texture = textures[first];
+        int last = first;
+        for(int j = first; j < span_count; j++) {
+          if(textures[j] == texture) {
+            std::swap(spans[j], spans[last]);
+            std::swap(textures[j], textures[last]);
+            last++;
+          }
+        }
+        texture->vspan_tex_batch(target, spans + first, last - first, shade, shade_count);
+        first = last;
+      }
+
+      raycast_surface(target, floor, view, i0, i1, bottoms, true, shade, shade_count);
+      raycast_surface(target, ceiling, view, i0, i1, tops, false, shade, shade_count);
+    }
+  }
+
+}
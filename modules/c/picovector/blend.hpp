@@ -23,6 +23,16 @@ uint32_t _premul_mul_alpha(uint32_t c, uint32_t a) {
   return r | (g << 8) | (b << 16) | (a << 24);
 }
 
+// darkens a premultiplied packed color by `s` (255 leaves it unchanged)
+// without changing its alpha
+static inline __attribute__((always_inline))
+uint32_t _premul_shade(uint32_t c, uint32_t s) {
+  uint32_t r = (_r(c) * s + 128) >> 8;
+  uint32_t g = (_g(c) * s + 128) >> 8;
+  uint32_t b = (_b(c) * s + 128) >> 8;
+  return r | (g << 8) | (b << 16) | (c & 0xff000000u);
+}
+
 static inline __attribute__((always_inline))
 uint32_t _premul_mul_alpha_channel(uint32_t c, uint32_t a) {
   return (c * a + 128) >> 8;
@@ -49,6 +59,138 @@ static inline uint32_t blend_func_over(uint32_t dst, uint32_t r, uint32_t g, uin
     return r | (g << 8) | (b << 16) | (a << 24);
 }
 
+// linearly interpolates between two packed colors, `f` is the weight of `b`
+// from 0 to 255. red/blue and green/alpha are done in pairs with each channel
+// in its own 16-bit lane
+static inline __attribute__((always_inline))
+uint32_t _lerp_rgba8888(uint32_t a, uint32_t b, uint32_t f) {
+  uint32_t inv = 256u - f;
+  uint32_t rb = ((a & 0x00ff00ffu) * inv + (b & 0x00ff00ffu) * f) >> 8;
+  uint32_t ga = (((a >> 8) & 0x00ff00ffu) * inv + ((b >> 8) & 0x00ff00ffu) * f) >> 8;
+  return (rb & 0x00ff00ffu) | ((ga & 0x00ff00ffu) << 8);
+}
+
+/*
+
+  RGB565 helpers
+
+*/
+
+// packs 8-bit channels into an RGB565 value
+static inline __attribute__((always_inline))
+uint32_t _rgb565(uint32_t r, uint32_t g, uint32_t b) {
+  return ((r & 0xf8u) << 8) | ((g & 0xfcu) << 3) | (b >> 3);
+}
+
+// expands an RGB565 value into an opaque packed RGBA8888 color
+static inline __attribute__((always_inline))
+uint32_t _rgb565_to_rgba8888(uint32_t c) {
+  uint32_t r = (c >> 11) & 0x1fu;
+  uint32_t g = (c >>  5) & 0x3fu;
+  uint32_t b =  c        & 0x1fu;
+  r = (r << 3) | (r >> 2);
+  g = (g << 2) | (g >> 4);
+  b = (b << 3) | (b >> 2);
+  return r | (g << 8) | (b << 16) | 0xff000000u;
+}
+
+// blends a premultiplied color over an RGB565 pixel
+//
+// the destination is expanded back to 8-bit channels so the result matches
+// blend_func_over() before being packed, the cheaper trick of scaling all
+// three 565 fields with a single multiply loses too much precision once alpha
+// is cut down to fit between the fields
+static inline __attribute__((always_inline))
+uint16_t blend_over_rgb565(uint32_t dst, uint32_t r, uint32_t g, uint32_t b, uint32_t a) {
+  if (a == 0u)   return dst;
+  if (a == 255u) return _rgb565(r, g, b);
+
+  uint32_t d = _rgb565_to_rgba8888(dst);
+  uint32_t inva = 255u - a;
+
+  r += ((_r(d) * inva + 128u) >> 8);
+  g += ((_g(d) * inva + 128u) >> 8);
+  b += ((_b(d) * inva + 128u) >> 8);
+
+  return _rgb565(r, g, b);
+}
+
+/*
+
+  RGBA4444 helpers
+
+  channels are packed in the same order as RGBA8888 (red in the lowest
+  nibble, alpha in the highest) and are premultiplied
+
+*/
+
+// packs a premultiplied RGBA8888 color into RGBA4444
+static inline __attribute__((always_inline))
+uint32_t _rgba4444(uint32_t c) {
+  // rounding to the nearest nibble keeps each channel <= alpha
+  uint32_t r = (_r(c) * 15 + 128) / 255;
+  uint32_t g = (_g(c) * 15 + 128) / 255;
+  uint32_t b = (_b(c) * 15 + 128) / 255;
+  uint32_t a = (_a(c) * 15 + 128) / 255;
+  return r | (g << 4) | (b << 8) | (a << 12);
+}
+
+// expands an RGBA4444 value into a packed RGBA8888 color
+static inline __attribute__((always_inline))
+uint32_t _rgba4444_to_rgba8888(uint32_t c) {
+  // spread the nibbles into bytes then replicate each into both halves
+  c = (c & 0x000fu) | ((c & 0x00f0u) << 4) | ((c & 0x0f00u) << 8) | ((c & 0xf000u) << 12);
+  return c | (c << 4);
+}
+
+/*
+
+  A8 helpers
+
+*/
+
+// expands an alpha value into premultiplied white
+static inline __attribute__((always_inline))
+uint32_t _a8_to_rgba8888(uint32_t a) {
+  return a * 0x01010101u;
+}
+
+// writes a premultiplied color into a destination pixel of the matching
+// format (RGBA8888, RGB565 or A8), lets span functions be written once as
+// templates over the destination type
+static inline __attribute__((always_inline))
+void _blend_pixel(uint32_t *dst, blend_func_t bf, uint32_t r, uint32_t g, uint32_t b, uint32_t a) {
+  *dst = bf(*dst, r, g, b, a);
+}
+
+static inline __attribute__((always_inline))
+void _blend_pixel(uint16_t *dst, blend_func_t bf, uint32_t r, uint32_t g, uint32_t b, uint32_t a) {
+  *dst = blend_over_rgb565(*dst, r, g, b, a);
+}
+
+// A8 targets only accumulate coverage
+static inline __attribute__((always_inline))
+void _blend_pixel(uint8_t *dst, blend_func_t bf, uint32_t r, uint32_t g, uint32_t b, uint32_t a) {
+  *dst = a + ((*dst * (255u - a) + 128u) >> 8);
+}
+
+// writes a fully opaque premultiplied color into a destination pixel, no
+// blending needed
+static inline __attribute__((always_inline))
+void _store_pixel(uint32_t *dst, uint32_t c) {
+  *dst = c;
+}
+
+static inline __attribute__((always_inline))
+void _store_pixel(uint16_t *dst, uint32_t c) {
+  *dst = _rgb565(_r(c), _g(c), _b(c));
+}
+
+static inline __attribute__((always_inline))
+void _store_pixel(uint8_t *dst, uint32_t c) {
+  *dst = 255;
+}
+
 // // blends one rgba source pixel over a horizontal span of destination pixels
 // static inline __attribute__((always_inline))
 // void span_blend_rgba_rgba(uint8_t *dst, uint8_t *src, uint32_t w) {
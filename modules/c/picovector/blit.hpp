@@ -1,73 +1,452 @@
 #pragma once
 
 #include <stdint.h>
+#include <algorithm>
 
 #include "image.hpp"
 
 namespace picovector {
 
-  void span_blit(image_t *src, image_t *dst, blend_func_t bf, int sx, int sy, int dx, int dy, int w) {
-    uint32_t *ps = (uint32_t *)src->ptr(sx, sy);
-    uint32_t *pd = (uint32_t *)dst->ptr(dx, dy);
-    uint32_t src_alpha = src->alpha();
+  /*
+    source pixel readers, each converts one source pixel into a premultiplied
+    RGBA8888 color
+  */
 
-    while(w--) {
-      uint32_t c = *ps;
-      if(src->alpha() != 255) {
-        c = _premul_mul_alpha(c, src->alpha());
+  struct fetch_rgba8888_t {
+    typedef uint32_t pixel_t;
+    inline uint32_t operator()(pixel_t p) const { return p; }
+  };
+
+  struct fetch_rgb565_t {
+    typedef uint16_t pixel_t;
+    inline uint32_t operator()(pixel_t p) const { return _rgb565_to_rgba8888(p); }
+  };
+
+  struct fetch_rgba4444_t {
+    typedef uint16_t pixel_t;
+    inline uint32_t operator()(pixel_t p) const { return _rgba4444_to_rgba8888(p); }
+  };
+
+  struct fetch_a8_t {
+    typedef uint8_t pixel_t;
+    inline uint32_t operator()(pixel_t p) const { return _a8_to_rgba8888(p); }
+  };
+
+  // reads through a palette lookup table that already has any global alpha
+  // applied (see image_t::palette_lut())
+  struct fetch_palette_t {
+    typedef uint8_t pixel_t;
+    const uint32_t *palette;
+    inline uint32_t operator()(pixel_t p) const { return palette[p]; }
+  };
+
+  // T is the destination pixel type, S is a source pixel reader. `alpha` is
+  // the global alpha still to be applied to the fetched colors, `opacity` is
+  // what's known about the source's alpha channel. it must be
+  // OPACITY_GENERAL if any global alpha is applied by `fetch` or here.
+  template<typename T, typename S>
+  void span_blit(const S &fetch, uint32_t alpha, opacity_t opacity, image_t *src, image_t *dst, blend_func_t bf, int sx, int sy, int dx, int dy, int w) {
+    const typename S::pixel_t *ps = (const typename S::pixel_t *)src->ptr(sx, sy);
+    T *pd = (T *)dst->ptr(dx, dy);
+
+    if(alpha != 255) {
+      while(w--) {
+        uint32_t c = _premul_mul_alpha(fetch(*ps), alpha);
+        _blend_pixel(pd, bf, _r(c), _g(c), _b(c), _a(c));
+        pd++;
+        ps++;
+      }
+      return;
+    }
+
+    switch(opacity) {
+      case OPACITY_OPAQUE: {
+        while(w--) {
+          _store_pixel(pd, fetch(*ps));
+          pd++;
+          ps++;
+        }
+      } break;
+
+      case OPACITY_BINARY: {
+        while(w) {
+          // skip the transparent run
+          while(w && _a(fetch(*ps)) == 0) {
+            pd++;
+            ps++;
+            w--;
+          }
+          // and copy the opaque run
+          while(w) {
+            uint32_t c = fetch(*ps);
+            if(_a(c) == 0) break;
+            _store_pixel(pd, c);
+            pd++;
+            ps++;
+            w--;
+          }
+        }
+      } break;
+
+      default: {
+        while(w--) {
+          uint32_t c = fetch(*ps);
+          _blend_pixel(pd, bf, _r(c), _g(c), _b(c), _a(c));
+          pd++;
+          ps++;
+        }
+      } break;
+    }
+  }
+
+  template<typename T, typename S>
+  void span_blit_scale(const S &fetch, uint32_t alpha, opacity_t opacity, image_t *src, image_t *dst, blend_func_t bf, fx16_t sx, fx16_t sx_step, fx16_t sy, int dx, int dy, int w) {
+    const typename S::pixel_t *ps = (const typename S::pixel_t *)src->ptr(0, sy >> 16);
+    T *pd = (T *)dst->ptr(dx, dy);
+
+    if(alpha != 255) {
+      while(w--) {
+        uint32_t c = _premul_mul_alpha(fetch(*(ps + (sx >> 16))), alpha);
+        _blend_pixel(pd, bf, _r(c), _g(c), _b(c), _a(c));
+        pd++;
+        sx += sx_step;
+      }
+      return;
+    }
+
+    switch(opacity) {
+      case OPACITY_OPAQUE: {
+        while(w--) {
+          _store_pixel(pd, fetch(*(ps + (sx >> 16))));
+          pd++;
+          sx += sx_step;
+        }
+      } break;
+
+      case OPACITY_BINARY: {
+        while(w--) {
+          uint32_t c = fetch(*(ps + (sx >> 16)));
+          if(_a(c)) {
+            _store_pixel(pd, c);
+          }
+          pd++;
+          sx += sx_step;
+        }
+      } break;
+
+      default: {
+        while(w--) {
+          uint32_t c = fetch(*(ps + (sx >> 16)));
+          _blend_pixel(pd, bf, _r(c), _g(c), _b(c), _a(c));
+          pd++;
+          sx += sx_step;
+        }
+      } break;
+    }
+  }
+
+  /*
+    draws one row of a compiled image, only the pixels covered by runs are
+    read or written.
+
+    - ox: target x of the left edge of the source image
+    - x0, x1: horizontal clip range on the target
+    - store_opaque: opaque runs can be stored without blending, false when
+      global alpha has been applied (either here or by `fetch`)
+  */
+  template<typename T, typename S>
+  void span_blit_runs(const S &fetch, uint32_t alpha, bool store_opaque, const sprite_run_t *run, const sprite_run_t *end, image_t *src, image_t *dst, blend_func_t bf, int sy, int ox, int dy, int x0, int x1, bool flip_h) {
+    int sw = src->bounds().w;
+    int step = flip_h ? -1 : 1;
+
+    for(; run < end; run++) {
+      int tx = flip_h ? ox + sw - run->x - run->w : ox + run->x;
+      int tw = run->w;
+
+      // pixels clipped off the left of the run on the target
+      int skip = 0;
+      if(tx < x0) {
+        skip = x0 - tx;
+        tx = x0;
+        tw -= skip;
+      }
+      if(tx + tw > x1) {
+        tw = x1 - tx;
+      }
+      if(tw <= 0) {
+        continue;
+      }
+
+      // source pixel under the first target pixel, walked backwards if flipped
+      int sx = flip_h ? run->x + run->w - 1 - skip : run->x + skip;
+      const typename S::pixel_t *ps = (const typename S::pixel_t *)src->ptr(sx, sy);
+      T *pd = (T *)dst->ptr(tx, dy);
+
+      if(run->opaque && store_opaque) {
+        while(tw--) {
+          _store_pixel(pd, fetch(*ps));
+          pd++;
+          ps += step;
+        }
+      } else if(alpha != 255) {
+        while(tw--) {
+          uint32_t c = _premul_mul_alpha(fetch(*ps), alpha);
+          _blend_pixel(pd, bf, _r(c), _g(c), _b(c), _a(c));
+          pd++;
+          ps += step;
+        }
+      } else {
+        while(tw--) {
+          uint32_t c = fetch(*ps);
+          _blend_pixel(pd, bf, _r(c), _g(c), _b(c), _a(c));
+          pd++;
+          ps += step;
+        }
+      }
+    }
+  }
+
+  /*
+    samplers for scaled and transformed blits. `u` and `v` are the 16:16
+    source coordinates of the target pixel's centre and samples are clamped
+    to the box `bx0, by0` - `bx1, by1` (inclusive) so that sprites cut from a
+    sheet don't pick up their neighbours' edges.
+  */
+  static inline __attribute__((always_inline))
+  int _clamp_coord(int c, int lo, int hi) {
+    return c < lo ? lo : (c > hi ? hi : c);
+  }
+
+  // narrows [lo, hi) to the steps i where 0 <= p + d * i < limit, returns
+  // false if no steps are left. used to find the part of a target span that
+  // a transformed image covers
+  inline bool affine_span_range(float p, float d, float limit, float &lo, float &hi) {
+    if(d == 0.0f) {
+      return p >= 0.0f && p < limit;
+    }
+    float a = -p / d;
+    float b = (limit - p) / d;
+    lo = std::max(lo, std::min(a, b));
+    hi = std::min(hi, std::max(a, b));
+    return lo < hi;
+  }
+
+  template<typename S>
+  inline uint32_t sample_nearest(const S &fetch, image_t *src, int bx0, int by0, int bx1, int by1, fx16_t u, fx16_t v) {
+    int x = _clamp_coord(u >> 16, bx0, bx1);
+    int y = _clamp_coord(v >> 16, by0, by1);
+    return fetch(*(const typename S::pixel_t *)src->ptr(x, y));
+  }
+
+  // blends the four pixels around the sample point, weights are 8-bit
+  template<typename S>
+  inline uint32_t sample_bilinear(const S &fetch, image_t *src, int bx0, int by0, int bx1, int by1, fx16_t u, fx16_t v) {
+    // move from pixel centres to pixel corners
+    u -= 0x8000;
+    v -= 0x8000;
+    uint32_t fx = (u >> 8) & 0xff;
+    uint32_t fy = (v >> 8) & 0xff;
+    int x0 = _clamp_coord(u >> 16, bx0, bx1);
+    int x1 = _clamp_coord((u >> 16) + 1, bx0, bx1);
+    int y0 = _clamp_coord(v >> 16, by0, by1);
+    int y1 = _clamp_coord((v >> 16) + 1, by0, by1);
+
+    const typename S::pixel_t *r0 = (const typename S::pixel_t *)src->ptr(0, y0);
+    const typename S::pixel_t *r1 = (const typename S::pixel_t *)src->ptr(0, y1);
+    uint32_t top    = _lerp_rgba8888(fetch(r0[x0]), fetch(r0[x1]), fx);
+    uint32_t bottom = _lerp_rgba8888(fetch(r1[x0]), fetch(r1[x1]), fx);
+    return _lerp_rgba8888(top, bottom, fy);
+  }
+
+  struct sampler_nearest_t {
+    template<typename S>
+    inline uint32_t operator()(const S &fetch, image_t *src, int bx0, int by0, int bx1, int by1, fx16_t u, fx16_t v) const {
+      return sample_nearest(fetch, src, bx0, by0, bx1, by1, u, v);
+    }
+  };
+
+  struct sampler_bilinear_t {
+    template<typename S>
+    inline uint32_t operator()(const S &fetch, image_t *src, int bx0, int by0, int bx1, int by1, fx16_t u, fx16_t v) const {
+      return sample_bilinear(fetch, src, bx0, by0, bx1, by1, u, v);
+    }
+  };
+
+  template<typename T, typename S, typename F>
+  inline void _span_blit_sampled(const S &fetch, F sample, uint32_t alpha, image_t *src, const rect_t &box, image_t *dst, blend_func_t bf, fx16_t u, fx16_t v, fx16_t du, fx16_t dv, int dx, int dy, int w) {
+    int bx0 = box.x, by0 = box.y, bx1 = box.x + box.w - 1, by1 = box.y + box.h - 1;
+    T *pd = (T *)dst->ptr(dx, dy);
+
+    if(alpha != 255) {
+      while(w--) {
+        uint32_t c = _premul_mul_alpha(sample(fetch, src, bx0, by0, bx1, by1, u, v), alpha);
+        _blend_pixel(pd, bf, _r(c), _g(c), _b(c), _a(c));
+        pd++;
+        u += du;
+        v += dv;
       }
-      *pd = bf(*pd, _r(c), _g(c), _b(c), _a(c));
+      return;
+    }
+
+    while(w--) {
+      uint32_t c = sample(fetch, src, bx0, by0, bx1, by1, u, v);
+      _blend_pixel(pd, bf, _r(c), _g(c), _b(c), _a(c));
       pd++;
-      ps++;
+      u += du;
+      v += dv;
+    }
+  }
+
+  // draws a span of `w` target pixels stepping through the source by
+  // (du, dv) per pixel, used for both filtered scaling and affine blits
+  template<typename T, typename S>
+  void span_blit_affine(const S &fetch, uint32_t alpha, filter_t filter, image_t *src, const rect_t &box, image_t *dst, blend_func_t bf, fx16_t u, fx16_t v, fx16_t du, fx16_t dv, int dx, int dy, int w) {
+    if(filter == BILINEAR) {
+      _span_blit_sampled<T>(fetch, sampler_bilinear_t(), alpha, src, box, dst, bf, u, v, du, dv, dx, dy, w);
+    } else {
+      _span_blit_sampled<T>(fetch, sampler_nearest_t(), alpha, src, box, dst, bf, u, v, du, dv, dx, dy, w);
+    }
+  }
+
+  /*
+    draws a vertical span of `h` target pixels from (x, y) downwards stepping
+    through the source by (du, dv) per pixel. the caller clips the span and
+    keeps the texture coordinates inside the source. `shade` darkens the
+    texture (255 is full brightness).
+  */
+  template<typename T, typename S>
+  void vspan_blit(const S &fetch, uint32_t alpha, uint32_t shade, image_t *src, image_t *dst, blend_func_t bf, int x, int y, int h, fx16_t u, fx16_t v, fx16_t du, fx16_t dv) {
+    T *pd = (T *)dst->ptr(x, y);
+    int stride = dst->row_stride() / sizeof(T);
+
+    if(du == 0) {
+      // the common case, a single texture column
+      const typename S::pixel_t *ps = (const typename S::pixel_t *)src->ptr(u >> 16, 0);
+      int src_stride = src->row_stride() / sizeof(typename S::pixel_t);
+      while(h--) {
+        uint32_t c = fetch(ps[(v >> 16) * src_stride]);
+        if(shade != 255) c = _premul_shade(c, shade);
+        if(alpha != 255) c = _premul_mul_alpha(c, alpha);
+        _blend_pixel(pd, bf, _r(c), _g(c), _b(c), _a(c));
+        pd += stride;
+        v += dv;
+      }
+      return;
+    }
+
+    while(h--) {
+      uint32_t c = fetch(*(const typename S::pixel_t *)src->ptr(u >> 16, v >> 16));
+      if(shade != 255) c = _premul_shade(c, shade);
+      if(alpha != 255) c = _premul_mul_alpha(c, alpha);
+      _blend_pixel(pd, bf, _r(c), _g(c), _b(c), _a(c));
+      pd += stride;
+      u += du;
+      v += dv;
     }
   }
 
-  void span_blit(image_t *src, image_t *dst, blend_func_t bf, int sx, int sy, int dx, int dy, int w, palette_t palette) {
+  /*
+    A8 images have no colour of their own, they are drawn as a coverage mask
+    for the target's current brush. the mask rows are passed straight to the
+    brush's masked span function unless they need scaling or alpha applied
+    first, in which case they are built up in short chunks on the stack.
+  */
+  constexpr int MASK_BLIT_CHUNK = 64;
+
+  inline void span_blit_mask(image_t *src, image_t *dst, int sx, int sy, int dx, int dy, int w) {
     uint8_t *ps = (uint8_t *)src->ptr(sx, sy);
-    uint32_t *pd = (uint32_t *)dst->ptr(dx, dy);
     uint32_t src_alpha = src->alpha();
 
-    while(w--) {
-      uint32_t c = palette[*ps];
-      if(src->alpha() != 255) {
-        c = _premul_mul_alpha(c, src->alpha());
+    if(src_alpha == 255) {
+      dst->_masked_span_func(dst, dst->brush(), dx, dy, w, ps);
+      return;
+    }
+
+    uint8_t mask[MASK_BLIT_CHUNK];
+    while(w > 0) {
+      int c = w < MASK_BLIT_CHUNK ? w : MASK_BLIT_CHUNK;
+      for(int i = 0; i < c; i++) {
+        mask[i] = _premul_mul_alpha_channel(ps[i], src_alpha);
       }
-      *pd = bf(*pd, _r(c), _g(c), _b(c), _a(c));
-      pd++;
-      ps++;
+      dst->_masked_span_func(dst, dst->brush(), dx, dy, c, mask);
+      ps += c;
+      dx += c;
+      w -= c;
     }
   }
 
-  void span_blit_scale(image_t *src, image_t *dst, blend_func_t bf, fx16_t sx, fx16_t sx_step, fx16_t sy, int dx, int dy, int w) {
-    uint32_t *ps = (uint32_t *)src->ptr(0, sy >> 16);
-    uint32_t *pd = (uint32_t *)dst->ptr(dx, dy);
+  inline void span_blit_scale_mask(image_t *src, image_t *dst, fx16_t sx, fx16_t sx_step, fx16_t sy, int dx, int dy, int w) {
+    uint8_t *ps = (uint8_t *)src->ptr(0, sy >> 16);
     uint32_t src_alpha = src->alpha();
 
-    while(w--) {
-      uint32_t c = *(ps + (sx >> 16));
-      if(src->alpha() != 255) {
-        c = _premul_mul_alpha(c, src->alpha());
+    uint8_t mask[MASK_BLIT_CHUNK];
+    while(w > 0) {
+      int c = w < MASK_BLIT_CHUNK ? w : MASK_BLIT_CHUNK;
+      for(int i = 0; i < c; i++) {
+        mask[i] = _premul_mul_alpha_channel(ps[sx >> 16], src_alpha);
+        sx += sx_step;
       }
-      *pd = bf(*pd, _r(c), _g(c), _b(c), _a(c));
-      pd++;
-      sx += sx_step;
+      dst->_masked_span_func(dst, dst->brush(), dx, dy, c, mask);
+      dx += c;
+      w -= c;
     }
   }
 
-  void span_blit_scale(image_t *src, image_t *dst, blend_func_t bf, fx16_t sx, fx16_t sx_step, fx16_t sy, int dx, int dy, int w, palette_t palette) {
-    uint8_t *ps = (uint8_t *)src->ptr(0, sy >> 16);
-    uint32_t *pd = (uint32_t *)dst->ptr(dx, dy);
+  inline void span_blit_affine_mask(image_t *src, const rect_t &box, image_t *dst, filter_t filter, fx16_t u, fx16_t v, fx16_t du, fx16_t dv, int dx, int dy, int w) {
+    int bx0 = box.x, by0 = box.y, bx1 = box.x + box.w - 1, by1 = box.y + box.h - 1;
     uint32_t src_alpha = src->alpha();
+    fetch_a8_t fetch;
 
-    while(w--) {
-      uint32_t c = palette[*(ps + (sx >> 16))];
-      if(src->alpha() != 255) {
-        c = _premul_mul_alpha(c, src->alpha());
+    uint8_t mask[MASK_BLIT_CHUNK];
+    while(w > 0) {
+      int c = w < MASK_BLIT_CHUNK ? w : MASK_BLIT_CHUNK;
+      for(int i = 0; i < c; i++) {
+        uint32_t a = filter == BILINEAR ?
+          _a(sample_bilinear(fetch, src, bx0, by0, bx1, by1, u, v)) :
+          _a(sample_nearest(fetch, src, bx0, by0, bx1, by1, u, v));
+        mask[i] = _premul_mul_alpha_channel(a, src_alpha);
+        u += du;
+        v += dv;
       }
-      *pd = bf(*pd, _r(c), _g(c), _b(c), _a(c));
-      pd++;
-      sx += sx_step;
+      dst->_masked_span_func(dst, dst->brush(), dx, dy, c, mask);
+      dx += c;
+      w -= c;
+    }
+  }
+
+  /*
+    calls `f` with a reader for the source image's pixel format, the global
+    alpha the reader leaves to be applied and a null pointer of the target's
+    pixel type. used to pick the right span_blit() instantiation once per blit
+    rather than per span. blits into targets that can't be drawn to
+    (RGBA4444) are skipped.
+  */
+  template<typename S, typename F>
+  void blit_dispatch_target(image_t *dst, const S &fetch, uint32_t alpha, F f) {
+    switch(dst->pixel_format()) {
+      case RGBA8888: f(fetch, alpha, (uint32_t *)nullptr); break;
+      case RGB565:   f(fetch, alpha, (uint16_t *)nullptr); break;
+      case A8:       f(fetch, alpha, (uint8_t *)nullptr); break;
+      default: break;
+    }
+  }
+
+  template<typename F>
+  void blit_dispatch(image_t *src, image_t *dst, F f) {
+    if(src->has_palette()) {
+      // global alpha is baked into the lookup table
+      fetch_palette_t fetch = {src->palette_lut()};
+      blit_dispatch_target(dst, fetch, 255, f);
+      return;
+    }
+
+    uint32_t alpha = src->alpha();
+    switch(src->pixel_format()) {
+      case RGB565:   blit_dispatch_target(dst, fetch_rgb565_t(), alpha, f); break;
+      case RGBA4444: blit_dispatch_target(dst, fetch_rgba4444_t(), alpha, f); break;
+      case A8:       blit_dispatch_target(dst, fetch_a8_t(), alpha, f); break;
+      default:       blit_dispatch_target(dst, fetch_rgba8888_t(), alpha, f); break;
     }
   }
 
-}
\ No newline at end of file
+}
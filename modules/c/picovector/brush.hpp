@@ -10,19 +10,24 @@ namespace picovector {
 
   class brush_t {
   public:
-    virtual span_func_t span_func() = 0;
-    virtual masked_span_func_t masked_span_func() = 0;
+    // returns the span functions for drawing into a target of the given
+    // pixel format
+    virtual span_func_t span_func(pixel_format_t pixel_format) = 0;
+    virtual masked_span_func_t masked_span_func(pixel_format_t pixel_format) = 0;
+
+    // true if every pixel the brush draws is the same fully opaque color,
+    // which is returned in `c` so callers can store it without blending
+    virtual bool solid_color(uint32_t *c) { return false; }
   };
 
-  void color_brush_span_func(image_t *target, brush_t *brush, int x, int y, int w);
-  void color_brush_masked_span_func(image_t *target, brush_t *brush, int x, int y, int w, uint8_t *mask);
   class color_brush_t : public brush_t {
   public:
     color_t c;
 
     color_brush_t(const color_t& c);
-    span_func_t span_func();
-    masked_span_func_t masked_span_func();
+    span_func_t span_func(pixel_format_t pixel_format);
+    masked_span_func_t masked_span_func(pixel_format_t pixel_format);
+    bool solid_color(uint32_t *c);
   };
 
   class pattern_brush_t : public brush_t {
@@ -33,19 +38,27 @@ namespace picovector {
 
     pattern_brush_t(const color_t& c1, const color_t& c2, uint8_t pattern_index);
     pattern_brush_t(const color_t& c1, const color_t& c2, uint8_t *pattern);
-    span_func_t span_func();
-    masked_span_func_t masked_span_func();
+    span_func_t span_func(pixel_format_t pixel_format);
+    masked_span_func_t masked_span_func(pixel_format_t pixel_format);
   };
 
   class image_brush_t : public brush_t {
   public:
     image_t *src;
     mat3_t inverse_transform;
+    // tile the image across the target, otherwise nothing is drawn outside it
+    bool wrap;
+
+    // inverse transform in 16:16 fixed point, the texture position of target
+    // pixel (x, y) is (ua * x + ub * y + uc, va * x + vb * y + vc)
+    fx16_t ua, ub, uc, va, vb, vc;
+    // texture pixels covered by each target pixel, picks the mipmap level
+    float texels_per_pixel;
 
-    image_brush_t(image_t *src);
-    image_brush_t(image_t *src, mat3_t *transform);
-    span_func_t span_func();
-    masked_span_func_t masked_span_func();
+    image_brush_t(image_t *src, bool wrap=false);
+    image_brush_t(image_t *src, mat3_t *transform, bool wrap=false);
+    span_func_t span_func(pixel_format_t pixel_format);
+    masked_span_func_t masked_span_func(pixel_format_t pixel_format);
   };
 
 }
\ No newline at end of file
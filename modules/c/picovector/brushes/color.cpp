@@ -2,10 +2,12 @@
 
 namespace picovector {
 
-
+  // T is the destination pixel type, uint32_t for RGBA8888, uint16_t for
+  // RGB565 and uint8_t for A8 targets
+  template<typename T>
   void color_brush_span_func(image_t *target, brush_t *brush, int x, int y, int w) {
     color_brush_t *p = (color_brush_t*)brush;
-    uint32_t *dst = (uint32_t*)target->ptr(x, y);
+    T *dst = (T*)target->ptr(x, y);
     uint32_t src = p->c._p;
 
     if(target->alpha() != 255) {
@@ -19,14 +21,15 @@ namespace picovector {
 
     blend_func_t fn = target->_blend_func;
     while(w--) {
-      *dst = fn(*dst, r, g, b, a);
+      _blend_pixel(dst, fn, r, g, b, a);
       dst++;
     }
   }
 
+  template<typename T>
   void color_brush_masked_span_func(image_t *target, brush_t *brush, int x, int y, int w, uint8_t *mask) {
     color_brush_t *p = (color_brush_t*)brush;
-    uint32_t *dst = (uint32_t*)target->ptr(x, y);
+    T *dst = (T*)target->ptr(x, y);
     uint32_t src = p->c._p;
 
     if(target->alpha() != 255) {
@@ -45,7 +48,7 @@ namespace picovector {
       uint32_t sg = _premul_mul_alpha_channel(g, m);
       uint32_t sb = _premul_mul_alpha_channel(b, m);
       uint32_t sa = _premul_mul_alpha_channel(a, m);
-      *dst = fn(*dst, sr, sg, sb, sa);
+      _blend_pixel(dst, fn, sr, sg, sb, sa);
       dst++;
       mask++;
     }
@@ -54,12 +57,27 @@ namespace picovector {
   color_brush_t::color_brush_t(const color_t& c) : c(c) {
   }
 
-  span_func_t color_brush_t::span_func() {
-    return color_brush_span_func;
+  span_func_t color_brush_t::span_func(pixel_format_t pixel_format) {
+    switch(pixel_format) {
+      case RGBA8888: return color_brush_span_func<uint32_t>;
+      case RGB565:   return color_brush_span_func<uint16_t>;
+      case A8:       return color_brush_span_func<uint8_t>;
+      default:       return span_func_nop;
+    }
   }
 
-  masked_span_func_t color_brush_t::masked_span_func() {
-    return color_brush_masked_span_func;
+  bool color_brush_t::solid_color(uint32_t *c) {
+    *c = this->c._p;
+    return _a(*c) == 255;
+  }
+
+  masked_span_func_t color_brush_t::masked_span_func(pixel_format_t pixel_format) {
+    switch(pixel_format) {
+      case RGBA8888: return color_brush_masked_span_func<uint32_t>;
+      case RGB565:   return color_brush_masked_span_func<uint16_t>;
+      case A8:       return color_brush_masked_span_func<uint8_t>;
+      default:       return masked_span_func_nop;
+    }
   }
 
 }
\ No newline at end of file
@@ -1,87 +1,175 @@
 #include "../brush.hpp"
+#include "../blit.hpp"
 
 namespace picovector {
 
+  /*
+    walks the texture under a target span calling `f(i, c)` with the offset
+    into the span and the fetched color of each covered pixel.
+
+    texture coordinates are stepped incrementally in 16:16 fixed point. when
+    wrapping they're kept inside the texture with a mask if both sides are a
+    power of two or a single compare otherwise, when not wrapping the span is
+    first cut down to the part that lands on the texture.
+
+    `src` is the brush's image or one of its mipmaps, `level` being how many
+    times it has been halved.
+  */
+  template<typename S, typename F>
+  static void image_brush_walk(image_brush_t *p, image_t *src, int level, const S &fetch, int x, int y, int w, F f) {
+    rect_t b = src->bounds();
+    int tw = b.w;
+    int th = b.h;
+    if(tw <= 0 || th <= 0) {
+      return;
+    }
+
+    // texture position of the centre of the first pixel
+    int64_t u = (((int64_t(p->ua) * (2 * x + 1) + int64_t(p->ub) * (2 * y + 1)) >> 1) + p->uc) >> level;
+    int64_t v = (((int64_t(p->va) * (2 * x + 1) + int64_t(p->vb) * (2 * y + 1)) >> 1) + p->vc) >> level;
+    fx16_t du = p->ua >> level;
+    fx16_t dv = p->va >> level;
+
+    if(p->wrap) {
+      fx16_t tw16 = tw << 16;
+      fx16_t th16 = th << 16;
+      fx16_t uw = ((u % tw16) + tw16) % tw16;
+      fx16_t vw = ((v % th16) + th16) % th16;
+      du %= tw16;
+      dv %= th16;
+
+      if((tw & (tw - 1)) == 0 && (th & (th - 1)) == 0) {
+        uint32_t umask = tw16 - 1;
+        uint32_t vmask = th16 - 1;
+        for(int i = 0; i < w; i++) {
+          const typename S::pixel_t *row = (const typename S::pixel_t *)src->ptr(0, vw >> 16);
+          f(i, fetch(row[uw >> 16]));
+          uw = (uint32_t(uw) + uint32_t(du)) & umask;
+          vw = (uint32_t(vw) + uint32_t(dv)) & vmask;
+        }
+      } else {
+        for(int i = 0; i < w; i++) {
+          const typename S::pixel_t *row = (const typename S::pixel_t *)src->ptr(0, vw >> 16);
+          f(i, fetch(row[uw >> 16]));
+          uw += du;
+          if(uw >= tw16) uw -= tw16; else if(uw < 0) uw += tw16;
+          vw += dv;
+          if(vw >= th16) vw -= th16; else if(vw < 0) vw += th16;
+        }
+      }
+      return;
+    }
+
+    float lo = 0.0f;
+    float hi = w;
+    if(!affine_span_range(u / 65536.0f, du / 65536.0f, tw, lo, hi) ||
+       !affine_span_range(v / 65536.0f, dv / 65536.0f, th, lo, hi)) {
+      return;
+    }
+
+    int start = ceilf(lo);
+    int end = ceilf(hi);
+    fx16_t su = u + int64_t(du) * start;
+    fx16_t sv = v + int64_t(dv) * start;
+    for(int i = start; i < end; i++) {
+      f(i, sample_nearest(fetch, src, 0, 0, tw - 1, th - 1, su, sv));
+      su += du;
+      sv += dv;
+    }
+  }
+
+  // picks the mipmap level and the reader for its pixel format once per span
+  template<typename F>
+  static void image_brush_dispatch(image_brush_t *p, int x, int y, int w, F f) {
+    int level;
+    image_t *src = p->src->mipmap_for_scale(p->texels_per_pixel, &level);
+    if(src->has_palette()) {
+      // global alpha is baked into the lookup table
+      image_brush_walk(p, src, level, fetch_palette_t{src->palette_lut()}, x, y, w, f);
+      return;
+    }
+
+    uint32_t alpha = src->alpha();
+    if(alpha != 255) {
+      auto fa = [&](int i, uint32_t c) { f(i, _premul_mul_alpha(c, alpha)); };
+      switch(src->pixel_format()) {
+        case RGBA8888: image_brush_walk(p, src, level, fetch_rgba8888_t(), x, y, w, fa); break;
+        case RGBA4444: image_brush_walk(p, src, level, fetch_rgba4444_t(), x, y, w, fa); break;
+        case RGB565:   image_brush_walk(p, src, level, fetch_rgb565_t(), x, y, w, fa); break;
+        case A8:       image_brush_walk(p, src, level, fetch_a8_t(), x, y, w, fa); break;
+      }
+      return;
+    }
+
+    switch(src->pixel_format()) {
+      case RGBA8888: image_brush_walk(p, src, level, fetch_rgba8888_t(), x, y, w, f); break;
+      case RGBA4444: image_brush_walk(p, src, level, fetch_rgba4444_t(), x, y, w, f); break;
+      case RGB565:   image_brush_walk(p, src, level, fetch_rgb565_t(), x, y, w, f); break;
+      case A8:       image_brush_walk(p, src, level, fetch_a8_t(), x, y, w, f); break;
+    }
+  }
+
+  template<typename T>
   void image_brush_span_func(image_t *target, brush_t *brush, int x, int y, int w) {
     image_brush_t *p = (image_brush_t*)brush;
-    uint32_t *dst = (uint32_t*)target->ptr(x, y);
-    rect_t b = p->src->bounds();
-
-    fx16_vec2_t p1(x, y);
-    fx16_vec2_t p2((x + w), y);
-
-    p1 = p1.transform(&p->inverse_transform);
-    p2 = p2.transform(&p->inverse_transform);
-
-    fx16_vec2_t pd((p2.x - p1.x) / w, (p2.y - p1.y) / w);
-    fx16_vec2_t pt = p1;
-
-    int tw = int(b.w);
-    int th = int(b.h);
-
-    for(int i = 0; i < w; i++) {
-      pt.x += pd.x;
-      pt.y += pd.y;
-      int u = ((int(pt.x) >> 16) % tw + tw) % tw;
-      int v = ((int(pt.y) >> 16) % th + th) % th;
-      uint32_t c = p->src->get_unsafe(u, v);
-      uint8_t *src = (uint8_t*)&c;
-      *dst = target->_blend_func(*dst, src[0], src[1], src[2], src[3]);
-      dst++;
-    }
+    T *dst = (T*)target->ptr(x, y);
+    blend_func_t bf = target->_blend_func;
+
+    image_brush_dispatch(p, x, y, w, [&](int i, uint32_t c) {
+      _blend_pixel(dst + i, bf, _r(c), _g(c), _b(c), _a(c));
+    });
   }
 
+  template<typename T>
   void image_brush_masked_span_func(image_t *target, brush_t *brush, int x, int y, int w, uint8_t *mask) {
     image_brush_t *p = (image_brush_t*)brush;
-    uint32_t *dst = (uint32_t*)target->ptr(x, y);
-    rect_t b = p->src->bounds();
-
-    fx16_vec2_t p1(x, y);
-    fx16_vec2_t p2((x + w), y);
-
-    p1 = p1.transform(&p->inverse_transform);
-    p2 = p2.transform(&p->inverse_transform);
-
-    fx16_vec2_t pd((p2.x - p1.x) / w, (p2.y - p1.y) / w);
-    fx16_vec2_t pt = p1;
-
-    int tw = int(b.w);
-    int th = int(b.h);
-
-    for(int i = 0; i < w; i++) {
-      pt.x += pd.x;
-      pt.y += pd.y;
-      int u = ((int(pt.x) >> 16) % tw + tw) % tw;
-      int v = ((int(pt.y) >> 16) % th + th) % th;
-      uint32_t c = p->src->get_unsafe(u, v);
-      uint8_t *src = (uint8_t*)&c;
-      uint32_t m = *mask;
-      uint32_t sr = (src[0] * m + 128) >> 8;
-      uint32_t sg = (src[1] * m + 128) >> 8;
-      uint32_t sb = (src[2] * m + 128) >> 8;
-      uint32_t sa = (src[3] * m + 128) >> 8;
-
-      *dst = target->_blend_func(*dst, sr, sg, sb, sa);
-      dst++;
-      mask++;
-    }
+    T *dst = (T*)target->ptr(x, y);
+    blend_func_t bf = target->_blend_func;
+
+    image_brush_dispatch(p, x, y, w, [&](int i, uint32_t c) {
+      uint32_t m = mask[i];
+      if(m) {
+        c = _premul_mul_alpha(c, m);
+        _blend_pixel(dst + i, bf, _r(c), _g(c), _b(c), _a(c));
+      }
+    });
   }
 
-  image_brush_t::image_brush_t(image_t *src) : src(src) {
+  image_brush_t::image_brush_t(image_t *src, bool wrap) : image_brush_t(src, nullptr, wrap) {
   }
 
-  image_brush_t::image_brush_t(image_t *src, mat3_t *transform) : src(src) {
+  image_brush_t::image_brush_t(image_t *src, mat3_t *transform, bool wrap) : src(src), wrap(wrap) {
     if(transform) {
       inverse_transform = *transform;
       inverse_transform.inverse();
     }
+
+    ua = f_to_fx16(inverse_transform.v00);
+    ub = f_to_fx16(inverse_transform.v01);
+    uc = f_to_fx16(inverse_transform.v02);
+    va = f_to_fx16(inverse_transform.v10);
+    vb = f_to_fx16(inverse_transform.v11);
+    vc = f_to_fx16(inverse_transform.v12);
+
+    const mat3_t &m = inverse_transform;
+    texels_per_pixel = std::max(sqrtf(m.v00 * m.v00 + m.v10 * m.v10), sqrtf(m.v01 * m.v01 + m.v11 * m.v11));
   }
 
-  span_func_t image_brush_t::span_func() {
-    return image_brush_span_func;
+  span_func_t image_brush_t::span_func(pixel_format_t pixel_format) {
+    switch(pixel_format) {
+      case RGBA8888: return image_brush_span_func<uint32_t>;
+      case RGB565:   return image_brush_span_func<uint16_t>;
+      case A8:       return image_brush_span_func<uint8_t>;
+      default:       return span_func_nop;
+    }
   }
 
-  masked_span_func_t image_brush_t::masked_span_func() {
-    return image_brush_masked_span_func;
+  masked_span_func_t image_brush_t::masked_span_func(pixel_format_t pixel_format) {
+    switch(pixel_format) {
+      case RGBA8888: return image_brush_masked_span_func<uint32_t>;
+      case RGB565:   return image_brush_masked_span_func<uint16_t>;
+      case A8:       return image_brush_masked_span_func<uint8_t>;
+      default:       return masked_span_func_nop;
+    }
   }
-}
\ No newline at end of file
+}
@@ -44,9 +44,10 @@ namespace picovector {
     {0b11111111,0b11110111,0b11101011,0b11010101,0b10101010,0b11010101,0b11101011,0b11110111}
   };
 
+  template<typename T>
   void pattern_brush_span_func(image_t *target, brush_t *brush, int x, int y, int w) {
     pattern_brush_t *p = (pattern_brush_t*)brush;
-    uint32_t *dst = (uint32_t*)target->ptr(x, y);
+    T *dst = (T*)target->ptr(x, y);
     blend_func_t fn = target->_blend_func;
 
     uint32_t c1c[4] = {_r(p->c1._p), _g(p->c1._p), _b(p->c1._p), _a(p->c1._p)};
@@ -64,15 +65,16 @@ namespace picovector {
       uint32_t b = src[2];
       uint32_t a = src[3];
 
-      *dst = fn(*dst, r, g, b, a);
+      _blend_pixel(dst, fn, r, g, b, a);
       dst++;
       x++;
     }
   }
 
+  template<typename T>
   void pattern_brush_masked_span_func(image_t *target, brush_t *brush, int x, int y, int w, uint8_t *mask) {
     pattern_brush_t *p = (pattern_brush_t*)brush;
-    uint32_t *dst = (uint32_t*)target->ptr(x, y);
+    T *dst = (T*)target->ptr(x, y);
     blend_func_t fn = target->_blend_func;
 
     uint32_t c1c[4] = {_r(p->c1._p), _g(p->c1._p), _b(p->c1._p), _a(p->c1._p)};
@@ -91,7 +93,7 @@ namespace picovector {
       uint32_t b = (src[2] * m + 128) >> 8;
       uint32_t a = (src[3] * m + 128) >> 8;
 
-      *dst = fn(*dst, r, g, b, a);
+      _blend_pixel(dst, fn, r, g, b, a);
       dst++;
       x++;
       mask++;
@@ -106,12 +108,22 @@ namespace picovector {
     memcpy(this->p, pattern, sizeof(uint8_t) * 8);
   }
 
-  span_func_t pattern_brush_t::span_func() {
-    return pattern_brush_span_func;
+  span_func_t pattern_brush_t::span_func(pixel_format_t pixel_format) {
+    switch(pixel_format) {
+      case RGBA8888: return pattern_brush_span_func<uint32_t>;
+      case RGB565:   return pattern_brush_span_func<uint16_t>;
+      case A8:       return pattern_brush_span_func<uint8_t>;
+      default:       return span_func_nop;
+    }
   }
 
-  masked_span_func_t pattern_brush_t::masked_span_func() {
-    return pattern_brush_masked_span_func;
+  masked_span_func_t pattern_brush_t::masked_span_func(pixel_format_t pixel_format) {
+    switch(pixel_format) {
+      case RGBA8888: return pattern_brush_masked_span_func<uint32_t>;
+      case RGB565:   return pattern_brush_masked_span_func<uint16_t>;
+      case A8:       return pattern_brush_masked_span_func<uint8_t>;
+      default:       return masked_span_func_nop;
+    }
   }
 
 }
\ No newline at end of file
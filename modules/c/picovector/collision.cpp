@@ -0,0 +1,224 @@
+#include "collision.hpp"
+
+namespace picovector {
+
+  static inline bool rects_overlap(const collision_object_t &a, int x, int y, int w, int h) {
+    return a.x < x + w && x < a.x + a.w && a.y < y + h && y < a.y + a.h;
+  }
+
+  collision_mask_t::collision_mask_t(image_t *image, int x, int y, int w, int h, int threshold) : w(w), h(h) {
+    _words = (w + 31) / 32;
+    _bits.assign(_words * h, 0);
+
+    rect_t b = image->bounds();
+    for(int my = 0; my < h; my++) {
+      int iy = y + my;
+      if(iy < 0 || iy >= int(b.h)) {
+        continue;
+      }
+
+      uint32_t *r = _bits.data() + my * _words;
+      for(int mx = 0; mx < w; mx++) {
+        int ix = x + mx;
+        if(ix >= 0 && ix < int(b.w) && int(_a(image->get_unsafe(ix, iy))) >= threshold) {
+          r[mx >> 5] |= 1u << (mx & 31);
+        }
+      }
+    }
+  }
+
+  bool collision_mask_t::get(int x, int y) const {
+    if(x < 0 || y < 0 || x >= w || y >= h) {
+      return false;
+    }
+    return row(y)[x >> 5] & (1u << (x & 31));
+  }
+
+  uint32_t collision_mask_t::bits(int y, int x) const {
+    const uint32_t *r = row(y);
+    int i = x >> 5; // rounds down for negative x
+    int s = x & 31;
+    uint32_t lo = i >= 0 && i < _words ? r[i] : 0;
+    if(s == 0) {
+      return lo;
+    }
+    uint32_t hi = i + 1 >= 0 && i + 1 < _words ? r[i + 1] : 0;
+    return (lo >> s) | (hi << (32 - s));
+  }
+
+  bool collision_mask_t::overlaps(const collision_mask_t *other, int dx, int dy) const {
+    int x0 = std::max(0, dx);
+    int x1 = std::min(w, dx + other->w);
+    int y0 = std::max(0, dy);
+    int y1 = std::min(h, dy + other->h);
+    if(x0 >= x1 || y0 >= y1) {
+      return false;
+    }
+
+    // bits of this mask outside the overlap either line up with the clear
+    // pixels outside the other mask or are row padding, so whole words can
+    // be tested
+    int w0 = x0 >> 5;
+    int w1 = (x1 - 1) >> 5;
+    for(int y = y0; y < y1; y++) {
+      const uint32_t *r = row(y);
+      for(int i = w0; i <= w1; i++) {
+        if(r[i] && (r[i] & other->bits(y - dy, i * 32 - dx))) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  collision_grid_t::collision_grid_t(int cell_size, int capacity) : cell_size(std::max(cell_size, 1)) {
+    // object indices are stored in 16 bits
+    capacity = std::clamp(capacity, 0, 0xffff);
+    _objects.resize(capacity);
+
+    int buckets = 16;
+    while(buckets < capacity * 2) {
+      buckets <<= 1;
+    }
+    _buckets.resize(buckets + 1);
+  }
+
+  bool collision_grid_t::add(int id, int x, int y, int w, int h, const collision_mask_t *mask) {
+    if(count >= capacity()) {
+      return false;
+    }
+
+    _objects[count++] = {int16_t(x), int16_t(y), int16_t(std::max(w, 1)), int16_t(std::max(h, 1)), uint16_t(id), mask};
+    _built = false;
+    return true;
+  }
+
+  int collision_grid_t::cell(int v) const {
+    return v >= 0 ? v / cell_size : -((cell_size - 1 - v) / cell_size);
+  }
+
+  uint32_t collision_grid_t::bucket(int cx, int cy) const {
+    return ((uint32_t(cx) * 73856093u) ^ (uint32_t(cy) * 19349663u)) & (_buckets.size() - 2);
+  }
+
+  // counting sort of every (object, cell) entry into its bucket, objects
+  // stay in the order they were added within a bucket
+  void collision_grid_t::build() {
+    size_t nb = _buckets.size() - 1;
+    uint32_t *starts = _buckets.data();
+    std::fill(_buckets.begin(), _buckets.end(), 0);
+
+    for(int i = 0; i < count; i++) {
+      const collision_object_t &o = _objects[i];
+      for(int cy = cell(o.y); cy <= cell(o.y + o.h - 1); cy++) {
+        for(int cx = cell(o.x); cx <= cell(o.x + o.w - 1); cx++) {
+          starts[bucket(cx, cy) + 1]++;
+        }
+      }
+    }
+
+    for(size_t b = 1; b <= nb; b++) {
+      starts[b] += starts[b - 1];
+    }
+    _entries.resize(starts[nb]);
+
+    // each start is advanced past its bucket while filling, then moved back
+    for(int i = 0; i < count; i++) {
+      const collision_object_t &o = _objects[i];
+      for(int cy = cell(o.y); cy <= cell(o.y + o.h - 1); cy++) {
+        for(int cx = cell(o.x); cx <= cell(o.x + o.w - 1); cx++) {
+          _entries[starts[bucket(cx, cy)]++] = {uint16_t(i), int16_t(cx), int16_t(cy)};
+        }
+      }
+    }
+
+    for(size_t b = nb - 1; b > 0; b--) {
+      starts[b] = starts[b - 1];
+    }
+    starts[0] = 0;
+    _built = true;
+  }
+
+  int collision_grid_t::pairs(uint16_t *out, int max) {
+    if(!_built) {
+      build();
+    }
+
+    int n = 0;
+    size_t nb = _buckets.size() - 1;
+    for(size_t b = 0; b < nb && n < max; b++) {
+      for(uint32_t i = _buckets[b]; i < _buckets[b + 1]; i++) {
+        const entry_t &ei = _entries[i];
+        const collision_object_t &a = _objects[ei.object];
+
+        for(uint32_t j = i + 1; j < _buckets[b + 1]; j++) {
+          const entry_t &ej = _entries[j];
+          if(ej.cx != ei.cx || ej.cy != ei.cy) {
+            continue; // another cell that hashed to the same bucket
+          }
+
+          const collision_object_t &o = _objects[ej.object];
+          if(!rects_overlap(a, o.x, o.y, o.w, o.h)) {
+            continue;
+          }
+
+          if(cell(std::max(a.x, o.x)) != ei.cx || cell(std::max(a.y, o.y)) != ei.cy) {
+            continue; // reported from another cell
+          }
+
+          if(a.mask && o.mask && !a.mask->overlaps(o.mask, o.x - a.x, o.y - a.y)) {
+            continue;
+          }
+
+          out[n * 2] = a.id;
+          out[n * 2 + 1] = o.id;
+          if(++n == max) {
+            return n;
+          }
+        }
+      }
+    }
+    return n;
+  }
+
+  int collision_grid_t::query(int x, int y, int w, int h, uint16_t *out, int max) {
+    if(max <= 0) {
+      return 0;
+    }
+
+    if(!_built) {
+      build();
+    }
+
+    w = std::max(w, 1);
+    h = std::max(h, 1);
+    int n = 0;
+    for(int cy = cell(y); cy <= cell(y + h - 1); cy++) {
+      for(int cx = cell(x); cx <= cell(x + w - 1); cx++) {
+        uint32_t b = bucket(cx, cy);
+        for(uint32_t i = _buckets[b]; i < _buckets[b + 1]; i++) {
+          const entry_t &e = _entries[i];
+          if(e.cx != cx || e.cy != cy) {
+            continue;
+          }
+
+          const collision_object_t &o = _objects[e.object];
+          if(!rects_overlap(o, x, y, w, h)) {
+            continue;
+          }
+
+          if(cell(std::max(int(o.x), x)) != cx || cell(std::max(int(o.y), y)) != cy) {
+            continue;
+          }
+
+          out[n++] = o.id;
+          if(n == max) {
+            return n;
+          }
+        }
+      }
+    }
+    return n;
+  }
+
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "image.hpp"
+
+namespace picovector {
+
+  /*
+    one bit per pixel of an image (or part of one), set where the pixel's
+    alpha is at least `threshold`.
+
+    rows are packed into 32-bit words with the leftmost pixel in the lowest
+    bit so two masks can be tested against each other 32 pixels at a time,
+    shifting the other mask's row into line with each word.
+  */
+  class collision_mask_t {
+    public:
+      int w;
+      int h;
+
+      collision_mask_t(image_t *image, int x, int y, int w, int h, int threshold=1);
+
+      bool get(int x, int y) const;
+
+      // true if any set pixel of `other`, with its top left corner placed at
+      // (dx, dy) on this mask, lands on a set pixel of this mask
+      bool overlaps(const collision_mask_t *other, int dx, int dy) const;
+
+    private:
+      int _words; // per row
+      std::vector<uint32_t, PV_STD_ALLOCATOR<uint32_t>> _bits;
+
+      const uint32_t *row(int y) const { return _bits.data() + y * _words; }
+      // 32 bits of row `y` starting at pixel `x`, pixels outside are clear
+      uint32_t bits(int y, int x) const;
+  };
+
+  struct collision_object_t {
+    int16_t x, y, w, h;
+    uint16_t id;
+    const collision_mask_t *mask;
+  };
+
+  /*
+    a uniform grid broadphase. objects are bucketed by the cells they cover,
+    with cells hashed into a fixed number of buckets so the grid has no
+    bounds, and only objects sharing a cell are compared.
+
+    an overlapping pair can share several cells, it's only reported from the
+    cell holding the top left corner of the overlap so no list of reported
+    pairs is needed. pairs where both objects have a mask are also tested
+    pixel for pixel.
+
+    the buckets are rebuilt on the first query after objects change, storage
+    is kept between frames so a steady scene doesn't allocate.
+  */
+  class collision_grid_t {
+    public:
+      int cell_size;
+      int count = 0;
+
+      collision_grid_t(int cell_size, int capacity);
+
+      int capacity() { return _objects.size(); }
+
+      bool add(int id, int x, int y, int w, int h, const collision_mask_t *mask=nullptr);
+      void clear() { count = 0; _built = false; }
+
+      // writes the ids of up to `max` colliding pairs into `out`, two values
+      // per pair, and returns how many pairs were written
+      int pairs(uint16_t *out, int max);
+
+      // writes the ids of up to `max` objects overlapping the rectangle into
+      // `out` and returns how many were written
+      int query(int x, int y, int w, int h, uint16_t *out, int max);
+
+    private:
+      // an object's place in one of the cells it covers
+      struct entry_t {
+        uint16_t object;
+        int16_t cx, cy;
+      };
+
+      bool _built = false;
+      std::vector<collision_object_t, PV_STD_ALLOCATOR<collision_object_t>> _objects;
+      std::vector<entry_t, PV_STD_ALLOCATOR<entry_t>> _entries;
+      // first entry of each bucket, plus one past the end
+      std::vector<uint32_t, PV_STD_ALLOCATOR<uint32_t>> _buckets;
+
+      uint32_t bucket(int cx, int cy) const;
+      int cell(int v) const;
+      void build();
+  };
+
+}
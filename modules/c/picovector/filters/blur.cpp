@@ -36,82 +36,111 @@ namespace picovector {
   }
 
 
-  void image_t::blur(float radius) {
-    if (radius <= 0) return;
-
-    const uint32_t k = blur_k_from_radius_q16(radius);
-    if (k == 0) return;
+  // channel access for the supported pixel formats, the blur runs on 8-bit
+  // channels so RGB565 pixels are expanded on load and packed on store
+  struct blur_rgba8888_t {
+    static const int size = 4;
+    static inline void load(const uint8_t *p, int &r, int &g, int &b, int &a) {
+      r = p[0]; g = p[1]; b = p[2]; a = p[3];
+    }
+    static inline void store(uint8_t *p, int r, int g, int b, int a) {
+      p[0] = (uint8_t)r; p[1] = (uint8_t)g; p[2] = (uint8_t)b; p[3] = (uint8_t)a;
+    }
+  };
 
-    int width = int(_bounds.w);
-    int height = int(_bounds.h);
+  struct blur_rgb565_t {
+    static const int size = 2;
+    static inline void load(const uint8_t *p, int &r, int &g, int &b, int &a) {
+      uint32_t c = _rgb565_to_rgba8888(*(const uint16_t *)p);
+      r = _r(c); g = _g(c); b = _b(c); a = 255;
+    }
+    static inline void store(uint8_t *p, int r, int g, int b, int a) {
+      *(uint16_t *)p = _rgb565(r, g, b);
+    }
+  };
 
+  template<typename P>
+  static void blur_buffer(uint8_t *buffer, size_t row_stride, int width, int height, uint32_t k) {
     // ---- Horizontal pass: forward + backward (symmetric-ish) ----
     for (int y = 0; y < height; ++y) {
-        uint8_t* row = (uint8_t*)_buffer + (size_t)y * (size_t)_row_stride;
+        uint8_t* row = buffer + (size_t)y * row_stride;
 
         // Forward: left -> right
-        int r = row[0], g = row[1], b = row[2], a = row[3];
+        int r, g, b, a;
+        P::load(row, r, g, b, a);
         for (int x = 1; x < width; ++x) {
-            uint8_t* p = row + x * 4;
-            r = iir_step_q16(r, p[0], k);
-            g = iir_step_q16(g, p[1], k);
-            b = iir_step_q16(b, p[2], k);
-            a = iir_step_q16(a, p[3], k);
-            p[0] = (uint8_t)r;
-            p[1] = (uint8_t)g;
-            p[2] = (uint8_t)b;
-            p[3] = (uint8_t)a;
+            uint8_t* p = row + x * P::size;
+            int pr, pg, pb, pa;
+            P::load(p, pr, pg, pb, pa);
+            r = iir_step_q16(r, pr, k);
+            g = iir_step_q16(g, pg, k);
+            b = iir_step_q16(b, pb, k);
+            a = iir_step_q16(a, pa, k);
+            P::store(p, r, g, b, a);
         }
 
         // Backward: right -> left
-        uint8_t* pr = row + (width - 1) * 4;
-        r = pr[0]; g = pr[1]; b = pr[2]; a = pr[3];
+        P::load(row + (width - 1) * P::size, r, g, b, a);
         for (int x = width - 2; x >= 0; --x) {
-            uint8_t* p = row + x * 4;
-            r = iir_step_q16(r, p[0], k);
-            g = iir_step_q16(g, p[1], k);
-            b = iir_step_q16(b, p[2], k);
-            a = iir_step_q16(a, p[3], k);
-            p[0] = (uint8_t)r;
-            p[1] = (uint8_t)g;
-            p[2] = (uint8_t)b;
-            p[3] = (uint8_t)a;
+            uint8_t* p = row + x * P::size;
+            int pr, pg, pb, pa;
+            P::load(p, pr, pg, pb, pa);
+            r = iir_step_q16(r, pr, k);
+            g = iir_step_q16(g, pg, k);
+            b = iir_step_q16(b, pb, k);
+            a = iir_step_q16(a, pa, k);
+            P::store(p, r, g, b, a);
         }
     }
 
     // ---- Vertical pass: forward + backward (in-place, per column) ----
     for (int x = 0; x < width; ++x) {
-        uint8_t* p0 = (uint8_t*)_buffer + x * 4;
+        uint8_t* p0 = buffer + x * P::size;
 
         // Forward: top -> bottom
-        int r = p0[0], g = p0[1], b = p0[2], a = p0[3];
+        int r, g, b, a;
+        P::load(p0, r, g, b, a);
         for (int y = 1; y < height; ++y) {
-            uint8_t* p = (uint8_t*)_buffer + (size_t)y * (size_t)_row_stride + x * 4;
-            r = iir_step_q16(r, p[0], k);
-            g = iir_step_q16(g, p[1], k);
-            b = iir_step_q16(b, p[2], k);
-            a = iir_step_q16(a, p[3], k);
-            p[0] = (uint8_t)r;
-            p[1] = (uint8_t)g;
-            p[2] = (uint8_t)b;
-            p[3] = (uint8_t)a;
+            uint8_t* p = p0 + (size_t)y * row_stride;
+            int pr, pg, pb, pa;
+            P::load(p, pr, pg, pb, pa);
+            r = iir_step_q16(r, pr, k);
+            g = iir_step_q16(g, pg, k);
+            b = iir_step_q16(b, pb, k);
+            a = iir_step_q16(a, pa, k);
+            P::store(p, r, g, b, a);
         }
 
         // Backward: bottom -> top
-        uint8_t* pb = (uint8_t*)_buffer + (size_t)(height - 1) * (size_t)_row_stride + x * 4;
-        r = pb[0]; g = pb[1]; b = pb[2]; a = pb[3];
+        P::load(p0 + (size_t)(height - 1) * row_stride, r, g, b, a);
         for (int y = height - 2; y >= 0; --y) {
-            uint8_t* p = (uint8_t*)_buffer + (size_t)y * (size_t)_row_stride + x * 4;
-            r = iir_step_q16(r, p[0], k);
-            g = iir_step_q16(g, p[1], k);
-            b = iir_step_q16(b, p[2], k);
-            a = iir_step_q16(a, p[3], k);
-            p[0] = (uint8_t)r;
-            p[1] = (uint8_t)g;
-            p[2] = (uint8_t)b;
-            p[3] = (uint8_t)a;
+            uint8_t* p = p0 + (size_t)y * row_stride;
+            int pr, pg, pb, pa;
+            P::load(p, pr, pg, pb, pa);
+            r = iir_step_q16(r, pr, k);
+            g = iir_step_q16(g, pg, k);
+            b = iir_step_q16(b, pb, k);
+            a = iir_step_q16(a, pa, k);
+            P::store(p, r, g, b, a);
         }
     }
   }
 
+  void image_t::blur(float radius) {
+    if (radius <= 0) return;
+    mark_dirty();
+
+    const uint32_t k = blur_k_from_radius_q16(radius);
+    if (k == 0) return;
+
+    int width = int(_bounds.w);
+    int height = int(_bounds.h);
+
+    if (_pixel_format == RGB565) {
+      blur_buffer<blur_rgb565_t>((uint8_t*)_buffer, _row_stride, width, height, k);
+    } else if (_pixel_format == RGBA8888 && !_has_palette) {
+      blur_buffer<blur_rgba8888_t>((uint8_t*)_buffer, _row_stride, width, height, k);
+    }
+  }
+
 }
\ No newline at end of file
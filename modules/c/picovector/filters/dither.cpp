@@ -10,6 +10,8 @@ namespace picovector {
 
 
   void image_t::dither() {
+    mark_dirty();
+
     uint8_t m[16] = {
       0, 136, 34, 170,
       204, 68, 238, 102,
@@ -23,6 +25,29 @@ namespace picovector {
     int width = _bounds.w;
     int height = _bounds.h;
 
+    if(_pixel_format == RGB565) {
+      for(int y = 0; y < height; y++) {
+        int y_lookup = (y & 0b11) << 2;
+        uint16_t *p = (uint16_t*)ptr(0, y);
+        for(int x = 0; x < width; x++) {
+          uint32_t c = _rgb565_to_rgba8888(*p);
+          int pixel = (_r(c) + (_g(c) * 2) + _b(c)) >> 2;
+          int scale = m[y_lookup | (x & 0b11)];
+
+          int a = ca[pixel >> 6];
+          int b = cb[pixel >> 6];
+
+          int v = pixel > (b + ((a - b) * scale >> 8)) ? a : b;
+          *p++ = _rgb565(v, v, v);
+        }
+      }
+      return;
+    }
+
+    if(_has_palette || _pixel_format != RGBA8888) {
+      return; // not supported for other formats
+    }
+
     for(int y = 0; y < height; y++) {
       int y_lookup = (y & 0b11) << 2;
       for(int x = 0; x < width; x++) {
@@ -9,9 +9,27 @@
 namespace picovector {
 
   void image_t::onebit() {
+    mark_dirty();
+
     int width = _bounds.w;
     int height = _bounds.h;
 
+    if(_pixel_format == RGB565) {
+      for(int y = 0; y < height; y++) {
+        uint16_t *p = (uint16_t*)ptr(0, y);
+        for(int x = 0; x < width; x++) {
+          uint32_t c = _rgb565_to_rgba8888(*p);
+          int pixel = (_r(c) + (_g(c) * 2) + _b(c)) >> 2;
+          *p++ = (pixel > 128) ? 0xffff : 0x0000;
+        }
+      }
+      return;
+    }
+
+    if(_has_palette || _pixel_format != RGBA8888) {
+      return; // not supported for other formats
+    }
+
     for(int y = 0; y < height; y++) {
       for(int x = 0; x < width; x++) {
         int offset = ((y * width) + x) << 2;
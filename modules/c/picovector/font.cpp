@@ -1,10 +1,13 @@
 #include <algorithm>
+#include <string.h>
 
 #include "font.hpp"
 #include "image.hpp"
 #include "picovector.hpp"
 #include "brush.hpp"
 #include "mat3.hpp"
+#include "utf8.hpp"
+#include "glyph_cache.hpp"
 
 using std::sort;
 
@@ -36,50 +39,216 @@ namespace picovector {
     return rect_t(minx, miny, ceil(maxx) - minx, ceil(maxy) - miny);
   }
 
-  rect_t font_t::measure(image_t *target, const char *text, float size) {
-    rect_t r =  {0, 0, 0, 0};
-
-    mat3_t transform;
-    transform = transform.scale(size / 128.0f, size / 128.0f);
-
-    for(size_t i = 0; i < strlen(text); i++) {
-      char c = text[i];
-      // find the glyph
-      for(int j = 0; j < this->glyph_count; j++) {
-        if(this->glyphs[j].codepoint == uint16_t(c)) {
-          float a = this->glyphs[j].advance;
-          transform = transform.translate(a, 0);
-          vec2_t caret(1, 1);
-          caret = caret.transform(transform);
-          r.w = max(r.w, caret.x);
-          r.h = max(r.y, caret.y);
+  size_t font_t::mapped_size(uint32_t glyph_count, uint32_t path_count, uint32_t point_count) {
+    return sizeof(af2_header_t) + sizeof(glyph_t) * glyph_count + sizeof(glyph_path_t) * path_count + sizeof(glyph_path_point_t) * point_count;
+  }
+
+  bool font_t::map(const uint8_t *data, size_t size) {
+    if(size < sizeof(af2_header_t) || (uintptr_t(data) & 3)) {
+      return false;
+    }
+
+    const af2_header_t *header = (const af2_header_t *)data;
+    if(memcmp(header->marker, "af!2", 4) != 0 ||
+       mapped_size(header->glyph_count, header->path_count, header->point_count) > size) {
+      return false;
+    }
+
+    // every offset has to land inside its table
+    const uint8_t *paths = data + sizeof(af2_header_t) + sizeof(glyph_t) * header->glyph_count;
+    const uint8_t *points = paths + sizeof(glyph_path_t) * header->path_count;
+    const uint8_t *end = points + sizeof(glyph_path_point_t) * header->point_count;
+    glyph_t *g = (glyph_t *)(data + sizeof(af2_header_t));
+    for(int i = 0; i < header->glyph_count; i++, g++) {
+      const uint8_t *p = (const uint8_t *)g + g->paths_offset;
+      if(p < paths || p + sizeof(glyph_path_t) * g->path_count > points || (p - paths) % sizeof(glyph_path_t)) {
+        return false;
+      }
+    }
+    glyph_path_t *path = (glyph_path_t *)paths;
+    for(int i = 0; i < header->path_count; i++, path++) {
+      const uint8_t *p = (const uint8_t *)path + path->points_offset;
+      if(!path->point_count || p < points || p + sizeof(glyph_path_point_t) * path->point_count > end) {
+        return false;
+      }
+    }
+
+    this->glyph_count = header->glyph_count;
+    this->glyphs = (glyph_t *)(data + sizeof(af2_header_t));
+    return true;
+  }
+
+  void font_t::build_index(uint16_t *wide) {
+    std::fill(latin1, latin1 + 256, 0);
+    this->wide = wide;
+    wide_count = 0;
+
+    for(int i = 0; i < glyph_count; i++) {
+      uint16_t codepoint = glyphs[i].codepoint;
+      if(codepoint < 256) {
+        // the first glyph for a codepoint wins, as it did with a linear scan
+        if(!latin1[codepoint]) {
+          latin1[codepoint] = i + 1;
         }
+      } else {
+        wide[wide_count++] = i;
       }
     }
 
-    return r;
+    // ties keep glyph order so a lower bound search finds the first glyph
+    sort(wide, wide + wide_count, [this](uint16_t a, uint16_t b) {
+      uint16_t ca = glyphs[a].codepoint;
+      uint16_t cb = glyphs[b].codepoint;
+      return ca != cb ? ca < cb : a < b;
+    });
+  }
+
+  glyph_t *font_t::glyph(uint32_t codepoint) {
+    if(codepoint < 256) {
+      uint16_t i = latin1[codepoint];
+      return i ? &glyphs[i - 1] : nullptr;
+    }
+
+    const uint16_t *end = wide + wide_count;
+    const uint16_t *i = std::lower_bound((const uint16_t *)wide, end, codepoint, [this](uint16_t index, uint32_t c) {
+      return glyphs[index].codepoint < c;
+    });
+    return i != end && glyphs[*i].codepoint == codepoint ? &glyphs[*i] : nullptr;
+  }
+
+  glyph_metrics_t font_t::glyph_metrics(glyph_t *glyph, uint16_t size_key) {
+    float size = size_key / 16.0f;
+    float scale = size / 128.0f;
+    glyph_metrics_t m = {glyph->advance * scale, 0.0f, 0.0f, 0.0f, 0.0f};
+
+    // the outline's extent, the glyph's stored bounds are only approximate
+    int x0 = INT8_MAX, y0 = INT8_MAX, x1 = INT8_MIN, y1 = INT8_MIN;
+    glyph_path_t *path = glyph->paths();
+    for(int i = 0; i < glyph->path_count; i++, path++) {
+      glyph_path_point_t *point = path->points();
+      for(int j = 0; j < path->point_count; j++, point++) {
+        x0 = min(x0, int(point->x));
+        y0 = min(y0, int(point->y));
+        x1 = max(x1, int(point->x));
+        y1 = max(y1, int(point->y));
+      }
+    }
+
+    if(x1 > x0) {
+      m.x0 = x0 * scale;
+      m.y0 = size + y0 * scale;
+      m.x1 = x1 * scale;
+      m.y1 = size + y1 * scale;
+    }
+    return m;
+  }
+
+  text_metrics_t font_t::measure(const char *text, float size) {
+    uint16_t key = size_key(size);
+    text_metrics_builder_t metrics(key / 16.0f);
+
+    while(*text) {
+      uint32_t codepoint = utf8_next(text);
+      metrics.add(text_metrics_get(this, codepoint, key, [&]() {
+        glyph_t *glyph = this->glyph(codepoint);
+        return glyph ? glyph_metrics(glyph, key) : glyph_metrics_t{0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+      }));
+    }
+
+    return metrics.result();
+  }
+
+  // draws a cached glyph mask with its pen position at (x, y)
+  static void draw_glyph_mask(image_t *target, brush_t *brush, const glyph_cache_entry_t *e, int x, int y, int cx0, int cy0, int cx1, int cy1) {
+    int gx = x + e->x;
+    int gy = y + e->y;
+    int x0 = max(gx, cx0);
+    int x1 = min(gx + e->w, cx1);
+    int y0 = max(gy, cy0);
+    int y1 = min(gy + e->h, cy1);
+    if(x0 >= x1 || y0 >= y1) {
+      return;
+    }
+
+    masked_span_func_t fn = target->_masked_span_func;
+    uint8_t *mask = (uint8_t *)glyph_cache_mask(e) + (y0 - gy) * e->w + (x0 - gx);
+    for(int row = y0; row < y1; row++) {
+      fn(target, brush, x0, row, x1 - x0, mask);
+      mask += e->w;
+    }
+  }
+
+  /*
+    glyphs are drawn from the glyph cache when they fit, snapped to whole
+    pixels vertically and to a quarter of a pixel horizontally. the size is
+    rounded to a sixteenth of a pixel so glyphs and advances agree.
+  */
+  uint16_t font_t::size_key(float size) {
+    return std::clamp(int(size * 16.0f + 0.5f), 1, 0xffff);
+  }
+
+  rect_t font_t::pixel_clip(image_t *target) {
+    rect_t clip = target->clip().intersection(target->bounds());
+    int cx0 = ceilf(clip.x);
+    int cy0 = ceilf(clip.y);
+    int cx1 = floorf(clip.x + clip.w);
+    int cy1 = floorf(clip.y + clip.h);
+    return rect_t(cx0, cy0, cx1 - cx0, cy1 - cy0);
+  }
+
+  void font_t::draw_glyph(image_t *target, glyph_t *glyph, float x, int y, uint16_t size_key, const rect_t &clip) {
+    if(!glyph->path_count) {
+      return;
+    }
+
+    float size = size_key / 16.0f;
+    int px = floorf(x);
+    int phase = int((x - px) * GLYPH_CACHE_PHASES);
+    const glyph_cache_entry_t *e = glyph_cache_get(this, glyph, size_key, (uint)target->antialias(), phase);
+    if(e) {
+      draw_glyph_mask(target, target->brush(), e, px, y, clip.x, clip.y, clip.x + clip.w, clip.y + clip.h);
+    } else {
+      float scale = size / 128.0f;
+      mat3_t transform;
+      transform = transform.translate(px + float(phase) / GLYPH_CACHE_PHASES, y + size);
+      transform = transform.scale(scale, scale);
+      render_glyph(glyph, target, &transform, target->brush());
+    }
   }
 
   void font_t::draw(image_t *target, const char *text, float x, float y, float size) {
-    vec2_t caret(x, y);
-
-    mat3_t transform;
-    transform = transform.translate(x, y);
-    transform = transform.translate(0, size);
-    transform = transform.scale(size / 128.0f, size / 128.0f);
-
-
-    for(size_t i = 0; i < strlen(text); i++) {
-      char c = text[i];
-      // find the glyph
-      for(int j = 0; j < this->glyph_count; j++) {
-        if(this->glyphs[j].codepoint == uint16_t(c)) {
-          render_glyph(&this->glyphs[j], target, &transform, target->brush());
-          float a = this->glyphs[j].advance;
-          transform = transform.translate(a, 0);
-        }
+    target->mark_dirty();
+
+    uint16_t key = size_key(size);
+    float scale = key / 16.0f / 128.0f;
+    rect_t clip = pixel_clip(target);
+    int py = floorf(y + 0.5f);
+
+    float pen = x;
+    while(*text) {
+      glyph_t *glyph = this->glyph(utf8_next(text));
+      if(!glyph) {
+        continue;
       }
+
+      draw_glyph(target, glyph, pen, py, key, clip);
+      pen += glyph->advance * scale;
     }
   }
 
+  rect_t font_t::render_bounds(const char *text, float size) {
+    return measure(text, size).pixel_bounds();
+  }
+
+  void font_t::render(image_t *mask, const char *text, float size, const rect_t &bounds) {
+    memset(mask->ptr(0, 0), 0, mask->buffer_size());
+
+    brush_t *pen = mask->brush();
+    rgb_color_t white(255, 255, 255, 255);
+    color_brush_t brush(white);
+    mask->brush(&brush);
+    draw(mask, text, -bounds.x, -bounds.y, size);
+    mask->brush(pen);
+  }
+
 }
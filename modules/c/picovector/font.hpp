@@ -7,6 +7,7 @@
 #include "shape.hpp"
 #include "types.hpp"
 #include "mat3.hpp"
+#include "text_metrics.hpp"
 
 namespace picovector {
 
@@ -19,10 +20,17 @@ namespace picovector {
     vec2_t transform(mat3_t *transform);
   };
 
+  // paths and glyphs find their points and paths by byte offsets from
+  // themselves rather than pointers, so a font's tables can be used straight
+  // from a file in memory
+
   class glyph_path_t {
   public:
     uint16_t point_count;
-    glyph_path_point_t *points;
+    uint16_t reserved;
+    int32_t points_offset;
+
+    glyph_path_point_t *points() { return (glyph_path_point_t *)((uint8_t *)this + points_offset); }
   };
 
   class glyph_t {
@@ -31,18 +39,77 @@ namespace picovector {
     int8_t x, y, w, h;
     int8_t advance;
     uint8_t path_count;
-    glyph_path_t *paths;
+    int32_t paths_offset;
 
+    glyph_path_t *paths() { return (glyph_path_t *)((uint8_t *)this + paths_offset); }
     rect_t bounds(mat3_t *transform);
   };
 
+  /*
+    version 2 AF, the in-memory layout of a font. everything is little
+    endian and each table is aligned to its type: the header is followed by
+    `glyph_count` glyph_t, `path_count` glyph_path_t and then `point_count`
+    glyph_path_point_t. version 1 files ("af!?") are big endian, packed and
+    have to be loaded into this layout first
+  */
+  struct af2_header_t {
+    char marker[4];         // "af!2"
+    uint16_t flags;
+    uint16_t glyph_count;
+    uint16_t path_count;
+    uint16_t reserved;
+    uint32_t point_count;
+  };
+
+  static_assert(sizeof(glyph_path_point_t) == 2, "AF points are 2 bytes");
+  static_assert(sizeof(glyph_path_t) == 8, "AF paths are 8 bytes");
+  static_assert(sizeof(glyph_t) == 12, "AF glyphs are 12 bytes");
+  static_assert(sizeof(af2_header_t) == 16, "AF v2 header is 16 bytes");
+
   class font_t {
   public:
     int glyph_count;
     glyph_t *glyphs;
 
+    // glyph index + 1 for each codepoint below 256, zero if there's no glyph
+    uint16_t latin1[256];
+    // indices of the glyphs for the remaining codepoints, sorted by codepoint
+    uint16_t *wide;
+    int wide_count;
+
+    // uses a version 2 font in place, `data` must stay valid for the life
+    // of the font and be 4 byte aligned. returns false if it isn't a valid
+    // version 2 font
+    bool map(const uint8_t *data, size_t size);
+    // the number of bytes a version 2 font with these tables takes up
+    static size_t mapped_size(uint32_t glyph_count, uint32_t path_count, uint32_t point_count);
+
+    // builds the codepoint lookup tables once the glyphs are loaded, `wide`
+    // needs room for `glyph_count` entries
+    void build_index(uint16_t *wide);
+    glyph_t *glyph(uint32_t codepoint);
+
+    // text is UTF-8
     void draw(image_t *target, const char *text, float x, float y, float size);
-    rect_t measure(image_t *target, const char *text, float size);
+    // draws one glyph with its pen at (x, y), `size_key` is the size in
+    // 1/16ths of a pixel and `clip` the target's clip in whole pixels
+    void draw_glyph(image_t *target, glyph_t *glyph, float x, int y, uint16_t size_key, const rect_t &clip);
+    static uint16_t size_key(float size);
+    static rect_t pixel_clip(image_t *target);
+
+    // draws `text` once into an A8 image as coverage. render_bounds() is
+    // the size of image needed and where its top left sits relative to the
+    // pen, blitting the image at (x, y) plus that offset with a pen then
+    // draws the same as draw() would at (x, y)
+    rect_t render_bounds(const char *text, float size);
+    void render(image_t *mask, const char *text, float size, const rect_t &bounds);
+
+    // the advance and ink boxes of `text` at `size`, as draw() would place
+    // it with the pen at the origin. the advance is the line height tall
+    text_metrics_t measure(const char *text, float size);
+    // one glyph's metrics at a size key, uncached. the ink box is the
+    // outline's, at small sizes thin strokes may leave its edges unlit
+    glyph_metrics_t glyph_metrics(glyph_t *glyph, uint16_t size_key);
   };
 
 }
\ No newline at end of file
@@ -0,0 +1,215 @@
+#include "glyph_cache.hpp"
+#include "mat3.hpp"
+
+namespace picovector {
+
+#if PV_GLYPH_CACHE_SIZE > 0
+
+  static constexpr int GLYPH_CACHE_BUCKETS = 64;
+  static constexpr int GLYPH_CACHE_SEEN = 128;
+
+  // bigger masks would push out too many others, they're drawn directly
+  static constexpr uint32_t GLYPH_CACHE_MAX_MASK = PV_GLYPH_CACHE_SIZE / 8;
+
+  static uint8_t __attribute__((aligned(4))) glyph_cache_arena[PV_GLYPH_CACHE_SIZE];
+  static glyph_cache_entry_t glyph_cache_entries[PV_GLYPH_CACHE_ENTRIES];
+  static int16_t glyph_cache_buckets[GLYPH_CACHE_BUCKETS];
+  static uint32_t glyph_cache_seen[GLYPH_CACHE_SEEN]; // keys that missed once
+  static bool glyph_cache_ready = false;
+  static uint32_t glyph_cache_top = 0;   // end of the packed masks
+  static uint32_t glyph_cache_clock = 0;
+
+  static uint32_t glyph_cache_hash(const glyph_t *glyph, uint16_t size, uint aa, int phase) {
+    uint32_t h = uint32_t(uintptr_t(glyph)) >> 2;
+    h ^= size * 0x9e37u;
+    h ^= ((aa << 8) | phase) * 0x85ebu;
+    h ^= h >> 16;
+    return h & (GLYPH_CACHE_BUCKETS - 1);
+  }
+
+  // a fuller hash of the same key, for the table of glyphs that have missed
+  static uint32_t glyph_cache_key(const glyph_t *glyph, uint16_t size, uint aa, int phase) {
+    uint32_t h = uint32_t(uintptr_t(glyph)) * 0x9e3779b1u;
+    h ^= (uint32_t(size) << 16 | aa << 8 | phase) * 0x85ebca6bu;
+    h ^= h >> 15;
+    return h | 1;
+  }
+
+  static void glyph_cache_evict(int i) {
+    glyph_cache_entry_t &e = glyph_cache_entries[i];
+    int16_t *link = &glyph_cache_buckets[glyph_cache_hash(e.glyph, e.size, e.aa, e.phase)];
+    while(*link != i) {
+      link = &glyph_cache_entries[*link].next;
+    }
+    *link = e.next;
+    e.font = nullptr;
+  }
+
+  static int glyph_cache_lru() {
+    int lru = -1;
+    for(int i = 0; i < PV_GLYPH_CACHE_ENTRIES; i++) {
+      const glyph_cache_entry_t &e = glyph_cache_entries[i];
+      if(e.font && (lru < 0 || e.used < glyph_cache_entries[lru].used)) {
+        lru = i;
+      }
+    }
+    return lru;
+  }
+
+  // moves the live masks down to the start of the arena in their current
+  // order, closing the gaps left by evicted glyphs
+  static void glyph_cache_compact() {
+    int16_t order[PV_GLYPH_CACHE_ENTRIES];
+    int n = 0;
+    for(int i = 0; i < PV_GLYPH_CACHE_ENTRIES; i++) {
+      if(glyph_cache_entries[i].font) {
+        order[n++] = i;
+      }
+    }
+    std::sort(order, order + n, [](int16_t a, int16_t b) {
+      return glyph_cache_entries[a].offset < glyph_cache_entries[b].offset;
+    });
+
+    glyph_cache_top = 0;
+    for(int k = 0; k < n; k++) {
+      glyph_cache_entry_t &e = glyph_cache_entries[order[k]];
+      uint32_t bytes = e.w * e.h;
+      if(e.offset != glyph_cache_top) {
+        memmove(glyph_cache_arena + glyph_cache_top, glyph_cache_arena + e.offset, bytes);
+        e.offset = glyph_cache_top;
+      }
+      glyph_cache_top += bytes;
+    }
+  }
+
+  // finds room for `bytes` of mask, evicting the least recently used glyphs
+  // if the arena is full
+  static uint32_t glyph_cache_alloc(uint32_t bytes) {
+    if(glyph_cache_top + bytes > PV_GLYPH_CACHE_SIZE) {
+      uint32_t live = 0;
+      for(int i = 0; i < PV_GLYPH_CACHE_ENTRIES; i++) {
+        const glyph_cache_entry_t &e = glyph_cache_entries[i];
+        if(e.font) live += e.w * e.h;
+      }
+
+      while(live + bytes > PV_GLYPH_CACHE_SIZE) {
+        int lru = glyph_cache_lru();
+        live -= glyph_cache_entries[lru].w * glyph_cache_entries[lru].h;
+        glyph_cache_evict(lru);
+      }
+
+      glyph_cache_compact();
+    }
+
+    uint32_t offset = glyph_cache_top;
+    glyph_cache_top += bytes;
+    return offset;
+  }
+
+  void glyph_cache_clear() {
+    for(int i = 0; i < PV_GLYPH_CACHE_ENTRIES; i++) {
+      glyph_cache_entries[i].font = nullptr;
+    }
+    std::fill(glyph_cache_buckets, glyph_cache_buckets + GLYPH_CACHE_BUCKETS, -1);
+    std::fill(glyph_cache_seen, glyph_cache_seen + GLYPH_CACHE_SEEN, 0);
+    glyph_cache_top = 0;
+    glyph_cache_ready = true;
+  }
+
+  void glyph_cache_forget(const font_t *font) {
+    if(!glyph_cache_ready) {
+      return;
+    }
+
+    for(int i = 0; i < PV_GLYPH_CACHE_ENTRIES; i++) {
+      if(glyph_cache_entries[i].font == font) {
+        glyph_cache_evict(i);
+      }
+    }
+  }
+
+  const uint8_t *glyph_cache_mask(const glyph_cache_entry_t *entry) {
+    return glyph_cache_arena + entry->offset;
+  }
+
+  const glyph_cache_entry_t *glyph_cache_get(font_t *font, glyph_t *glyph, uint16_t size, uint aa, int phase) {
+    if(!glyph_cache_ready) {
+      glyph_cache_clear();
+    }
+
+    uint32_t bucket = glyph_cache_hash(glyph, size, aa, phase);
+    for(int i = glyph_cache_buckets[bucket]; i >= 0; i = glyph_cache_entries[i].next) {
+      glyph_cache_entry_t &e = glyph_cache_entries[i];
+      if(e.glyph == glyph && e.font == font && e.size == size && e.aa == aa && e.phase == phase) {
+        e.used = ++glyph_cache_clock;
+        return &e;
+      }
+    }
+
+    // glyphs are only cached the second time they miss, so text drawn at
+    // a size that keeps changing (e.g. animated) doesn't flush the cache
+    uint32_t key = glyph_cache_key(glyph, size, aa, phase);
+    uint32_t &seen = glyph_cache_seen[key & (GLYPH_CACHE_SEEN - 1)];
+    if(seen != key) {
+      seen = key;
+      return nullptr;
+    }
+
+    // the same transform font_t::draw() uses, with the pen at the origin
+    float s = size / 16.0f;
+    mat3_t transform;
+    transform = transform.translate(float(phase) / GLYPH_CACHE_PHASES, s);
+    transform = transform.scale(s / 128.0f, s / 128.0f);
+
+    rect_t bounds = glyph->bounds(&transform).round();
+    uint32_t bytes = uint32_t(std::max(bounds.w, 0.0f) * std::max(bounds.h, 0.0f));
+    if(bytes > GLYPH_CACHE_MAX_MASK || bounds.w > 0xffff || bounds.h > 0xffff) {
+      return nullptr;
+    }
+
+    int slot = -1;
+    for(int i = 0; i < PV_GLYPH_CACHE_ENTRIES && slot < 0; i++) {
+      if(!glyph_cache_entries[i].font) slot = i;
+    }
+    if(slot < 0) {
+      slot = glyph_cache_lru();
+      glyph_cache_evict(slot);
+    }
+
+    glyph_cache_entry_t &e = glyph_cache_entries[slot];
+    e.offset = glyph_cache_alloc(bytes);
+    e.font = font;
+    e.glyph = glyph;
+    e.size = size;
+    e.aa = aa;
+    e.phase = phase;
+    e.x = bounds.x;
+    e.y = bounds.y;
+    e.w = bytes ? bounds.w : 0;
+    e.h = bytes ? bounds.h : 0;
+    e.used = ++glyph_cache_clock;
+    e.next = glyph_cache_buckets[bucket];
+    glyph_cache_buckets[bucket] = slot;
+
+    if(bytes) {
+      render_glyph_mask(glyph, &transform, aa, bounds, glyph_cache_arena + e.offset);
+    }
+    return &e;
+  }
+
+#else
+
+  const glyph_cache_entry_t *glyph_cache_get(font_t *font, glyph_t *glyph, uint16_t size, uint aa, int phase) {
+    return nullptr;
+  }
+
+  const uint8_t *glyph_cache_mask(const glyph_cache_entry_t *entry) {
+    return nullptr;
+  }
+
+  void glyph_cache_forget(const font_t *font) {}
+  void glyph_cache_clear() {}
+
+#endif
+
+}
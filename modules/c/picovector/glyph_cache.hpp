@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "picovector.hpp"
+#include "font.hpp"
+
+namespace picovector {
+
+  // horizontal sub-pixel positions each glyph is cached at
+  static constexpr int GLYPH_CACHE_PHASES = 4;
+
+  // a rasterised glyph, `size` is in 1/16ths of a pixel and `phase` is the
+  // pen's sub-pixel x offset in 1/GLYPH_CACHE_PHASES of a pixel
+  struct glyph_cache_entry_t {
+    const font_t *font;
+    const glyph_t *glyph;
+    uint16_t size;
+    uint8_t aa;
+    uint8_t phase;
+    int16_t x, y;    // top left of the mask relative to the pen
+    uint16_t w, h;
+    uint32_t offset; // of the mask in the arena
+    uint32_t used;   // when the entry was last drawn, for LRU eviction
+    int16_t next;    // next entry in the same hash bucket, -1 at the end
+  };
+
+  /*
+    coverage masks of vector font glyphs, rasterised once and then drawn
+    with the target's masked span function.
+
+    masks live in a fixed size arena (PV_GLYPH_CACHE_SIZE bytes). when it's
+    full the least recently used glyphs are evicted and the survivors are
+    packed down to make room, which only happens while the set of glyphs in
+    use is changing.
+
+    a glyph is only cached the second time it's asked for at the same size,
+    and masks larger than an eighth of the arena never are, so one off and
+    very large text is drawn directly rather than evicting everything else.
+  */
+
+  // the glyph's mask, rasterising it into the cache if it isn't there.
+  // returns null if the glyph should be drawn directly
+  const glyph_cache_entry_t *glyph_cache_get(font_t *font, glyph_t *glyph, uint16_t size, uint aa, int phase);
+  const uint8_t *glyph_cache_mask(const glyph_cache_entry_t *entry);
+
+  // drops every glyph of a font, needed before the font is freed
+  void glyph_cache_forget(const font_t *font);
+  void glyph_cache_clear();
+
+}
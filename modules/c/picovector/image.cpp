@@ -2,6 +2,7 @@
 #include <math.h>
 #include <algorithm>
 #include <vector>
+#include <type_traits>
 
 #include "rasteriser.hpp"
 #include "algorithms/algorithms.hpp"
@@ -25,6 +26,13 @@ namespace picovector {
     _clip = rect_t(0, 0, i.w, i.h);
     _buffer = source->ptr(i.x, i.y);
     _managed_buffer = false;
+    // compiled runs and mipmaps belong to the source's bounds, not the window's
+    _runs = sprite_runs_t();
+    _run_rows.clear();
+    _run_rows.shrink_to_fit();
+    _mipmaps = nullptr;
+    _mipmap_count = 0;
+    _mipmap_alloc_size = 0;
   }
 
   image_t::image_t(int w, int h, pixel_format_t pixel_format, bool has_palette) {
@@ -34,7 +42,7 @@ namespace picovector {
     _pixel_format = pixel_format;
     _has_palette = has_palette;
     _managed_buffer = true;
-    _bytes_per_pixel = this->_has_palette ? sizeof(uint8_t) : sizeof(uint32_t);
+    _bytes_per_pixel = pixel_format_size(pixel_format, has_palette);
     _row_stride = w * _bytes_per_pixel;
     _buffer = PV_MALLOC(this->buffer_size());
     if(_has_palette) {
@@ -50,7 +58,7 @@ namespace picovector {
     _has_palette = has_palette;
     _buffer = buffer;
     _managed_buffer = false;
-    _bytes_per_pixel = this->_has_palette ? sizeof(uint8_t) : sizeof(uint32_t);
+    _bytes_per_pixel = pixel_format_size(pixel_format, has_palette);
     _row_stride = w * _bytes_per_pixel;
     if(_has_palette) {
       _palette.resize(256);
@@ -58,6 +66,7 @@ namespace picovector {
   }
 
   image_t::~image_t() {
+    free_mipmaps();
     if(this->_managed_buffer) {
 #ifdef PICO
       PV_FREE(this->_buffer);
@@ -108,6 +117,28 @@ namespace picovector {
 
   void image_t::palette(uint8_t i, uint32_t c) {
     this->_palette[i] = c;
+    this->_palette_version++;
+    mark_dirty();
+  }
+
+  // returns the palette with the image's global alpha already applied. the
+  // scaled copy is only needed when alpha isn't 255 and is kept until either
+  // the palette or alpha change
+  const uint32_t *image_t::palette_lut() {
+    if(this->_alpha == 255) {
+      return this->_palette.data();
+    }
+
+    if(this->_palette_lut.empty() || this->_palette_lut_version != this->_palette_version || this->_palette_lut_alpha != this->_alpha) {
+      this->_palette_lut.resize(this->_palette.size());
+      for(size_t i = 0; i < this->_palette.size(); i++) {
+        this->_palette_lut[i] = _premul_mul_alpha(this->_palette[i], this->_alpha);
+      }
+      this->_palette_lut_version = this->_palette_version;
+      this->_palette_lut_alpha = this->_alpha;
+    }
+
+    return this->_palette_lut.data();
   }
 
   uint32_t image_t::palette(uint8_t i) {
@@ -123,6 +154,274 @@ namespace picovector {
     this->_alpha = alpha;
   }
 
+  // scans the image to find out how much of its alpha channel is used
+  template<typename S>
+  static opacity_t analyse_opacity(image_t *image, const S &fetch) {
+    rect_t b = image->bounds();
+    bool opaque = true;
+    for(int y = 0; y < b.h; y++) {
+      const typename S::pixel_t *p = (const typename S::pixel_t *)image->ptr(0, y);
+      for(int x = 0; x < b.w; x++) {
+        uint32_t a = _a(fetch(p[x]));
+        if(a != 255) {
+          if(a != 0) {
+            return OPACITY_GENERAL;
+          }
+          opaque = false;
+        }
+      }
+    }
+    return opaque ? OPACITY_OPAQUE : OPACITY_BINARY;
+  }
+
+  // returns the opacity class of the image, analysing it first if it's been
+  // drawn to since it was last checked.
+  //
+  // images over a buffer supplied from elsewhere (e.g. a memoryview), or
+  // whose buffer has been exported, can be written without us knowing so
+  // they aren't analysed, unless they're RGB565 which has no alpha at all
+  opacity_t image_t::opacity() {
+    if(this->_opacity != OPACITY_UNKNOWN && this->_opacity_generation == _root->_generation) {
+      return this->_opacity;
+    }
+
+    opacity_t opacity = OPACITY_GENERAL;
+    if(!_has_palette && _pixel_format == RGB565) {
+      opacity = OPACITY_OPAQUE;
+    } else if(tracked()) {
+      if(_has_palette) {
+        opacity = analyse_opacity(this, fetch_palette_t{_palette.data()});
+      } else {
+        switch(_pixel_format) {
+          case RGBA8888: opacity = analyse_opacity(this, fetch_rgba8888_t()); break;
+          case RGBA4444: opacity = analyse_opacity(this, fetch_rgba4444_t()); break;
+          default: break;
+        }
+      }
+    }
+
+    this->_opacity = opacity;
+    this->_opacity_generation = _root->_generation;
+    return opacity;
+  }
+
+  // splits each row into runs of opaque and partially transparent pixels,
+  // skipping anything fully transparent
+  template<typename S>
+  static void compile_runs(image_t *image, const S &fetch, sprite_runs_t &runs, std::vector<uint32_t, PV_STD_ALLOCATOR<uint32_t>> &rows) {
+    rect_t b = image->bounds();
+    rows.resize(b.h + 1);
+    for(int y = 0; y < b.h; y++) {
+      rows[y] = runs.size();
+      const typename S::pixel_t *p = (const typename S::pixel_t *)image->ptr(0, y);
+      int x = 0;
+      while(x < b.w) {
+        uint32_t a = _a(fetch(p[x]));
+        if(a == 0) {
+          x++;
+          continue;
+        }
+
+        bool opaque = a == 255;
+        int start = x;
+        while(x < b.w && x - start < 0x7fff) {
+          a = _a(fetch(p[x]));
+          if(a == 0 || (a == 255) != opaque) {
+            break;
+          }
+          x++;
+        }
+        runs.push_back({uint16_t(start), uint16_t(x - start), opaque});
+      }
+    }
+    rows[b.h] = runs.size();
+  }
+
+  // builds a run-length form of the image that blits can walk instead of
+  // testing every pixel, worthwhile for mostly transparent sprites that are
+  // drawn often. the runs are dropped (and blits go back to the normal path)
+  // as soon as the image is drawn to again.
+  //
+  // returns false for A8 images, which are drawn as masks, and for images
+  // that aren't tracked() since the runs could go stale unnoticed
+  bool image_t::compile() {
+    _runs.clear();
+    _run_rows.clear();
+
+    if(!tracked()) {
+      return false;
+    }
+
+    if(_has_palette) {
+      compile_runs(this, fetch_palette_t{_palette.data()}, _runs, _run_rows);
+    } else {
+      switch(_pixel_format) {
+        case RGBA8888: compile_runs(this, fetch_rgba8888_t(), _runs, _run_rows); break;
+        case RGBA4444: compile_runs(this, fetch_rgba4444_t(), _runs, _run_rows); break;
+        case RGB565:   compile_runs(this, fetch_rgb565_t(), _runs, _run_rows); break;
+        default: return false;
+      }
+    }
+
+    _runs.shrink_to_fit();
+    _runs_generation = _root->_generation;
+    return true;
+  }
+
+  // true if compile() has been called and the image hasn't changed since
+  bool image_t::compiled() {
+    if(_run_rows.empty()) {
+      return false;
+    }
+
+    if(_runs_generation != _root->_generation || !tracked()) {
+      _runs = sprite_runs_t();
+      _run_rows.clear();
+      _run_rows.shrink_to_fit();
+      return false;
+    }
+
+    return true;
+  }
+
+  // averages 2x2 blocks of `src` into `dst`, the last row and column are
+  // repeated for odd sizes
+  template<typename S>
+  static void mipmap_downsample(image_t *src, const S &fetch, image_t *dst) {
+    rect_t sb = src->bounds();
+    rect_t db = dst->bounds();
+    int sw = sb.w;
+    int sh = sb.h;
+    for(int y = 0; y < db.h; y++) {
+      const typename S::pixel_t *r0 = (const typename S::pixel_t *)src->ptr(0, std::min(y * 2, sh - 1));
+      const typename S::pixel_t *r1 = (const typename S::pixel_t *)src->ptr(0, std::min(y * 2 + 1, sh - 1));
+      uint32_t *pd = (uint32_t *)dst->ptr(0, y);
+      for(int x = 0; x < db.w; x++) {
+        int x0 = std::min(x * 2, sw - 1);
+        int x1 = std::min(x * 2 + 1, sw - 1);
+        uint32_t c0 = fetch(r0[x0]), c1 = fetch(r0[x1]), c2 = fetch(r1[x0]), c3 = fetch(r1[x1]);
+        // sum red/blue and green/alpha in pairs of 16-bit lanes
+        uint32_t rb = (c0 & 0x00ff00ffu) + (c1 & 0x00ff00ffu) + (c2 & 0x00ff00ffu) + (c3 & 0x00ff00ffu) + 0x00020002u;
+        uint32_t ga = ((c0 >> 8) & 0x00ff00ffu) + ((c1 >> 8) & 0x00ff00ffu) + ((c2 >> 8) & 0x00ff00ffu) + ((c3 >> 8) & 0x00ff00ffu) + 0x00020002u;
+        pd[x] = ((rb >> 2) & 0x00ff00ffu) | (((ga >> 2) & 0x00ff00ffu) << 8);
+      }
+    }
+  }
+
+  // builds the chain of mipmaps down to 1x1, used by image brushes and scaled
+  // or transformed blits that shrink the image. like compile() the chain is
+  // dropped once the image is drawn to.
+  //
+  // returns false for A8 images, which are drawn as masks, and for images
+  // that aren't tracked()
+  bool image_t::generate_mipmaps() {
+    free_mipmaps();
+
+    if((_pixel_format == A8 && !_has_palette) || !tracked()) {
+      return false;
+    }
+
+    int w = _bounds.w;
+    int h = _bounds.h;
+    int count = 0;
+    size_t pixels = 0;
+    while(w > 1 || h > 1) {
+      w = std::max(w >> 1, 1);
+      h = std::max(h >> 1, 1);
+      pixels += w * h;
+      count++;
+    }
+
+    if(count == 0) {
+      return false;
+    }
+
+    _mipmap_alloc_size = sizeof(image_t) * count + sizeof(uint32_t) * pixels;
+    _mipmaps = (image_t *)PV_MALLOC(_mipmap_alloc_size);
+    _mipmap_count = count;
+
+    uint32_t *buffer = (uint32_t *)(_mipmaps + count);
+    image_t *src = this;
+    w = _bounds.w;
+    h = _bounds.h;
+    for(int i = 0; i < count; i++) {
+      w = std::max(w >> 1, 1);
+      h = std::max(h >> 1, 1);
+      image_t *level = new(&_mipmaps[i]) image_t(buffer, w, h, RGBA8888);
+      buffer += w * h;
+
+      if(src->_has_palette) {
+        mipmap_downsample(src, fetch_palette_t{src->_palette.data()}, level);
+      } else {
+        switch(src->_pixel_format) {
+          case RGBA4444: mipmap_downsample(src, fetch_rgba4444_t(), level); break;
+          case RGB565:   mipmap_downsample(src, fetch_rgb565_t(), level); break;
+          default:       mipmap_downsample(src, fetch_rgba8888_t(), level); break;
+        }
+      }
+      src = level;
+    }
+
+    _mipmap_generation = _root->_generation;
+    return true;
+  }
+
+  void image_t::free_mipmaps() {
+    if(!_mipmaps) {
+      return;
+    }
+
+    for(int i = 0; i < _mipmap_count; i++) {
+      _mipmaps[i].~image_t();
+    }
+#ifdef PICO
+    PV_FREE(_mipmaps);
+#else
+    PV_FREE(_mipmaps, _mipmap_alloc_size);
+#endif
+    _mipmaps = nullptr;
+    _mipmap_count = 0;
+    _mipmap_alloc_size = 0;
+  }
+
+  // number of mipmaps available below the full size image, zero if they
+  // haven't been generated or the image has changed since
+  int image_t::mipmap_levels() {
+    if(_mipmaps && (_mipmap_generation != _root->_generation || !tracked())) {
+      free_mipmaps();
+    }
+    return _mipmap_count;
+  }
+
+  // level 0 is the image itself
+  image_t *image_t::mipmap(int level) {
+    if(level <= 0 || level > mipmap_levels()) {
+      return this;
+    }
+    return &_mipmaps[level - 1];
+  }
+
+  // the level to sample when each target pixel covers `texels_per_pixel`
+  // source pixels
+  int image_t::mipmap_level(float texels_per_pixel) {
+    int levels = mipmap_levels();
+    int level = 0;
+    while(level < levels && texels_per_pixel >= 2.0f) {
+      texels_per_pixel *= 0.5f;
+      level++;
+    }
+    return level;
+  }
+
+  // returns the image to sample from for the given scale and which level it
+  // is, the mipmaps carry this image's alpha
+  image_t *image_t::mipmap_for_scale(float texels_per_pixel, int *level) {
+    *level = mipmap_level(texels_per_pixel);
+    image_t *result = mipmap(*level);
+    result->_alpha = _alpha;
+    return result;
+  }
+
   antialias_t image_t::antialias() {
     return this->_antialias;
   }
@@ -138,6 +437,9 @@ namespace picovector {
 
   void image_t::pixel_format(pixel_format_t pixel_format) {
     this->_pixel_format = pixel_format;
+    if(this->_brush) {
+      this->brush(this->_brush);
+    }
   }
 
   brush_t* image_t::brush() {
@@ -146,10 +448,9 @@ namespace picovector {
 
   void image_t::brush(brush_t *brush) {
     this->_brush = brush;
-    this->_span_func = brush->span_func();
-    this->_masked_span_func = brush->masked_span_func();
-    // this->_span_func = brush->get_span_func(this);
-    // this->_mask_span_func = brush->get_mask_span_func(this);
+    // no brush draws nothing
+    this->_span_func = brush ? brush->span_func(this->_pixel_format) : span_func_nop;
+    this->_masked_span_func = brush ? brush->masked_span_func(this->_pixel_format) : masked_span_func_nop;
   }
 
   font_t* image_t::font() {
@@ -235,36 +536,103 @@ namespace picovector {
     }
   }
 
+  // draws the whole of a compiled image with its top left corner at (x, y),
+  // clipped to the target's clip rect
+  void image_t::blit_compiled(image_t *target, int x, int y, bool flip_h, bool flip_v) {
+    int w = _bounds.w;
+    int h = _bounds.h;
+
+    rect_t c = target->_clip;
+    int x0 = c.x;
+    int x1 = c.x + c.w;
+    int y0 = std::max(y, int(c.y));
+    int y1 = std::min(y + h, int(c.y + c.h));
+    if(y0 >= y1 || x >= x1 || x + w <= x0) {
+      return;
+    }
+
+    target->mark_dirty();
+
+    // opaque runs can only be stored as-is if no global alpha is applied
+    bool store_opaque = _alpha == 255;
+    blend_func_t bf = target->_blend_func;
+    const sprite_run_t *runs = _runs.data();
+
+    blit_dispatch(this, target, [&](const auto &fetch, uint32_t alpha, auto *dst_type) {
+      typedef typename std::remove_pointer<decltype(dst_type)>::type T;
+      for(int dy = y0; dy < y1; dy++) {
+        int sy = flip_v ? y + h - 1 - dy : dy - y;
+        span_blit_runs<T>(fetch, alpha, store_opaque, runs + _run_rows[sy], runs + _run_rows[sy + 1], this, target, bf, sy, x, dy, x0, x1, flip_h);
+      }
+    });
+  }
+
   void image_t::blit(image_t *target, const vec2_t p) {
+    if(compiled()) {
+      blit_compiled(target, floor(p.x), floor(p.y), false, false);
+      return;
+    }
+
     rect_t sr = _bounds;
     rect_t tr(p.x, p.y, sr.w, sr.h); // target rect
 
     sr = sr.floor();
     tr = tr.floor();
     clip_blit_rect(sr, _bounds, tr);
-    clip_blit_rect(tr, target->_bounds, sr);
+    clip_blit_rect(tr, target->_clip, sr);
     if(sr.w <= 0 || sr.h <= 0 || tr.w <= 0 || tr.h <= 0) {
       return;
     }
 
-    blend_func_t bf = target->_blend_func;
+    target->mark_dirty();
 
-    for(int y = 0; y < tr.h; y++) {
-      if(_has_palette) {
-        span_blit(this, target, bf, sr.x, sr.y + y, tr.x, tr.y + y, tr.w, _palette);
-      }else{
-        span_blit(this, target, bf, sr.x, sr.y + y, tr.x, tr.y + y, tr.w);
+    if(_pixel_format == A8 && !_has_palette) {
+      for(int y = 0; y < tr.h; y++) {
+        span_blit_mask(this, target, sr.x, sr.y + y, tr.x, tr.y + y, tr.w);
+      }
+      return;
+    }
+
+    opacity_t opacity = _alpha == 255 ? this->opacity() : OPACITY_GENERAL;
+
+    // opaque rows can be copied as-is into a target of the same format
+    if(opacity == OPACITY_OPAQUE && !_has_palette && !target->_has_palette &&
+       _pixel_format == target->_pixel_format && _root != target->_root) {
+      size_t row_bytes = size_t(tr.w) * _bytes_per_pixel;
+      for(int y = 0; y < tr.h; y++) {
+        memcpy(target->ptr(tr.x, tr.y + y), this->ptr(sr.x, sr.y + y), row_bytes);
       }
+      return;
     }
+
+    blend_func_t bf = target->_blend_func;
+
+    blit_dispatch(this, target, [&](const auto &fetch, uint32_t alpha, auto *dst_type) {
+      typedef typename std::remove_pointer<decltype(dst_type)>::type T;
+      for(int y = 0; y < tr.h; y++) {
+        span_blit<T>(fetch, alpha, opacity, this, target, bf, sr.x, sr.y + y, tr.x, tr.y + y, tr.w);
+      }
+    });
   }
 
 
   // blit from source rectangle into target rectangle
-  void image_t::blit(image_t *target, rect_t sr, rect_t tr) {
+  void image_t::blit(image_t *target, rect_t sr, rect_t tr, filter_t filter) {
+    // shrinking blits sample from the closest mipmap instead
+    if(_mipmaps) {
+      int level;
+      image_t *mip = mipmap_for_scale(std::max(fabsf(sr.w / tr.w), fabsf(sr.h / tr.h)), &level);
+      if(level > 0) {
+        float s = 1.0f / float(1 << level);
+        mip->blit(target, rect_t(sr.x * s, sr.y * s, sr.w * s, sr.h * s), tr, filter);
+        return;
+      }
+    }
+
     bool flip_h = tr.w < 0;
     bool flip_v = tr.h < 0;
 
-    // clip target rect to target bounds
+    // clip target rect to the target's clip rect
     // printf("pre clip\n");
     // printf("- sr = %.2f, %.2f (%.2f x %.2f)\n", sr.x, sr.y, sr.w, sr.h);
     // printf("- tr = %.2f, %.2f (%.2f x %.2f)\n", tr.x, tr.y, tr.w, tr.h);
@@ -272,11 +640,32 @@ namespace picovector {
     tr.h = fabs(tr.h);
     sr = sr.round();
     tr = tr.round();
+
+    // unscaled blits of the whole image can use the compiled runs
+    if(sr == _bounds && tr.w == _bounds.w && tr.h == _bounds.h && compiled()) {
+      blit_compiled(target, tr.x, tr.y, flip_h, flip_v);
+      return;
+    }
+
     clip_blit_rect(sr, _bounds, tr);
-    clip_blit_rect(tr, target->_bounds, sr);
+
+    // filtered blits map each target pixel centre back into the source so
+    // they need the rects before they're clipped to the target
+    rect_t map_sr = sr;
+    rect_t map_tr = tr;
+
+    clip_blit_rect(tr, target->_clip, sr);
     if(sr.w <= 0 || sr.h <= 0 || tr.w <= 0 || tr.h <= 0) {
       return;
     }
+
+    target->mark_dirty();
+
+    if(filter == BILINEAR) {
+      blit_filtered(target, map_sr, map_tr, tr, flip_h, flip_v);
+      return;
+    }
+
     // printf("post clip\n");
     // printf("- sr = %.2f, %.2f (%.2f x %.2f)\n", sr.x, sr.y, sr.w, sr.h);
     // printf("- tr = %.2f, %.2f (%.2f x %.2f)\n", tr.x, tr.y, tr.w, tr.h);
@@ -300,20 +689,178 @@ namespace picovector {
       srcy = ((_bounds.h - sr.y) * 65536.0f) + srcstepy;
     }
 
-    for(int y = tr.y; y < tr.y + tr.h; y++) {
-      if(this->_has_palette) {
-        span_blit_scale(this, target, bf, srcx, srcstepx, srcy, tr.x, y, tr.w, _palette);
-      }else{
-        span_blit_scale(this, target, bf, srcx, srcstepx, srcy, tr.x, y, tr.w);
+    if(_pixel_format == A8 && !_has_palette) {
+      for(int y = tr.y; y < tr.y + tr.h; y++) {
+        span_blit_scale_mask(this, target, srcx, srcstepx, srcy, tr.x, y, tr.w);
+        srcy += srcstepy;
+      }
+      return;
+    }
+
+    opacity_t opacity = _alpha == 255 ? this->opacity() : OPACITY_GENERAL;
+
+    blit_dispatch(this, target, [&](const auto &fetch, uint32_t alpha, auto *dst_type) {
+      typedef typename std::remove_pointer<decltype(dst_type)>::type T;
+      for(int y = tr.y; y < tr.y + tr.h; y++) {
+        span_blit_scale<T>(fetch, alpha, opacity, this, target, bf, srcx, srcstepx, srcy, tr.x, y, tr.w);
+        srcy += srcstepy;
       }
+    });
+  }
+
+
+  void image_t::blit(image_t *target, rect_t tr, filter_t filter) {
+    blit(target, _bounds, tr, filter);
+  }
+
 
-      srcy += srcstepy;
+  // bilinear filtered scaled blit of `sr` into `tr`, only the part of `tr`
+  // inside `clip` is drawn
+  void image_t::blit_filtered(image_t *target, rect_t sr, rect_t tr, rect_t clip, bool flip_h, bool flip_v) {
+    // the clipped rect isn't always on whole pixels once the source clip has
+    // scaled it
+    rect_t b = target->_bounds;
+    int x0 = std::max(int(floorf(clip.x)), int(b.x));
+    int x1 = std::min(int(ceilf(clip.x + clip.w)), int(b.x + b.w));
+    int y0 = std::max(int(floorf(clip.y)), int(b.y));
+    int y1 = std::min(int(ceilf(clip.y + clip.h)), int(b.y + b.h));
+    if(x0 >= x1 || y0 >= y1) {
+      return;
+    }
+
+    // sample from whole pixels only
+    sr = sr.round();
+    if(sr.w <= 0 || sr.h <= 0) {
+      return;
+    }
+
+    float scale_x = sr.w / tr.w;
+    float scale_y = sr.h / tr.h;
+    fx16_t du = f_to_fx16(flip_h ? -scale_x : scale_x);
+
+    // source position of the centre of the first target pixel on each row
+    float ou = (x0 - tr.x + 0.5f) * scale_x;
+    fx16_t u = f_to_fx16(flip_h ? sr.x + sr.w - ou : sr.x + ou);
+
+    if(_pixel_format == A8 && !_has_palette) {
+      for(int y = y0; y < y1; y++) {
+        float ov = (y - tr.y + 0.5f) * scale_y;
+        fx16_t v = f_to_fx16(flip_v ? sr.y + sr.h - ov : sr.y + ov);
+        span_blit_affine_mask(this, sr, target, BILINEAR, u, v, du, 0, x0, y, x1 - x0);
+      }
+      return;
     }
+
+    blend_func_t bf = target->_blend_func;
+
+    blit_dispatch(this, target, [&](const auto &fetch, uint32_t alpha, auto *dst_type) {
+      typedef typename std::remove_pointer<decltype(dst_type)>::type T;
+      for(int y = y0; y < y1; y++) {
+        float ov = (y - tr.y + 0.5f) * scale_y;
+        fx16_t v = f_to_fx16(flip_v ? sr.y + sr.h - ov : sr.y + ov);
+        span_blit_affine<T>(fetch, alpha, BILINEAR, this, sr, target, bf, u, v, du, 0, x0, y, x1 - x0);
+      }
+    });
   }
 
 
-  void image_t::blit(image_t *target, rect_t tr) {
-    blit(target, _bounds, tr);
+  // draws the image transformed by `transform`, which maps source pixel
+  // coordinates onto the target. each target row is clipped to the exact
+  // span covered by the transformed image before any sampling is done.
+  void image_t::blit(image_t *target, const mat3_t &transform, filter_t filter) {
+    float w = _bounds.w;
+    float h = _bounds.h;
+
+    // bounding box of the transformed image on the target
+    vec2_t corners[4] = {vec2_t(0, 0), vec2_t(w, 0), vec2_t(w, h), vec2_t(0, h)};
+    float minx = INFINITY, miny = INFINITY, maxx = -INFINITY, maxy = -INFINITY;
+    for(auto &c : corners) {
+      float x = transform.v00 * c.x + transform.v01 * c.y + transform.v02;
+      float y = transform.v10 * c.x + transform.v11 * c.y + transform.v12;
+      minx = std::min(minx, x); maxx = std::max(maxx, x);
+      miny = std::min(miny, y); maxy = std::max(maxy, y);
+    }
+
+    rect_t c = target->_clip;
+    int x0 = std::max(int(floorf(minx)), int(c.x));
+    int x1 = std::min(int(ceilf(maxx)), int(c.x + c.w));
+    int y0 = std::max(int(floorf(miny)), int(c.y));
+    int y1 = std::min(int(ceilf(maxy)), int(c.y + c.h));
+    if(x0 >= x1 || y0 >= y1) {
+      return;
+    }
+
+    target->mark_dirty();
+
+    mat3_t inv = transform;
+    inv.inverse();
+
+    // degenerate transforms squash the image to nothing (and would overflow
+    // the fixed point steps)
+    if(!(fabsf(inv.v00) < 32767.0f && fabsf(inv.v10) < 32767.0f &&
+         fabsf(inv.v01) < 32767.0f && fabsf(inv.v11) < 32767.0f)) {
+      return;
+    }
+
+    // shrinking transforms sample from the closest mipmap instead, scaled up
+    // to cover the same area
+    if(_mipmaps) {
+      float texels = std::max(sqrtf(inv.v00 * inv.v00 + inv.v10 * inv.v10), sqrtf(inv.v01 * inv.v01 + inv.v11 * inv.v11));
+      int level;
+      image_t *mip = mipmap_for_scale(texels, &level);
+      if(level > 0) {
+        mat3_t m = transform;
+        m.scale(float(1 << level));
+        mip->blit(target, m, filter);
+        return;
+      }
+    }
+
+    // source position of target pixel centre (x, y) is
+    // (inv.v00 * x + inv.v01 * y + inv.v02, inv.v10 * x + inv.v11 * y + inv.v12)
+    fx16_t du = f_to_fx16(inv.v00);
+    fx16_t dv = f_to_fx16(inv.v10);
+    bool mask = _pixel_format == A8 && !_has_palette;
+    blend_func_t bf = target->_blend_func;
+
+    auto row = [&](int y, auto span) {
+      float cx = x0 + 0.5f;
+      float cy = y + 0.5f;
+      float u = inv.v00 * cx + inv.v01 * cy + inv.v02;
+      float v = inv.v10 * cx + inv.v11 * cy + inv.v12;
+
+      float lo = 0.0f;
+      float hi = x1 - x0;
+      if(!affine_span_range(u, inv.v00, w, lo, hi) || !affine_span_range(v, inv.v10, h, lo, hi)) {
+        return;
+      }
+
+      int start = ceilf(lo);
+      int end = ceilf(hi);
+      if(start >= end) {
+        return;
+      }
+
+      span(f_to_fx16(u + inv.v00 * start), f_to_fx16(v + inv.v10 * start), x0 + start, y, end - start);
+    };
+
+    if(mask) {
+      for(int y = y0; y < y1; y++) {
+        row(y, [&](fx16_t u, fx16_t v, int x, int y, int count) {
+          span_blit_affine_mask(this, _bounds, target, filter, u, v, du, dv, x, y, count);
+        });
+      }
+      return;
+    }
+
+    blit_dispatch(this, target, [&](const auto &fetch, uint32_t alpha, auto *dst_type) {
+      typedef typename std::remove_pointer<decltype(dst_type)>::type T;
+      for(int y = y0; y < y1; y++) {
+        row(y, [&](fx16_t u, fx16_t v, int x, int y, int count) {
+          span_blit_affine<T>(fetch, alpha, filter, this, _bounds, target, bf, u, v, du, dv, x, y, count);
+        });
+      }
+    });
   }
 
 
@@ -328,43 +875,99 @@ namespace picovector {
   */
   void image_t::vspan_tex(image_t *target, vec2_t p, uint c, vec2_t uvs, vec2_t uve) {
     rect_t b = target->_clip;
-    if(p.x < b.x || p.x > b.x + b.w) {
+    int x = p.x;
+    int y = p.y;
+    int h = c;
+    if(x < b.x || x >= b.x + b.w || h <= 0) {
       return;
     }
 
+    // each pixel samples the texture one step further along, rounded to the
+    // nearest texel. the end points are kept inside the texture so every
+    // step in between is too
     float ustep = (uve.x - uvs.x) / float(c);
     float vstep = (uve.y - uvs.y) / float(c);
-    float u = uvs.x;
-    float v = uvs.y;
+    float tw = _bounds.w - 1;
+    float th = _bounds.h - 1;
+    float u0 = std::clamp(uvs.x + ustep, 0.0f, tw);
+    float v0 = std::clamp(uvs.y + vstep, 0.0f, th);
+    float u1 = std::clamp(uvs.x + ustep * h, 0.0f, tw);
+    float v1 = std::clamp(uvs.y + vstep * h, 0.0f, th);
+    fx16_t du = h > 1 ? lroundf((u1 - u0) / (h - 1) * 65536.0f) : 0;
+    fx16_t dv = h > 1 ? lroundf((v1 - v0) / (h - 1) * 65536.0f) : 0;
+    fx16_t u = f_to_fx16(u0 + 0.5f);
+    fx16_t v = f_to_fx16(v0 + 0.5f);
+
+    // clip once, skipping the texture forward past any rows above the clip
+    int y0 = std::max(y, int(b.y));
+    int y1 = std::min(y + h, int(b.y + b.h));
+    if(y0 >= y1) {
+      return;
+    }
+    u += du * (y0 - y);
+    v += dv * (y0 - y);
+
+    target->mark_dirty();
+
+    blend_func_t bf = target->_blend_func;
+    blit_dispatch(this, target, [&](const auto &fetch, uint32_t alpha, auto *dst_type) {
+      typedef typename std::remove_pointer<decltype(dst_type)>::type T;
+      vspan_blit<T>(fetch, alpha, 255, this, target, bf, x, y0, y1 - y0, u, v, du, dv);
+    });
+  }
 
-    for(int y = p.y; y < p.y + c; y++) {
-      u += ustep;
-      v += vstep;
+  /*
+    draws a batch of textured vertical spans, e.g. the wall pass of a
+    raycaster, in one go. each span stretches the full height of texture
+    column `u` over `h` pixels from (x, y) down.
 
-      if(y >= b.y && y < b.y + b.h) {
-        uint32_t *dst = (uint32_t *)target->ptr(p.x, y);
+    if given, `shade` is a lookup table of brightness (255 is full) indexed
+    by span height (the last entry is used for taller spans) so that nearer,
+    taller walls can be lit differently to distant ones
+  */
+  void image_t::vspan_tex_batch(image_t *target, const vspan_t *spans, int count, const uint8_t *shade, int shade_count) {
+    rect_t b = target->_clip;
+    int cx0 = b.x, cx1 = b.x + b.w;
+    int cy0 = b.y, cy1 = b.y + b.h;
+    int tw = _bounds.w;
+    int th = _bounds.h;
 
-        int tx = round(u);
-        int ty = round(v);
+    target->mark_dirty();
 
-        uint32_t col;
-        if(this->_has_palette) {
-          col = this->_palette[*(uint8_t *)this->ptr(tx, ty)];
-        } else {
-          col = *((uint32_t *)this->ptr(tx, ty));
+    blend_func_t bf = target->_blend_func;
+    blit_dispatch(this, target, [&](const auto &fetch, uint32_t alpha, auto *dst_type) {
+      typedef typename std::remove_pointer<decltype(dst_type)>::type T;
+      for(int i = 0; i < count; i++) {
+        const vspan_t &s = spans[i];
+        if(s.x < cx0 || s.x >= cx1 || s.h <= 0) {
+          continue;
         }
 
-        *dst = target->_blend_func(*dst, _r(col), _g(col), _b(col), _a(col));
+        int y0 = std::max(int(s.y), cy0);
+        int y1 = std::min(s.y + s.h, cy1);
+        if(y0 >= y1) {
+          continue;
+        }
+
+        // sample at texel centres down the full height of the column
+        fx16_t dv = (th << 16) / s.h;
+        fx16_t v = (dv >> 1) + dv * (y0 - s.y);
+        fx16_t u = std::clamp(int(s.u), 0, tw - 1) << 16;
+        uint32_t sh = shade_count > 0 ? shade[std::min(int(s.h), shade_count - 1)] : 255;
+
+        vspan_blit<T>(fetch, alpha, sh, this, target, bf, s.x, y0, y1 - y0, u, v, 0, dv);
       }
-    }
+    });
   }
 
 
   void image_t::draw(shape_t *shape) {
+    mark_dirty();
     render(shape, this, &shape->transform, _brush);
   }
 
   void image_t::rectangle(rect_t r) {
+    mark_dirty();
     r = r.intersection(_clip);
     span_func_t fn = this->_span_func;
     for(int y = r.y; y < r.y + r.h; y++) {
@@ -383,6 +986,7 @@ namespace picovector {
     if(x + w >= _clip.x + _clip.w) {
       w = _clip.x + _clip.w - x;
     }
+    mark_dirty();
     this->_span_func(this, this->_brush, x, y, w);
   }
 
@@ -398,6 +1002,7 @@ namespace picovector {
       w = _clip.x + _clip.w - x;
     }
 
+    mark_dirty();
     this->_masked_span_func(this, this->_brush, x, y, w, mask);
   }
 
@@ -437,6 +1042,7 @@ namespace picovector {
   }
 
   void image_t::triangle(vec2_t p1, vec2_t p2, vec2_t p3) {
+    mark_dirty();
     rect_t b(
       vec2_t(min(p1.x, min(p2.x, p3.x)), min(p1.y, min(p2.y, p3.y))),
       vec2_t(max(p1.x, max(p2.x, p3.x)), max(p1.y, max(p2.y, p3.y)))
@@ -506,6 +1112,7 @@ namespace picovector {
 
 
   void image_t::line(vec2_t p1, vec2_t p2) {
+    mark_dirty();
     rect_t b = this->_clip;
     b.w -= 1;
     b.h -= 1; // TODO: this is hacky... fix it properly
@@ -540,12 +1147,14 @@ namespace picovector {
   }
 
   void image_t::put(int x, int y) {
+    mark_dirty();
     x = max(int(_clip.x), min(x, int(_clip.x + _clip.w - 1)));
     y = max(int(_clip.y), min(y, int(_clip.y + _clip.h - 1)));
     this->_span_func(this, this->_brush, x, y, 1);
   }
 
   void image_t::put_unsafe(int x, int y) {
+    mark_dirty();
     this->_span_func(this, this->_brush, x, y, 1);
     //this->_brush->render_span(this, x, y, 1);
   }
@@ -565,7 +1174,12 @@ namespace picovector {
       uint8_t pi = *((uint8_t *)ptr(x, y));
       return this->_palette[pi];
     }
-    return *((uint32_t *)ptr(x, y));
+    switch(this->_pixel_format) {
+      case RGB565:   return _rgb565_to_rgba8888(*((uint16_t *)ptr(x, y)));
+      case RGBA4444: return _rgba4444_to_rgba8888(*((uint16_t *)ptr(x, y)));
+      case A8:       return _a8_to_rgba8888(*((uint8_t *)ptr(x, y)));
+      default:       return *((uint32_t *)ptr(x, y));
+    }
   }
 
 
@@ -30,13 +30,64 @@ namespace picovector {
     X4    = 2
   } antialias_t;
 
+  // how source pixels are sampled by scaled and transformed blits
+  typedef enum filter_t {
+    NEAREST  = 0,
+    BILINEAR = 1,
+  } filter_t;
+
   typedef enum pixel_format_t {
     RGBA8888 = 1,
     RGBA4444 = 2,
+    RGB565   = 3,
+    A8       = 4,
   } pixel_format_t;
 
+  // storage size of one pixel in the given format
+  inline size_t pixel_format_size(pixel_format_t pixel_format, bool has_palette=false) {
+    if(has_palette) {
+      return sizeof(uint8_t);
+    }
+    switch(pixel_format) {
+      case RGBA4444:
+      case RGB565:
+        return sizeof(uint16_t);
+      case A8:
+        return sizeof(uint8_t);
+      default:
+        return sizeof(uint32_t);
+    }
+  }
+
+  // how much of an image's alpha channel is actually used, lets blits skip
+  // blending (or just copy rows) when they can
+  typedef enum opacity_t {
+    OPACITY_UNKNOWN = 0,  // not analysed yet
+    OPACITY_OPAQUE  = 1,  // every pixel is fully opaque
+    OPACITY_BINARY  = 2,  // every pixel is either fully opaque or fully transparent
+    OPACITY_GENERAL = 3,  // anything else
+  } opacity_t;
+
   typedef std::vector<uint32_t, PV_STD_ALLOCATOR<uint32_t>> palette_t;
 
+  // one column for image_t::vspan_tex_batch()
+  struct vspan_t {
+    int16_t x;
+    int16_t y;
+    int16_t h;
+    int16_t u;
+  };
+
+  // a horizontal run of visible pixels in a compiled image (see
+  // image_t::compile()), the gaps between runs are fully transparent
+  struct sprite_run_t {
+    uint16_t x;
+    uint16_t w : 15;
+    uint16_t opaque : 1;
+  };
+
+  typedef std::vector<sprite_run_t, PV_STD_ALLOCATOR<sprite_run_t>> sprite_runs_t;
+
   class mat3_t;
   class font_t;
   class pixel_font_t;
@@ -62,6 +113,40 @@ namespace picovector {
       font_t            *_font = nullptr;
       pixel_font_t      *_pixel_font = nullptr;
       palette_t          _palette;
+      uint32_t           _palette_version = 0;
+
+      // the image that owns the pixel buffer (this image unless it's a
+      // window) and a count of modifications made to it through any window
+      image_t           *_root = this;
+      uint32_t           _generation = 0;
+      // set once the pixels have been handed out to be written directly,
+      // after which they can change without the image knowing
+      bool               _exported = false;
+      opacity_t          _opacity = OPACITY_UNKNOWN;
+      uint32_t           _opacity_generation = 0;
+      palette_t          _palette_lut;
+      uint32_t           _palette_lut_version = 0;
+      uint8_t            _palette_lut_alpha = 255;
+
+      // run-length form of the image built by compile(), the runs for row y
+      // are _runs[_run_rows[y]] up to (but not including) _runs[_run_rows[y + 1]]
+      sprite_runs_t      _runs;
+      std::vector<uint32_t, PV_STD_ALLOCATOR<uint32_t>> _run_rows;
+      uint32_t           _runs_generation = 0;
+
+      // box filtered RGBA8888 copies of the image at half, quarter, ... size
+      // built by generate_mipmaps(). the level images and their pixels share
+      // one allocation at _mipmaps
+      image_t           *_mipmaps = nullptr;
+      int                _mipmap_count = 0;
+      size_t             _mipmap_alloc_size = 0;
+      uint32_t           _mipmap_generation = 0;
+
+      void free_mipmaps();
+      int mipmap_level(float texels_per_pixel);
+
+      void blit_compiled(image_t *target, int x, int y, bool flip_h, bool flip_v);
+      void blit_filtered(image_t *target, rect_t sr, rect_t tr, rect_t clip, bool flip_h, bool flip_v);
 
     public:
       blend_func_t       _blend_func = blend_func_over;
@@ -92,10 +177,32 @@ namespace picovector {
       // void delete_palette();
       void palette(uint8_t i, uint32_t c);
       uint32_t palette(uint8_t i);
+      const uint32_t *palette_lut();
 
       uint8_t alpha();
       void alpha(uint8_t alpha);
 
+      opacity_t opacity();
+      void mark_dirty() { _root->_generation++; }
+      uint32_t generation() { return _root->_generation; }
+      // hands the buffer out (e.g. as a bytearray), from then on nothing
+      // derived from the pixels is cached
+      void export_buffer() { _root->_exported = true; mark_dirty(); }
+      // true if every change to the pixels goes through the image, so
+      // results derived from them can be cached. false for images over
+      // external or exported buffers
+      bool tracked() { return _root->_managed_buffer && !_root->_exported; }
+      // true if both images are windows onto the same buffer
+      bool shares_buffer(const image_t *other) const { return _root == other->_root; }
+
+      bool compile();
+      bool compiled();
+
+      bool generate_mipmaps();
+      int mipmap_levels();
+      image_t *mipmap(int level);
+      image_t *mipmap_for_scale(float texels_per_pixel, int *level);
+
       antialias_t antialias();
       void antialias(antialias_t antialias);
 
@@ -151,12 +258,14 @@ namespace picovector {
 
       void draw(shape_t *shape);
       void blit(image_t *t, const vec2_t p);
-      void blit(image_t *t, rect_t tr);
-      void blit(image_t *t, rect_t sr, rect_t tr);
+      void blit(image_t *t, rect_t tr, filter_t filter=NEAREST);
+      void blit(image_t *t, rect_t sr, rect_t tr, filter_t filter=NEAREST);
+      void blit(image_t *t, const mat3_t &transform, filter_t filter=NEAREST);
 
 
 
       void vspan_tex(image_t *target, vec2_t p, uint c, vec2_t uvs, vec2_t uve);
+      void vspan_tex_batch(image_t *target, const vspan_t *spans, int count, const uint8_t *shade=nullptr, int shade_count=0);
   };
 
 }
@@ -8,13 +8,21 @@ list(APPEND SOURCES
   ${CMAKE_CURRENT_LIST_DIR}/picovector.cpp
   ${CMAKE_CURRENT_LIST_DIR}/shape.cpp
   ${CMAKE_CURRENT_LIST_DIR}/font.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/glyph_cache.cpp
   ${CMAKE_CURRENT_LIST_DIR}/pixel_font.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/text_layout.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/text_metrics.cpp
   ${CMAKE_CURRENT_LIST_DIR}/image.cpp
   ${CMAKE_CURRENT_LIST_DIR}/brush.cpp
   ${CMAKE_CURRENT_LIST_DIR}/color.cpp
   ${CMAKE_CURRENT_LIST_DIR}/primitive.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/tilemap.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/sprite_batch.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/particles.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/collision.cpp
   ${CMAKE_CURRENT_LIST_DIR}/algorithms/geometry.cpp
   ${CMAKE_CURRENT_LIST_DIR}/algorithms/dda.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/algorithms/raycast.cpp
   ${CMAKE_CURRENT_LIST_DIR}/brushes/pattern.cpp
   ${CMAKE_CURRENT_LIST_DIR}/brushes/color.cpp
   ${CMAKE_CURRENT_LIST_DIR}/brushes/image.cpp
@@ -34,6 +42,11 @@ list(APPEND SOURCES
   ${CMAKE_CURRENT_LIST_DIR}/micropython/rect.cpp
   ${CMAKE_CURRENT_LIST_DIR}/micropython/vec2.cpp
   ${CMAKE_CURRENT_LIST_DIR}/micropython/algorithm.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/micropython/tilemap.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/micropython/sprite_batch.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/micropython/particles.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/micropython/collision.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/micropython/text_layout.cpp
 )
 
 target_sources(usermod_picovector INTERFACE
@@ -15,7 +15,7 @@ extern "C" {
     return mp_obj_new_bool(result);
   })
 
-  MPY_BIND_STATICMETHOD_VAR(5, dda, {
+  MPY_BIND_STATICMETHOD_VAR(8, dda, {
     vec2_obj_t *p = (vec2_obj_t *)MP_OBJ_TO_PTR(args[0]);
     float angle = mp_obj_get_float(args[1]);
     float fov = mp_obj_get_float(args[2]);
@@ -23,13 +23,18 @@ extern "C" {
     int max = mp_obj_get_int(args[4]);
 
     mp_buffer_info_t map;
-    mp_get_buffer_raise(args[5], &map, MP_BUFFER_RW);
-    uint8_t *data = (uint8_t *)map.buf;
+    mp_get_buffer_raise(args[5], &map, MP_BUFFER_READ);
+    const uint8_t *data = (const uint8_t *)map.buf;
 
     int width = mp_obj_get_int(args[6]);
     int height = mp_obj_get_int(args[7]);
 
-    mp_obj_t *result = new mp_obj_t[rays];
+    if(width <= 0 || height <= 0 || size_t(width * height) > map.len) {
+      mp_raise_msg_varg(&mp_type_ValueError, MP_ERROR_TEXT("map buffer smaller than width * height"));
+    }
+
+    // filled in place rather than built from a temporary array
+    mp_obj_tuple_t *result = (mp_obj_tuple_t *)MP_OBJ_TO_PTR(mp_obj_new_tuple(rays, NULL));
 
     for(int i = 0; i < rays; i++) {
       float offset = float((i - (rays / 2.0f)) / (rays / 2.0f)) * fov / 2.0f;
@@ -40,20 +45,25 @@ extern "C" {
 
       mp_obj_t ray = mp_obj_new_list(0, NULL);
 
-      dda(p->v, v, [&step, &data, &width, &ray, &max](float hit_x, float hit_y, int gx, int gy, int edge, float offset, float distance) -> bool {
-        vec2_obj_t *cb_p = mp_obj_malloc(vec2_obj_t, &type_vec2);
-        vec2_obj_t *cb_g = mp_obj_malloc(vec2_obj_t, &type_vec2);
+      dda(p->v, v, [&step, &data, &width, &height, &ray, &max](float hit_x, float hit_y, int gx, int gy, int edge, float offset, float distance) -> bool {
+        if(gx < 0 || gy < 0 || gx >= width || gy >= height) {
+          return false;
+        }
 
-        cb_p->v.x = hit_x;
-        cb_p->v.y = hit_y;
+        uint8_t tile = data[(gy * width) + gx];
+        if(tile > 0) {
+          // only allocate for cells that are actually reported
+          vec2_obj_t *cb_p = mp_obj_malloc(vec2_obj_t, &type_vec2);
+          vec2_obj_t *cb_g = mp_obj_malloc(vec2_obj_t, &type_vec2);
 
-        cb_g->v.x = gx;
-        cb_g->v.y = gy;
+          cb_p->v.x = hit_x;
+          cb_p->v.y = hit_y;
 
-        if(data[(gy * width) + gx] > 0) {
+          cb_g->v.x = gx;
+          cb_g->v.y = gy;
 
           mp_obj_t items[6] = {
-            mp_obj_new_int(data[(gy * width) + gx]),
+            mp_obj_new_int(tile),
             MP_OBJ_FROM_PTR(cb_p),
             MP_OBJ_FROM_PTR(cb_g),
             mp_obj_new_int(edge),
@@ -63,7 +73,7 @@ extern "C" {
 
           mp_obj_list_append(ray, mp_obj_new_tuple(6, items));
 
-          if(data[(gy * width) + gx] >= 128) {
+          if(tile >= 128) {
             return false;
           }
         }
@@ -73,15 +83,123 @@ extern "C" {
         return step < max;
       });
 
-      result[i] = ray;
+      result->items[i] = ray;
+    }
+
+    return MP_OBJ_FROM_PTR(result);
+  })
+
+  // wall, floor or ceiling surface from an image (textured), a color (flat)
+  static raycast_surface_t mp_obj_get_raycast_surface(mp_obj_t surface_in) {
+    raycast_surface_t surface;
+    if(mp_obj_is_type(surface_in, &type_image)) {
+      surface.texture = ((image_obj_t *)MP_OBJ_TO_PTR(surface_in))->image;
+    } else if(mp_obj_is_type(surface_in, &type_color)) {
+      surface.color = ((color_obj_t *)MP_OBJ_TO_PTR(surface_in))->c->_p;
+    } else {
+      mp_raise_msg_varg(&mp_type_TypeError, MP_ERROR_TEXT("raycast surfaces must be an image or a color"));
+    }
+    return surface;
+  }
+
+  /*
+    raycast(target, map, width, height, position, angle, fov,
+            walls=None, floor=None, ceiling=None, max_steps=32,
+            hits=None, shade=None)
+
+    renders the view into the target's clip rect. walls is an image, a color
+    or a list of them indexed by map value - 1, floor and ceiling are an image
+    or a color (or None to leave them undrawn). hits is an optional array("f")
+    that receives distance, x, y, tile, edge and offset for each column.
+  */
+  enum { ARG_target, ARG_map, ARG_width, ARG_height, ARG_position, ARG_angle, ARG_fov,
+         ARG_walls, ARG_floor, ARG_ceiling, ARG_max_steps, ARG_hits, ARG_shade };
+  static const mp_arg_t raycast_allowed_args[] = {
+    { MP_QSTR_target,    MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+    { MP_QSTR_map,       MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+    { MP_QSTR_width,     MP_ARG_REQUIRED | MP_ARG_INT, {.u_int = 0} },
+    { MP_QSTR_height,    MP_ARG_REQUIRED | MP_ARG_INT, {.u_int = 0} },
+    { MP_QSTR_position,  MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+    { MP_QSTR_angle,     MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+    { MP_QSTR_fov,       MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+    { MP_QSTR_walls,     MP_ARG_OBJ, {.u_obj = mp_const_none} },
+    { MP_QSTR_floor,     MP_ARG_OBJ, {.u_obj = mp_const_none} },
+    { MP_QSTR_ceiling,   MP_ARG_OBJ, {.u_obj = mp_const_none} },
+    { MP_QSTR_max_steps, MP_ARG_INT, {.u_int = 32} },
+    { MP_QSTR_hits,      MP_ARG_OBJ, {.u_obj = mp_const_none} },
+    { MP_QSTR_shade,     MP_ARG_OBJ, {.u_obj = mp_const_none} },
+  };
+
+  MPY_BIND_STATICMETHOD_KW(7, raycast, {
+    mp_arg_val_t a[MP_ARRAY_SIZE(raycast_allowed_args)];
+    mp_arg_parse_all(n_args, args, kw_args, MP_ARRAY_SIZE(raycast_allowed_args), raycast_allowed_args, a);
+
+    if(!mp_obj_is_type(a[ARG_target].u_obj, &type_image)) {
+      mp_raise_msg_varg(&mp_type_TypeError, MP_ERROR_TEXT("invalid parameter, expected raycast(image, map, width, height, vec2, angle, fov, ...)"));
+    }
+    image_t *target = ((image_obj_t *)MP_OBJ_TO_PTR(a[ARG_target].u_obj))->image;
+
+    mp_buffer_info_t map;
+    mp_get_buffer_raise(a[ARG_map].u_obj, &map, MP_BUFFER_READ);
+    int width = a[ARG_width].u_int;
+    int height = a[ARG_height].u_int;
+    if(width <= 0 || height <= 0 || size_t(width * height) > map.len) {
+      mp_raise_msg_varg(&mp_type_ValueError, MP_ERROR_TEXT("map buffer smaller than width * height"));
+    }
+
+    raycast_camera_t camera;
+    camera.p = mp_obj_get_vec2(a[ARG_position].u_obj);
+    camera.angle = mp_obj_get_float(a[ARG_angle].u_obj);
+    camera.fov = mp_obj_get_float(a[ARG_fov].u_obj);
+    camera.max_steps = a[ARG_max_steps].u_int;
+
+    mp_obj_t walls_in = a[ARG_walls].u_obj;
+    size_t wall_count = 1;
+    mp_obj_t *wall_items = &walls_in;
+    if(walls_in != mp_const_none && !mp_obj_is_type(walls_in, &type_image) && !mp_obj_is_type(walls_in, &type_color)) {
+      mp_obj_get_array(walls_in, &wall_count, &wall_items);
+    }
+
+    raycast_surface_t *walls = m_new(raycast_surface_t, std::max(wall_count, size_t(1)));
+    for(size_t i = 0; i < wall_count; i++) {
+      walls[i] = wall_items[i] == mp_const_none ? raycast_surface_t() : mp_obj_get_raycast_surface(wall_items[i]);
     }
 
-    return mp_obj_new_tuple(rays, result);
+    raycast_surface_t floor;
+    raycast_surface_t ceiling;
+    bool has_floor = a[ARG_floor].u_obj != mp_const_none;
+    bool has_ceiling = a[ARG_ceiling].u_obj != mp_const_none;
+    if(has_floor) floor = mp_obj_get_raycast_surface(a[ARG_floor].u_obj);
+    if(has_ceiling) ceiling = mp_obj_get_raycast_surface(a[ARG_ceiling].u_obj);
+
+    raycast_hit_t *hits = nullptr;
+    if(a[ARG_hits].u_obj != mp_const_none) {
+      mp_buffer_info_t hits_buf;
+      mp_get_buffer_raise(a[ARG_hits].u_obj, &hits_buf, MP_BUFFER_WRITE);
+      size_t required = raycast_columns(target) * sizeof(raycast_hit_t);
+      if(hits_buf.typecode != 'f' || hits_buf.len < required) {
+        mp_raise_msg_varg(&mp_type_ValueError, MP_ERROR_TEXT("hits must be an array(\"f\") of at least %d values"), (int)(required / sizeof(float)));
+      }
+      hits = (raycast_hit_t *)hits_buf.buf;
+    }
+
+    mp_buffer_info_t shade = {0};
+    if(a[ARG_shade].u_obj != mp_const_none) {
+      mp_get_buffer_raise(a[ARG_shade].u_obj, &shade, MP_BUFFER_READ);
+    }
+
+    raycast(target, (const uint8_t *)map.buf, width, height, camera, walls, wall_count,
+            has_floor ? &floor : nullptr, has_ceiling ? &ceiling : nullptr,
+            (const uint8_t *)shade.buf, shade.len, hits);
+
+    m_del(raycast_surface_t, walls, std::max(wall_count, size_t(1)));
+    return mp_const_none;
   })
 
   MPY_BIND_LOCALS_DICT(algorithm,
     MPY_BIND_ROM_PTR_STATIC(clip_line),
     MPY_BIND_ROM_PTR_STATIC(dda),
+    MPY_BIND_ROM_PTR_STATIC(raycast),
   )
 
 
@@ -68,18 +68,19 @@ extern "C" {
 
   MPY_BIND_STATICMETHOD_VAR(1, image, {
     if(!mp_obj_is_type(args[0], &type_image) ||
-       (n_args >= 1 && !mp_obj_is_type(args[1], &type_mat3))) {
-      mp_raise_msg_varg(&mp_type_TypeError, MP_ERROR_TEXT("invalid parameter, expected brush.image(image, [mat3], [on=image])"));
+       (n_args >= 2 && !mp_obj_is_type(args[1], &type_mat3))) {
+      mp_raise_msg_varg(&mp_type_TypeError, MP_ERROR_TEXT("invalid parameter, expected brush.image(image, [mat3], [wrap])"));
     }
     brush_obj_t *brush = mp_obj_malloc(brush_obj_t, &type_brush);
     const image_obj_t *src = (image_obj_t *)MP_OBJ_TO_PTR(args[0]);
+    bool wrap = n_args >= 3 && mp_obj_is_true(args[2]);
 
     if(n_args == 1) {
-      brush->brush = m_new_class(image_brush_t, src->image);
+      brush->brush = m_new_class(image_brush_t, src->image, wrap);
     } else {
       mat3_obj_t *transform = (mat3_obj_t *)MP_OBJ_TO_PTR(args[1]);
       mat3_t *m = &transform->m;
-      brush->brush = m_new_class(image_brush_t, src->image, m);
+      brush->brush = m_new_class(image_brush_t, src->image, m, wrap);
     }
 
     return MP_OBJ_FROM_PTR(brush);
@@ -0,0 +1,261 @@
+#include "mp_helpers.hpp"
+#include "picovector.hpp"
+
+extern "C" {
+  #include "py/runtime.h"
+
+  // the buffer an id list is written into, array("H") only
+  static uint16_t *mp_obj_get_id_buffer(mp_obj_t buffer_in, int &len) {
+    mp_buffer_info_t buffer;
+    mp_get_buffer_raise(buffer_in, &buffer, MP_BUFFER_WRITE);
+    if(buffer.typecode != 'H') {
+      mp_raise_msg_varg(&mp_type_TypeError, MP_ERROR_TEXT("expected an array(\"H\")"));
+    }
+    len = buffer.len / sizeof(uint16_t);
+    return (uint16_t *)buffer.buf;
+  }
+
+  /*
+    collision_mask
+  */
+
+  MPY_BIND_DEL(collision_mask, {
+    self(self_in, collision_mask_obj_t);
+    if(self->mask) {
+      m_del_class(collision_mask_t, self->mask);
+      self->mask = nullptr;
+    }
+    return mp_const_none;
+  })
+
+  // collision_mask(image, [rect], [threshold])
+  MPY_BIND_NEW(collision_mask, {
+    if(n_args < 1 || n_args > 3 || !mp_obj_is_type(args[0], &type_image)) {
+      mp_raise_msg_varg(&mp_type_TypeError, MP_ERROR_TEXT("invalid parameter, expected collision_mask(image, [rect], [threshold])"));
+    }
+
+    image_obj_t *image = (image_obj_t *)MP_OBJ_TO_PTR(args[0]);
+    rect_t r = image->image->bounds();
+    if(n_args > 1 && args[1] != mp_const_none) {
+      r = mp_obj_get_rect(args[1]);
+    }
+    int threshold = n_args > 2 ? mp_obj_get_int(args[2]) : 1;
+
+    if(r.w < 1 || r.h < 1) {
+      mp_raise_msg_varg(&mp_type_ValueError, MP_ERROR_TEXT("mask must be at least one pixel"));
+    }
+
+    collision_mask_obj_t *self = mp_obj_malloc_with_finaliser(collision_mask_obj_t, type);
+    self->mask = m_new_class(collision_mask_t, image->image, int(r.x), int(r.y), int(r.w), int(r.h), threshold);
+    return MP_OBJ_FROM_PTR(self);
+  })
+
+  // overlaps(position, other, other_position)
+  MPY_BIND_VAR(4, overlaps, {
+    self(args[0], collision_mask_obj_t);
+    if(!mp_obj_is_type(args[2], &type_collision_mask)) {
+      mp_raise_msg_varg(&mp_type_TypeError, MP_ERROR_TEXT("invalid parameter, expected overlaps(vec2, collision_mask, vec2)"));
+    }
+    collision_mask_obj_t *other = (collision_mask_obj_t *)MP_OBJ_TO_PTR(args[2]);
+    vec2_t p = mp_obj_get_vec2(args[1]);
+    vec2_t o = mp_obj_get_vec2(args[3]);
+    int dx = int(floorf(o.x)) - int(floorf(p.x));
+    int dy = int(floorf(o.y)) - int(floorf(p.y));
+    return mp_obj_new_bool(self->mask->overlaps(other->mask, dx, dy));
+  })
+
+  // get(x, y)
+  MPY_BIND_VAR(3, get, {
+    self(args[0], collision_mask_obj_t);
+    return mp_obj_new_bool(self->mask->get(mp_obj_get_int(args[1]), mp_obj_get_int(args[2])));
+  })
+
+  MPY_BIND_ATTR(collision_mask, {
+    self(self_in, collision_mask_obj_t);
+
+    action_t action = m_attr_action(dest);
+
+    switch(attr) {
+      case MP_QSTR_width: {
+        if(action == GET) {
+          dest[0] = mp_obj_new_int(self->mask->w);
+          return;
+        }
+      };
+
+      case MP_QSTR_height: {
+        if(action == GET) {
+          dest[0] = mp_obj_new_int(self->mask->h);
+          return;
+        }
+      };
+    }
+
+    // we didn't handle this, fall back to alternative methods
+    dest[1] = MP_OBJ_SENTINEL;
+  })
+
+  static void collision_mask_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
+    self(self_in, collision_mask_obj_t);
+    mp_printf(print, "collision_mask(%d x %d)", self->mask->w, self->mask->h);
+  }
+
+  MPY_BIND_LOCALS_DICT(collision_mask,
+    MPY_BIND_ROM_PTR_DEL(collision_mask),
+    MPY_BIND_ROM_PTR(overlaps),
+    MPY_BIND_ROM_PTR(get),
+  )
+
+  MP_DEFINE_CONST_OBJ_TYPE(
+      type_collision_mask,
+      MP_QSTR_collision_mask,
+      MP_TYPE_FLAG_NONE,
+      make_new, (const void *)collision_mask_new,
+      print, (const void *)collision_mask_print,
+      attr, (const void *)collision_mask_attr,
+      locals_dict, &collision_mask_locals_dict
+  );
+
+  /*
+    collision_grid
+  */
+
+  MPY_BIND_DEL(collision_grid, {
+    self(self_in, collision_grid_obj_t);
+    if(self->grid) {
+      m_del(mp_obj_t, self->masks, self->grid->capacity());
+      m_del_class(collision_grid_t, self->grid);
+      self->grid = nullptr;
+      self->masks = nullptr;
+    }
+    return mp_const_none;
+  })
+
+  // collision_grid(cell_size, capacity)
+  MPY_BIND_NEW(collision_grid, {
+    if(n_args != 2) {
+      mp_raise_msg_varg(&mp_type_TypeError, MP_ERROR_TEXT("invalid parameter, expected collision_grid(cell_size, capacity)"));
+    }
+
+    int cell_size = mp_obj_get_int(args[0]);
+    if(cell_size <= 0) {
+      mp_raise_msg_varg(&mp_type_ValueError, MP_ERROR_TEXT("cell size must be greater than zero"));
+    }
+
+    int capacity = mp_obj_get_int(args[1]);
+    if(capacity <= 0 || capacity > 0xffff) {
+      mp_raise_msg_varg(&mp_type_ValueError, MP_ERROR_TEXT("capacity must be between 1 and 65535"));
+    }
+
+    collision_grid_obj_t *self = mp_obj_malloc_with_finaliser(collision_grid_obj_t, type);
+    self->grid = m_new_class(collision_grid_t, cell_size, capacity);
+    self->masks = m_new0(mp_obj_t, capacity);
+    return MP_OBJ_FROM_PTR(self);
+  })
+
+  // add(id, rect, [mask])
+  MPY_BIND_VAR(3, add, {
+    self(args[0], collision_grid_obj_t);
+    int id = mp_obj_get_int(args[1]);
+    rect_t r = mp_obj_get_rect(args[2]);
+
+    const collision_mask_t *mask = nullptr;
+    mp_obj_t mask_in = n_args > 3 ? args[3] : mp_const_none;
+    if(mask_in != mp_const_none) {
+      if(!mp_obj_is_type(mask_in, &type_collision_mask)) {
+        mp_raise_msg_varg(&mp_type_TypeError, MP_ERROR_TEXT("invalid parameter, expected add(id, rect, [collision_mask])"));
+      }
+      mask = ((collision_mask_obj_t *)MP_OBJ_TO_PTR(mask_in))->mask;
+    }
+
+    int slot = self->grid->count;
+    if(!self->grid->add(id, floorf(r.x), floorf(r.y), r.w, r.h, mask)) {
+      mp_raise_msg_varg(&mp_type_IndexError, MP_ERROR_TEXT("collision grid is full"));
+    }
+    // keep the mask alive while the grid points at it
+    self->masks[slot] = mask_in;
+    return mp_const_none;
+  })
+
+  MPY_BIND_VAR(1, clear, {
+    self(args[0], collision_grid_obj_t);
+    self->grid->clear();
+    memset(self->masks, 0, self->grid->capacity() * sizeof(mp_obj_t));
+    return mp_const_none;
+  })
+
+  // pairs(buffer), fills an array("H") with pairs of ids and returns the
+  // number of pairs
+  MPY_BIND_VAR(2, pairs, {
+    self(args[0], collision_grid_obj_t);
+    int len;
+    uint16_t *out = mp_obj_get_id_buffer(args[1], len);
+    return mp_obj_new_int(self->grid->pairs(out, len / 2));
+  })
+
+  // query(rect, buffer), fills an array("H") with the ids of objects
+  // overlapping rect and returns how many there were
+  MPY_BIND_VAR(3, query, {
+    self(args[0], collision_grid_obj_t);
+    rect_t r = mp_obj_get_rect(args[1]);
+    int len;
+    uint16_t *out = mp_obj_get_id_buffer(args[2], len);
+    return mp_obj_new_int(self->grid->query(floorf(r.x), floorf(r.y), r.w, r.h, out, len));
+  })
+
+  MPY_BIND_ATTR(collision_grid, {
+    self(self_in, collision_grid_obj_t);
+
+    action_t action = m_attr_action(dest);
+
+    switch(attr) {
+      case MP_QSTR_count: {
+        if(action == GET) {
+          dest[0] = mp_obj_new_int(self->grid->count);
+          return;
+        }
+      };
+
+      case MP_QSTR_capacity: {
+        if(action == GET) {
+          dest[0] = mp_obj_new_int(self->grid->capacity());
+          return;
+        }
+      };
+
+      case MP_QSTR_cell_size: {
+        if(action == GET) {
+          dest[0] = mp_obj_new_int(self->grid->cell_size);
+          return;
+        }
+      };
+    }
+
+    // we didn't handle this, fall back to alternative methods
+    dest[1] = MP_OBJ_SENTINEL;
+  })
+
+  static void collision_grid_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
+    self(self_in, collision_grid_obj_t);
+    mp_printf(print, "collision_grid(%d / %d)", self->grid->count, self->grid->capacity());
+  }
+
+  MPY_BIND_LOCALS_DICT(collision_grid,
+    MPY_BIND_ROM_PTR_DEL(collision_grid),
+    MPY_BIND_ROM_PTR(add),
+    MPY_BIND_ROM_PTR(clear),
+    MPY_BIND_ROM_PTR(pairs),
+    MPY_BIND_ROM_PTR(query),
+  )
+
+  MP_DEFINE_CONST_OBJ_TYPE(
+      type_collision_grid,
+      MP_QSTR_collision_grid,
+      MP_TYPE_FLAG_NONE,
+      make_new, (const void *)collision_grid_new,
+      print, (const void *)collision_grid_print,
+      attr, (const void *)collision_grid_attr,
+      locals_dict, &collision_grid_locals_dict
+  );
+
+}
@@ -1,6 +1,43 @@
 #include "mp_helpers.hpp"
 #include "picovector.hpp"
 
+mp_obj_t mp_obj_new_text_metrics(const text_metrics_t &m) {
+  mp_obj_t result[2];
+  result[0] = mp_obj_new_rect(m.advance);
+  result[1] = mp_obj_new_rect(m.ink);
+  return mp_obj_new_tuple(2, result);
+}
+
+mp_obj_t mp_obj_measure_texts(mp_obj_t text, const std::function<text_metrics_t(const char *)> &measure) {
+  if(mp_obj_is_str(text)) {
+    return mp_obj_new_text_metrics(measure(mp_obj_str_get_str(text)));
+  }
+
+  // a batch of strings measures into a list in one call
+  size_t count;
+  mp_obj_t *items;
+  mp_obj_get_array(text, &count, &items);
+  mp_obj_t result = mp_obj_new_list(0, NULL);
+  for(size_t i = 0; i < count; i++) {
+    mp_obj_list_append(result, mp_obj_new_text_metrics(measure(mp_obj_str_get_str(items[i]))));
+  }
+  return result;
+}
+
+mp_obj_t mp_obj_new_text_render(const rect_t &bounds, const std::function<void(image_t *)> &render) {
+  image_obj_t *mask = mp_obj_malloc_with_finaliser(image_obj_t, &type_image);
+  mask->image = new(m_malloc(sizeof(image_t))) image_t(std::max(int(bounds.w), 1), std::max(int(bounds.h), 1), A8);
+  render(mask->image);
+
+  vec2_obj_t *offset = mp_obj_malloc(vec2_obj_t, &type_vec2);
+  offset->v = vec2_t(bounds.x, bounds.y);
+
+  mp_obj_t result[2];
+  result[0] = MP_OBJ_FROM_PTR(mask);
+  result[1] = MP_OBJ_FROM_PTR(offset);
+  return mp_obj_new_tuple(2, result);
+}
+
 extern "C" {
 
   #include "py/stream.h"
@@ -10,112 +47,192 @@ extern "C" {
 
   MPY_BIND_DEL(font, {
     self(self_in, font_obj_t);
+    glyph_cache_forget(&self->font);
+    text_metrics_forget(&self->font);
+    if(self->buffer) {
 #if MICROPY_MALLOC_USES_ALLOCATED_SIZE
-    m_free(self->buffer, self->buffer_size);
+      m_free(self->buffer, self->buffer_size);
 #else
-    m_free(self->buffer);
+      m_free(self->buffer);
 #endif
+      self->buffer = nullptr;
+    }
     return mp_const_none;
   })
 
-  MPY_BIND_STATICMETHOD_ARGS1(load, path, {
-    //const char *s = mp_obj_str_get_str(path);
-    font_obj_t *result = mp_obj_malloc_with_finaliser(font_obj_t, &type_font);
-
-    // PNG *png = new(m_malloc(sizeof(PNG))) PNG();
-    // int status = png->open(mp_obj_str_get_str(path), pngdec_open_callback, pngdec_close_callback, pngdec_read_callback, pngdec_seek_callback, pngdec_decode_callback);
-    // result->image = new(m_malloc(sizeof(image))) image(png->getWidth(), png->getHeight());
-    // png->decode((void *)result->image, 0);
-    // m_free(png, sizeof(png));
-    //mp_obj_t fn = mp_obj_new_str(s, (mp_uint_t)strlen(s));
-
-    // get file size (maybe not needed?)
-    // mp_obj_t stat = mp_vfs_stat(path);
-    // mp_obj_tuple_t *tuple = (mp_obj_tuple_t*)MP_OBJ_TO_PTR(stat);
-    // mp_int_t size = mp_obj_get_int(tuple->items[6]);
-
-    // open the file for binary reading
-    //mp_obj_t args[2] = {path, MP_ROM_QSTR(MP_QSTR_r)} // Brace enclosed initialiser lists don't work in the binding macros :(
-    mp_obj_t args[2];
-    args[0] = path;
-    args[1] = MP_ROM_QSTR(MP_QSTR_r);;
-    mp_obj_t file = mp_vfs_open(MP_ARRAY_SIZE(args), args, (mp_map_t *)&mp_const_empty_map);
+  static uint8_t *font_alloc(font_obj_t *self, size_t size) {
+    self->buffer_size = size;
+    self->buffer = (uint8_t *)m_malloc(size);
+    if(!self->buffer) {
+      mp_raise_msg_varg(&mp_type_OSError, MP_ERROR_TEXT("couldn't allocate buffer for font data"));
+    }
+    return self->buffer;
+  }
 
+  // reads a version 1 ("af!?") font into the version 2 layout, the marker
+  // has already been read. returns the size of the font data, which is
+  // followed by room for the lookup index
+  static size_t font_load_v1(font_obj_t *self, mp_obj_t file) {
     int error;
 
-    char marker[4];
-    mp_stream_read_exactly(file, &marker, sizeof(marker), &error);
+    af2_header_t header;
+    memcpy(header.marker, "af!2", 4);
+    header.flags       = ru16(file);
+    header.glyph_count = ru16(file);
+    header.path_count  = ru16(file);
+    header.reserved    = 0;
+    header.point_count = ru16(file);
 
-    if(memcmp(marker, "af!?", 4) != 0) {
-      mp_raise_msg_varg(&mp_type_OSError, MP_ERROR_TEXT("failed to load font, missing AF header"));
-    }
+    uint32_t glyph_count = header.glyph_count;
+    uint32_t path_count = header.path_count;
+    size_t size = font_t::mapped_size(glyph_count, path_count, header.point_count);
+    uint8_t *buffer = font_alloc(self, size + sizeof(uint16_t) * glyph_count);
+    memcpy(buffer, &header, sizeof(header));
 
-    uint16_t flags       = ru16(file);
-    uint16_t glyph_count = ru16(file);
-    uint16_t path_count  = ru16(file);
-    uint16_t point_count = ru16(file);
+    glyph_t *glyphs = (glyph_t *)(buffer + sizeof(header));
+    glyph_path_t *paths = (glyph_path_t *)(glyphs + glyph_count);
+    glyph_path_point_t *points = (glyph_path_point_t *)(paths + path_count);
 
-    size_t glyph_buffer_size = sizeof(glyph_t) * glyph_count;
-    size_t path_buffer_size = sizeof(glyph_path_t) * path_count;
-    size_t point_buffer_size = sizeof(glyph_path_point_t) * point_count;
+    // the packed 8 byte glyph entries are read into the end of the glyph
+    // table and widened front to back, each entry is read before it's
+    // overwritten
+    uint8_t *packed = (uint8_t *)glyphs + glyph_count * 4;
+    mp_stream_read_exactly(file, packed, glyph_count * 8, &error);
+    for(uint32_t i = 0; i < glyph_count; i++) {
+      const uint8_t *p = packed + i * 8;
+      glyph_t glyph;
+      glyph.codepoint  = (p[0] << 8) | p[1];
+      glyph.x          = int8_t(p[2]);
+      glyph.y          = int8_t(p[3]);
+      glyph.w          = p[4];
+      glyph.h          = p[5];
+      glyph.advance    = p[6];
+      glyph.path_count = p[7];
+      glyphs[i] = glyph;
+    }
 
-    // allocate buffer to store font glyph, path, and point data
-    result->buffer_size = glyph_buffer_size + path_buffer_size + point_buffer_size;
-    result->buffer = (uint8_t*)m_malloc(result->buffer_size);
+    // likewise the path point counts, one or two bytes each
+    uint32_t count_size = header.flags & 0b1 ? 2 : 1;
+    packed = (uint8_t *)paths + path_count * (sizeof(glyph_path_t) - count_size);
+    mp_stream_read_exactly(file, packed, path_count * count_size, &error);
+    for(uint32_t i = 0; i < path_count; i++) {
+      const uint8_t *p = packed + i * count_size;
+      glyph_path_t path;
+      path.point_count = count_size == 2 ? (p[0] << 8) | p[1] : p[0];
+      path.reserved    = 0;
+      paths[i] = path;
+    }
 
-    if(!result->buffer) {
-      mp_raise_msg_varg(&mp_type_OSError, MP_ERROR_TEXT("couldn't allocate buffer for font data"));
+    // points are two signed bytes in both versions
+    mp_stream_read_exactly(file, points, sizeof(glyph_path_point_t) * header.point_count, &error);
+
+    // link the tables, paths and points are stored in glyph order
+    glyph_path_t *path = paths;
+    glyph_path_point_t *point = points;
+    for(uint32_t i = 0; i < glyph_count; i++) {
+      glyphs[i].paths_offset = (uint8_t *)path - (uint8_t *)&glyphs[i];
+      for(int j = 0; j < glyphs[i].path_count; j++, path++) {
+        path->points_offset = (uint8_t *)point - (uint8_t *)path;
+        point += path->point_count;
+      }
     }
 
-    glyph_t *glyphs = (glyph_t*)result->buffer;
-    glyph_path_t *paths = (glyph_path_t*)(result->buffer + glyph_buffer_size);
-    glyph_path_point_t *points = (glyph_path_point_t*)(result->buffer + glyph_buffer_size + path_buffer_size);
-
-    // load glyph dictionary
-    result->font.glyph_count = glyph_count;
-    result->font.glyphs      = glyphs;
-    for(int i = 0; i < glyph_count; i++) {
-      glyph_t *glyph = &result->font.glyphs[i];
-      glyph->codepoint  = ru16(file);
-      glyph->x          =  rs8(file);
-      glyph->y          =  rs8(file);
-      glyph->w          =  ru8(file);
-      glyph->h          =  ru8(file);
-      glyph->advance    =  ru8(file);
-      glyph->path_count =  ru8(file);
-      glyph->paths      =      paths;
-      paths += glyph->path_count;
+    return size;
+  }
+
+  // font.load(path or buffer)
+  //
+  // version 2 fonts are used in place wherever the data can be mapped, from
+  // romfs files or any object with the buffer protocol, only the lookup
+  // index is allocated. anything else is read into a single buffer
+  MPY_BIND_STATICMETHOD_ARGS1(load, path, {
+    font_obj_t *result = mp_obj_malloc_with_finaliser(font_obj_t, &type_font);
+    result->buffer = nullptr;
+    result->source = mp_const_none;
+
+    mp_obj_t source = path;
+    if(mp_obj_is_str(path)) {
+      mp_obj_t args[2];
+      args[0] = path;
+      args[1] = MP_ROM_QSTR(MP_QSTR_rb);
+      source = mp_vfs_open(MP_ARRAY_SIZE(args), args, (mp_map_t *)&mp_const_empty_map);
     }
 
-    // load the glyph paths
-    for(int i = 0; i < glyph_count; i++) {
-      glyph_t *glyph = &result->font.glyphs[i];
-      for(int j = 0; j < glyph->path_count; j++) {
-        glyph_path_t *path = &glyph->paths[j];
-        path->point_count = flags & 0b1 ? ru16(file) : ru8(file);
-        path->points = points;
-        points += path->point_count;
+    mp_buffer_info_t mapped;
+    if(mp_get_buffer(source, &mapped, MP_BUFFER_READ)) {
+      if(result->font.map((const uint8_t *)mapped.buf, mapped.len)) {
+        // keep the mapping alive for as long as the font
+        result->source = source;
+        uint8_t *index = font_alloc(result, sizeof(uint16_t) * result->font.glyph_count);
+        result->font.build_index((uint16_t *)index);
+        return MP_OBJ_FROM_PTR(result);
+      }
+      if(!mp_obj_is_str(path)) {
+        mp_raise_msg_varg(&mp_type_ValueError, MP_ERROR_TEXT("failed to load font, buffer isn't a version 2 AF"));
       }
     }
 
-    // load the glyph points
-    for(int i = 0; i < glyph_count; i++) {
-      glyph_t *glyph = &result->font.glyphs[i];
-      for(int j = 0; j < glyph->path_count; j++) {
-        glyph_path_t *path = &glyph->paths[j];
-        for(int k = 0; k < path->point_count; k++) {
-          glyph_path_point_t *point = &path->points[k];
-          point->x = ru8(file);
-          point->y = ru8(file);
-        }
-      }
+    mp_obj_t file = source;
+    int error;
+
+    char marker[4];
+    mp_stream_read_exactly(file, &marker, sizeof(marker), &error);
+
+    size_t size;
+    if(memcmp(marker, "af!2", 4) == 0) {
+      // already in memory layout, read the rest of the header to size it
+      af2_header_t header;
+      memcpy(header.marker, marker, sizeof(marker));
+      mp_stream_read_exactly(file, (uint8_t *)&header + sizeof(marker), sizeof(header) - sizeof(marker), &error);
+
+      size = font_t::mapped_size(header.glyph_count, header.path_count, header.point_count);
+      uint8_t *buffer = font_alloc(result, size + sizeof(uint16_t) * header.glyph_count);
+      memcpy(buffer, &header, sizeof(header));
+      mp_stream_read_exactly(file, buffer + sizeof(header), size - sizeof(header), &error);
+    } else if(memcmp(marker, "af!?", 4) == 0) {
+      size = font_load_v1(result, file);
+    } else {
+      mp_raise_msg_varg(&mp_type_OSError, MP_ERROR_TEXT("failed to load font, missing AF header"));
     }
 
     mp_stream_close(file);
 
+    if(!result->font.map(result->buffer, size)) {
+      mp_raise_msg_varg(&mp_type_OSError, MP_ERROR_TEXT("failed to load font, invalid AF data"));
+    }
+
+    // the lookup index follows the font data
+    result->font.build_index((uint16_t *)(result->buffer + size));
+
     return MP_OBJ_FROM_PTR(result);
   })
 
+  // render(text, size), the text drawn once into an A8 image that can be
+  // blitted with any pen, cheaper than drawing it again every frame. returns
+  // (image, offset), blit the image at the pen position plus the offset as
+  // glyphs can reach above or left of the pen
+  MPY_BIND_VAR(3, render, {
+    self(args[0], font_obj_t);
+    const char *text = mp_obj_str_get_str(args[1]);
+    float size = mp_obj_get_float(args[2]);
+
+    rect_t bounds = self->font.render_bounds(text, size);
+    return mp_obj_new_text_render(bounds, [&](image_t *mask) {
+      self->font.render(mask, text, size, bounds);
+    });
+  })
+
+  // measure(text, size), the advance and ink rects of the text with the pen
+  // at the top left of the line. `text` can be a list of strings to measure
+  // them all at once, giving a list of results
+  MPY_BIND_VAR(3, measure, {
+    self(args[0], font_obj_t);
+    float size = mp_obj_get_float(args[2]);
+    return mp_obj_measure_texts(args[1], [self, size](const char *text) {
+      return self->font.measure(text, size);
+    });
+  })
+
   static void font_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
     self(self_in, font_obj_t);
 
@@ -127,6 +244,8 @@ extern "C" {
   MPY_BIND_LOCALS_DICT(font,
     MPY_BIND_ROM_PTR_DEL(font),
     MPY_BIND_ROM_PTR_STATIC(load),
+    MPY_BIND_ROM_PTR(render),
+    MPY_BIND_ROM_PTR(measure),
   )
 
   MP_DEFINE_CONST_OBJ_TYPE(
@@ -17,33 +17,79 @@ extern "C" {
   }
   static MP_DEFINE_CONST_FUN_OBJ_1(image__del___obj, image__del__);
 
+  static pixel_format_t mp_obj_get_pixel_format(mp_obj_t pixel_format_in) {
+    int pixel_format = mp_obj_get_int(pixel_format_in);
+    switch(pixel_format) {
+      case RGBA8888:
+      case RGBA4444:
+      case RGB565:
+      case A8:
+        return (pixel_format_t)pixel_format;
+    }
+    mp_raise_msg_varg(&mp_type_ValueError, MP_ERROR_TEXT("unsupported pixel format"));
+  }
+
+  static filter_t mp_obj_get_filter(mp_obj_t filter_in) {
+    int filter = mp_obj_get_int(filter_in);
+    switch(filter) {
+      case NEAREST:
+      case BILINEAR:
+        return (filter_t)filter;
+    }
+    mp_raise_msg_varg(&mp_type_ValueError, MP_ERROR_TEXT("unsupported filter"));
+  }
+
 MPY_BIND_NEW(image, {
     image_obj_t *self = mp_obj_malloc_with_finaliser(image_obj_t, type);
 
     int w = mp_obj_get_int(args[0]);
     int h = mp_obj_get_int(args[1]);
 
+    // image(w, h), image(w, h, format), image(w, h, buffer) or
+    // image(w, h, buffer, format)
+    mp_obj_t buffer = mp_const_none;
+    pixel_format_t pixel_format = RGBA8888;
     if (n_args > 2) {
+      if (mp_obj_is_int(args[2])) {
+        pixel_format = mp_obj_get_pixel_format(args[2]);
+      } else {
+        buffer = args[2];
+        if (n_args > 3) {
+          pixel_format = mp_obj_get_pixel_format(args[3]);
+        }
+      }
+    }
+
+    if (buffer != mp_const_none) {
       mp_buffer_info_t bufinfo;
-      mp_get_buffer_raise(args[2], &bufinfo, MP_BUFFER_WRITE);
-      self->image = new(m_malloc(sizeof(image_t))) image_t(bufinfo.buf, w, h);
+      mp_get_buffer_raise(buffer, &bufinfo, MP_BUFFER_WRITE);
+      size_t required = size_t(w) * size_t(h) * pixel_format_size(pixel_format);
+      if (bufinfo.len < required) {
+        mp_raise_msg_varg(&mp_type_ValueError, MP_ERROR_TEXT("buffer too small, expected %d bytes"), (int)required);
+      }
+      self->image = new(m_malloc(sizeof(image_t))) image_t(bufinfo.buf, w, h, pixel_format);
     } else {
-      self->image = new(m_malloc(sizeof(image_t))) image_t(w, h);
+      self->image = new(m_malloc(sizeof(image_t))) image_t(w, h, pixel_format);
     }
 
     return MP_OBJ_FROM_PTR(self);
 })
 
-MPY_BIND_STATICMETHOD_ARGS1(load, path, {
-    const char *s = mp_obj_str_get_str(path);
+// image.load(path) or image.load(path, format), paletted PNGs keep their
+// palette unless another pixel format is asked for
+MPY_BIND_STATICMETHOD_VAR(1, load, {
+    mp_obj_t path = args[0];
+    pixel_format_t pixel_format = n_args > 1 ? mp_obj_get_pixel_format(args[1]) : RGBA8888;
     image_obj_t *result = mp_obj_malloc_with_finaliser(image_obj_t, &type_image);
 
     PNG *png = new(PicoVector_working_buffer) PNG();
     int status = png->open(mp_obj_str_get_str(path), pngdec_open_callback, pngdec_close_callback, pngdec_read_callback, pngdec_seek_callback, pngdec_decode_callback);
-    bool has_palette = png->getPixelType() == PNG_PIXEL_INDEXED;
-    result->image = new(m_malloc(sizeof(image_t))) image_t(png->getWidth(), png->getHeight(), RGBA8888, has_palette);
+    bool has_palette = png->getPixelType() == PNG_PIXEL_INDEXED && pixel_format == RGBA8888;
+    result->image = new(m_malloc(sizeof(image_t))) image_t(png->getWidth(), png->getHeight(), pixel_format, has_palette);
     png->decode((void *)result->image, 0);
     png->close();
+    // classify the alpha channel up front so the first blit doesn't have to
+    result->image->opacity();
     return MP_OBJ_FROM_PTR(result);
   })
 
@@ -55,6 +101,7 @@ MPY_BIND_CLASSMETHOD_ARGS1(load_into, path, {
     bool has_palette = png->getPixelType() == PNG_PIXEL_INDEXED;
     png->decode((void *)self->image, 0);
     png->close();
+    self->image->mark_dirty();
     return mp_const_none;
   })
 
@@ -311,18 +358,27 @@ MPY_BIND_VAR(2, measure_text, {
 
     mp_obj_t result[2];
 
+    // the advance box, how far the text moves the pen by the line height
+    rect_t r;
     if(self->font) {
       float size = mp_obj_get_float(args[2]);
-      rect_t r = self->image->font()->measure(self->image, text, size);
-      result[0] = mp_obj_new_float(r.w);
-      result[1] = mp_obj_new_float(r.h);
-    }
-
-    if(self->pixel_font) {
-      rect_t r = self->image->pixel_font()->measure(self->image, text);
-      result[0] = mp_obj_new_float(r.w);
-      result[1] = mp_obj_new_float(r.h);
+      r = self->image->font()->measure(text, size).advance;
+    } else {
+      // pixel fonts have always measured to the end of the last glyph, so
+      // trailing spaces are left out as apps centring text rely on that
+      pixel_font_t *font = self->image->pixel_font();
+      r = font->measure(text).advance;
+      for(const char *end = text + strlen(text); end > text; end--) {
+        int codepoint = end[-1];
+        if(codepoint == ' ') {
+          r.w -= font->width / 3;
+        } else if(font->glyph_index(codepoint) != -1) {
+          break;
+        }
+      }
     }
+    result[0] = mp_obj_new_float(r.w);
+    result[1] = mp_obj_new_float(r.h);
 
     return mp_obj_new_tuple(2, result);
   })
@@ -338,6 +394,32 @@ MPY_BIND_VAR(9, vspan_tex, {
     return mp_const_none;
   })
 
+// vspan_tex_batch(texture, columns, [shade])
+//
+// columns is an array("h") of x, y, height, u for each span and shade an
+// optional bytes-like brightness lookup table indexed by span height
+MPY_BIND_VAR(3, vspan_tex_batch, {
+    const image_obj_t *self = (image_obj_t *)MP_OBJ_TO_PTR(args[0]);
+    if(!mp_obj_is_type(args[1], &type_image)) {
+      mp_raise_msg_varg(&mp_type_TypeError, MP_ERROR_TEXT("invalid parameter, expected vspan_tex_batch(image, columns, [shade])"));
+    }
+    const image_obj_t *src = (image_obj_t *)MP_OBJ_TO_PTR(args[1]);
+
+    mp_buffer_info_t columns;
+    mp_get_buffer_raise(args[2], &columns, MP_BUFFER_READ);
+    if(columns.typecode != 'h' || columns.len % sizeof(vspan_t) != 0) {
+      mp_raise_msg_varg(&mp_type_ValueError, MP_ERROR_TEXT("columns must be an array(\"h\") of x, y, height, u values"));
+    }
+
+    mp_buffer_info_t shade = {0};
+    if(n_args >= 4 && args[3] != mp_const_none) {
+      mp_get_buffer_raise(args[3], &shade, MP_BUFFER_READ);
+    }
+
+    src->image->vspan_tex_batch(self->image, (const vspan_t *)columns.buf, columns.len / sizeof(vspan_t), (const uint8_t *)shade.buf, shade.len);
+    return mp_const_none;
+  })
+
 MPY_BIND_VAR(3, blit, {
     const image_obj_t *self = (image_obj_t *)MP_OBJ_TO_PTR(args[0]);
 
@@ -350,19 +432,44 @@ MPY_BIND_VAR(3, blit, {
         return mp_const_none;
       }
 
-      if(n_args == 3 && mp_obj_is_rect(args[2])) {
-        src->image->blit(self->image, mp_obj_get_rect(args[2]));
+      if((n_args == 3 || n_args == 4) && mp_obj_is_rect(args[2]) && !(n_args == 4 && mp_obj_is_rect(args[3]))) {
+        filter_t filter = n_args == 4 ? mp_obj_get_filter(args[3]) : NEAREST;
+        src->image->blit(self->image, mp_obj_get_rect(args[2]), filter);
         return mp_const_none;
       }
 
-      if(n_args == 4 && mp_obj_is_rect(args[2]) && mp_obj_is_rect(args[3])) {
-        src->image->blit(self->image, mp_obj_get_rect(args[2]), mp_obj_get_rect(args[3]));
+      if((n_args == 4 || n_args == 5) && mp_obj_is_rect(args[2]) && mp_obj_is_rect(args[3])) {
+        filter_t filter = n_args == 5 ? mp_obj_get_filter(args[4]) : NEAREST;
+        src->image->blit(self->image, mp_obj_get_rect(args[2]), mp_obj_get_rect(args[3]), filter);
+        return mp_const_none;
+      }
+
+      if((n_args == 3 || n_args == 4) && mp_obj_is_type(args[2], &type_mat3)) {
+        const mat3_obj_t *transform = (mat3_obj_t *)MP_OBJ_TO_PTR(args[2]);
+        filter_t filter = n_args == 4 ? mp_obj_get_filter(args[3]) : NEAREST;
+        src->image->blit(self->image, transform->m, filter);
         return mp_const_none;
       }
 
     }
 
-    mp_raise_msg_varg(&mp_type_TypeError, MP_ERROR_TEXT("invalid parameter, expected blit(image, point), blit(image, rect) or blit(image, source_rect, dest_rect)"));
+    mp_raise_msg_varg(&mp_type_TypeError, MP_ERROR_TEXT("invalid parameter, expected blit(image, point), blit(image, rect, [filter]), blit(image, source_rect, dest_rect, [filter]) or blit(image, mat3, [filter])"));
+  })
+
+MPY_BIND_VAR(1, compile, {
+    const image_obj_t *self = (image_obj_t *)MP_OBJ_TO_PTR(args[0]);
+    if(!self->image->compile()) {
+      mp_raise_msg_varg(&mp_type_ValueError, MP_ERROR_TEXT("A8 images and images over external or exported buffers cannot be compiled"));
+    }
+    return mp_const_none;
+  })
+
+MPY_BIND_VAR(1, generate_mipmaps, {
+    const image_obj_t *self = (image_obj_t *)MP_OBJ_TO_PTR(args[0]);
+    if(!self->image->generate_mipmaps()) {
+      mp_raise_msg_varg(&mp_type_ValueError, MP_ERROR_TEXT("A8, 1x1 and images over external or exported buffers cannot have mipmaps"));
+    }
+    return mp_const_none;
   })
 
 MPY_BIND_VAR(1, clear, {
@@ -386,6 +493,8 @@ MPY_BIND_ATTR(image, {
     switch(attr) {
       case MP_QSTR_raw: {
         if(action == GET) {
+          // the buffer can be written through the bytearray from here on
+          self->image->export_buffer();
           mp_obj_t raw = mp_obj_new_bytearray_by_ref(self->image->buffer_size(), self->image->ptr(0, 0));
           dest[0] = raw;
           return;
@@ -426,6 +535,13 @@ MPY_BIND_ATTR(image, {
         }
       };
 
+      case MP_QSTR_pixel_format: {
+        if(action == GET) {
+          dest[0] = mp_obj_new_int(self->image->pixel_format());
+          return;
+        }
+      };
+
       case MP_QSTR_has_palette: {
         if(action == GET) {
           dest[0] = mp_obj_new_bool(self->image->has_palette());
@@ -433,6 +549,20 @@ MPY_BIND_ATTR(image, {
         }
       };
 
+      case MP_QSTR_compiled: {
+        if(action == GET) {
+          dest[0] = mp_obj_new_bool(self->image->compiled());
+          return;
+        }
+      };
+
+      case MP_QSTR_mipmap_levels: {
+        if(action == GET) {
+          dest[0] = mp_obj_new_int(self->image->mipmap_levels());
+          return;
+        }
+      };
+
       case MP_QSTR_antialias: {
         if(action == GET) {
           dest[0] = mp_obj_new_int(self->image->antialias());
@@ -527,6 +657,8 @@ MPY_BIND_ATTR(image, {
 
   static mp_int_t image_get_framebuffer(mp_obj_t self_in, mp_buffer_info_t *bufinfo, mp_uint_t flags) {
     self(self_in, image_obj_t);
+    // the buffer can be written through the view from here on
+    self->image->export_buffer();
     bufinfo->buf = self->image->ptr(0, 0);
     bufinfo->len = self->image->buffer_size();
     bufinfo->typecode = 'B';
@@ -564,12 +696,23 @@ MPY_BIND_LOCALS_DICT(image,
 
       // blitting
       MPY_BIND_ROM_PTR(vspan_tex),
+      MPY_BIND_ROM_PTR(vspan_tex_batch),
       MPY_BIND_ROM_PTR(blit),
+      MPY_BIND_ROM_PTR(compile),
+      MPY_BIND_ROM_PTR(generate_mipmaps),
 
       // TODO: Just define these in MicroPython?
       { MP_ROM_QSTR(MP_QSTR_X4), MP_ROM_INT(antialias_t::X4)},
       { MP_ROM_QSTR(MP_QSTR_X2), MP_ROM_INT(antialias_t::X2)},
       { MP_ROM_QSTR(MP_QSTR_OFF), MP_ROM_INT(antialias_t::OFF)},
+
+      { MP_ROM_QSTR(MP_QSTR_NEAREST), MP_ROM_INT(filter_t::NEAREST)},
+      { MP_ROM_QSTR(MP_QSTR_BILINEAR), MP_ROM_INT(filter_t::BILINEAR)},
+
+      { MP_ROM_QSTR(MP_QSTR_RGBA8888), MP_ROM_INT(pixel_format_t::RGBA8888)},
+      { MP_ROM_QSTR(MP_QSTR_RGBA4444), MP_ROM_INT(pixel_format_t::RGBA4444)},
+      { MP_ROM_QSTR(MP_QSTR_RGB565), MP_ROM_INT(pixel_format_t::RGB565)},
+      { MP_ROM_QSTR(MP_QSTR_A8), MP_ROM_INT(pixel_format_t::A8)},
 )
 
   MP_DEFINE_CONST_OBJ_TYPE(
@@ -62,30 +62,51 @@ extern "C" {
     return seek_s.offset;
   }
 
+  // stores a decoded pixel into a row of the target in its pixel format. A8
+  // targets take the alpha channel if the PNG has one, otherwise luminance so
+  // that white on black masks can be used as-is
+  static inline void pngdec_store(pixel_format_t pixel_format, void *row, int x, uint8_t r, uint8_t g, uint8_t b, uint8_t a, bool has_alpha) {
+    switch(pixel_format) {
+      case A8: {
+        ((uint8_t *)row)[x] = has_alpha ? a : (r + (g * 2) + b) >> 2;
+      } break;
+
+      case RGB565: {
+        uint32_t c = rgb_color_t(r, g, b, a)._p;
+        ((uint16_t *)row)[x] = _rgb565(_r(c), _g(c), _b(c));
+      } break;
+
+      case RGBA4444: {
+        ((uint16_t *)row)[x] = _rgba4444(rgb_color_t(r, g, b, a)._p);
+      } break;
+
+      default: {
+        ((uint32_t *)row)[x] = rgb_color_t(r, g, b, a)._p;
+      } break;
+    }
+  }
+
   void pngdec_decode_callback(PNGDRAW *pDraw) {
     image_t *target = (image_t *)pDraw->pUser;
 
     uint8_t *psrc = (uint8_t *)pDraw->pPixels;
     int w = pDraw->iWidth;
+    pixel_format_t pixel_format = target->pixel_format();
 
     switch(pDraw->iPixelType) {
       case PNG_PIXEL_TRUECOLOR: {
-        uint32_t *pdst = (uint32_t *)target->ptr(0, pDraw->y);
-        while(w--) {
-          rgb_color_t c(psrc[0], psrc[1], psrc[2], 255);
-          *pdst = c._p;
+        void *pdst = target->ptr(0, pDraw->y);
+        for(int x = 0; x < w; x++) {
+          pngdec_store(pixel_format, pdst, x, psrc[0], psrc[1], psrc[2], 255, false);
           psrc += 3;
-          pdst++;
         }
       } break;
 
       case PNG_PIXEL_TRUECOLOR_ALPHA: {
-        uint32_t *pdst = (uint32_t *)target->ptr(0, pDraw->y);
-        while(w--) {
-          rgb_color_t c(psrc[0], psrc[1], psrc[2], psrc[3]);
-          *pdst = c._p;
+        void *pdst = target->ptr(0, pDraw->y);
+        for(int x = 0; x < w; x++) {
+          pngdec_store(pixel_format, pdst, x, psrc[0], psrc[1], psrc[2], psrc[3], true);
           psrc += 4;
-          pdst++;
         }
       } break;
 
@@ -108,16 +129,16 @@ extern "C" {
             psrc++;
           }
         } else {
-          uint32_t *pdst = (uint32_t *)target->ptr(0, pDraw->y);
-          while(w--) {
-            *pdst = rgb_color_t(
+          void *pdst = target->ptr(0, pDraw->y);
+          for(int x = 0; x < w; x++) {
+            pngdec_store(pixel_format, pdst, x,
               pDraw->pPalette[*psrc * 3 + 0],
               pDraw->pPalette[*psrc * 3 + 1],
               pDraw->pPalette[*psrc * 3 + 2],
-              pDraw->iHasAlpha ? pDraw->pPalette[768 + *psrc] : 255
-            )._p;
+              pDraw->iHasAlpha ? pDraw->pPalette[768 + *psrc] : 255,
+              pDraw->iHasAlpha
+            );
             psrc++;
-            pdst++;
           }
         }
       } break;
@@ -0,0 +1,171 @@
+#include "mp_helpers.hpp"
+#include "picovector.hpp"
+
+extern "C" {
+  #include "py/runtime.h"
+
+  MPY_BIND_DEL(particles, {
+    self(self_in, particles_obj_t);
+    if(self->particles) {
+      m_del_class(particle_system_t, self->particles);
+      self->particles = nullptr;
+    }
+    return mp_const_none;
+  })
+
+  // particles(capacity)
+  MPY_BIND_NEW(particles, {
+    if(n_args != 1) {
+      mp_raise_msg_varg(&mp_type_TypeError, MP_ERROR_TEXT("invalid parameter, expected particles(capacity)"));
+    }
+
+    int capacity = mp_obj_get_int(args[0]);
+    if(capacity <= 0) {
+      mp_raise_msg_varg(&mp_type_ValueError, MP_ERROR_TEXT("capacity must be greater than zero"));
+    }
+
+    particles_obj_t *self = mp_obj_malloc_with_finaliser(particles_obj_t, type);
+    self->particles = m_new_class(particle_system_t, capacity);
+    self->colors = mp_const_none;
+    return MP_OBJ_FROM_PTR(self);
+  })
+
+  // emit(count, position, [velocity], [spread], [life], [life_spread])
+  MPY_BIND_VAR(3, emit, {
+    self(args[0], particles_obj_t);
+    int count = mp_obj_get_int(args[1]);
+    vec2_t position = mp_obj_get_vec2(args[2]);
+    vec2_t velocity = n_args > 3 ? mp_obj_get_vec2(args[3]) : vec2_t(0.0f, 0.0f);
+    float spread = n_args > 4 ? mp_obj_get_float(args[4]) : 0.0f;
+    float life = n_args > 5 ? mp_obj_get_float(args[5]) : 1.0f;
+    float life_spread = n_args > 6 ? mp_obj_get_float(args[6]) : 0.0f;
+    return mp_obj_new_int(self->particles->emit(count, position, velocity, spread, life, life_spread));
+  })
+
+  // update(dt), dt in seconds
+  MPY_BIND_VAR(2, update, {
+    self(args[0], particles_obj_t);
+    self->particles->update(mp_obj_get_float(args[1]));
+    return mp_const_none;
+  })
+
+  MPY_BIND_VAR(1, clear, {
+    self(args[0], particles_obj_t);
+    self->particles->clear();
+    return mp_const_none;
+  })
+
+  // draw(target, [radius or image])
+  MPY_BIND_VAR(2, draw, {
+    self(args[0], particles_obj_t);
+    if(!mp_obj_is_type(args[1], &type_image)) {
+      mp_raise_msg_varg(&mp_type_TypeError, MP_ERROR_TEXT("invalid parameter, expected draw(image, [radius or image])"));
+    }
+    image_obj_t *target = (image_obj_t *)MP_OBJ_TO_PTR(args[1]);
+
+    if(n_args > 2 && mp_obj_is_type(args[2], &type_image)) {
+      image_obj_t *sprite = (image_obj_t *)MP_OBJ_TO_PTR(args[2]);
+      self->particles->draw(target->image, sprite->image);
+      return mp_const_none;
+    }
+
+    int radius = n_args > 2 ? mp_obj_get_int(args[2]) : 0;
+    self->particles->draw(target->image, radius);
+    return mp_const_none;
+  })
+
+  MPY_BIND_ATTR(particles, {
+    self(self_in, particles_obj_t);
+
+    action_t action = m_attr_action(dest);
+
+    switch(attr) {
+      case MP_QSTR_count: {
+        if(action == GET) {
+          dest[0] = mp_obj_new_int(self->particles->count);
+          return;
+        }
+      };
+
+      case MP_QSTR_capacity: {
+        if(action == GET) {
+          dest[0] = mp_obj_new_int(self->particles->capacity());
+          return;
+        }
+      };
+
+      case MP_QSTR_gravity: {
+        if(action == GET) {
+          vec2_obj_t *result = mp_obj_malloc(vec2_obj_t, &type_vec2);
+          result->v = self->particles->gravity;
+          dest[0] = MP_OBJ_FROM_PTR(result);
+          return;
+        }
+
+        if(action == SET) {
+          self->particles->gravity = mp_obj_get_vec2(dest[1]);
+          dest[0] = MP_OBJ_NULL;
+          return;
+        }
+      };
+
+      // the colour ramp, a list of colors spread evenly over each
+      // particle's life
+      case MP_QSTR_colors: {
+        if(action == GET) {
+          dest[0] = self->colors;
+          return;
+        }
+
+        if(action == SET) {
+          size_t n = 0;
+          mp_obj_t *items = nullptr;
+          if(dest[1] != mp_const_none) {
+            mp_obj_get_array(dest[1], &n, &items);
+          }
+
+          uint32_t ramp[PARTICLE_RAMP_SIZE];
+          n = std::min(n, size_t(PARTICLE_RAMP_SIZE));
+          for(size_t i = 0; i < n; i++) {
+            if(!mp_obj_is_type(items[i], &type_color)) {
+              mp_raise_msg_varg(&mp_type_TypeError, MP_ERROR_TEXT("colors must be a list of colors"));
+            }
+            ramp[i] = ((color_obj_t *)MP_OBJ_TO_PTR(items[i]))->c->_p;
+          }
+
+          self->particles->set_ramp(ramp, n);
+          self->colors = dest[1];
+          dest[0] = MP_OBJ_NULL;
+          return;
+        }
+      };
+    }
+
+    // we didn't handle this, fall back to alternative methods
+    dest[1] = MP_OBJ_SENTINEL;
+  })
+
+  static void particles_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
+    self(self_in, particles_obj_t);
+    mp_printf(print, "particles(%d / %d)", self->particles->count, self->particles->capacity());
+  }
+
+  MPY_BIND_LOCALS_DICT(particles,
+    MPY_BIND_ROM_PTR_DEL(particles),
+    MPY_BIND_ROM_PTR(emit),
+    MPY_BIND_ROM_PTR(update),
+    MPY_BIND_ROM_PTR(clear),
+    MPY_BIND_ROM_PTR(draw),
+  )
+
+  MP_DEFINE_CONST_OBJ_TYPE(
+      type_particles,
+      MP_QSTR_particles,
+      MP_TYPE_FLAG_NONE,
+      make_new, (const void *)particles_new,
+      print, (const void *)particles_print,
+      attr, (const void *)particles_attr,
+      locals_dict, &particles_locals_dict
+  );
+
+}
@@ -1,5 +1,6 @@
 #ifndef NO_QSTR
 #include <algorithm>
+#include <functional>
 #include "mp_tracked_allocator.hpp"
 
 #include "../picovector.hpp"
@@ -8,8 +9,14 @@
 #include "../image.hpp"
 #include "../brush.hpp"
 #include "../font.hpp"
+#include "../glyph_cache.hpp"
 #include "../color.hpp"
 #include "../pixel_font.hpp"
+#include "../tilemap.hpp"
+#include "../sprite_batch.hpp"
+#include "../particles.hpp"
+#include "../collision.hpp"
+#include "../text_layout.hpp"
 #include "../blend.hpp"
 #include "PNGdec.h"
 #endif
@@ -42,8 +49,9 @@ extern "C" {
   typedef struct _font_obj_t {
     mp_obj_base_t base;
     font_t font;
-    uint8_t *buffer;
+    uint8_t *buffer;      // the loaded font and its lookup index, or just the index if mapped
     uint32_t buffer_size;
+    mp_obj_t source;      // the mapped file or buffer
   } font_obj_t;
 
   typedef struct _color_obj_t {
@@ -54,10 +62,9 @@ extern "C" {
   typedef struct _pixel_font_obj_t {
     mp_obj_base_t base;
     pixel_font_t *font;
-    uint8_t *glyph_buffer;
-    uint32_t glyph_buffer_size;
-    uint8_t *glyph_data_buffer;
-    uint32_t glyph_data_buffer_size;
+    uint8_t *buffer;      // the loaded font, null if it's mapped in place
+    uint32_t buffer_size;
+    mp_obj_t source;      // the mapped file or buffer
   } pixel_font_obj_t;
 
   typedef struct _image_obj_t {
@@ -69,6 +76,48 @@ extern "C" {
     void *parent;
   } image_obj_t;
 
+  typedef struct _tilemap_obj_t {
+    mp_obj_base_t base;
+    tilemap_t *tilemap;
+    mp_obj_t tileset;
+    mp_obj_t map;
+    int map_width;
+  } tilemap_obj_t;
+
+  typedef struct _sprite_batch_obj_t {
+    mp_obj_base_t base;
+    sprite_batch_t *batch;
+    mp_obj_t sheet;
+  } sprite_batch_obj_t;
+
+  typedef struct _particles_obj_t {
+    mp_obj_base_t base;
+    particle_system_t *particles;
+    mp_obj_t colors;
+  } particles_obj_t;
+
+  typedef struct _collision_mask_obj_t {
+    mp_obj_base_t base;
+    collision_mask_t *mask;
+  } collision_mask_obj_t;
+
+  typedef struct _collision_grid_obj_t {
+    mp_obj_base_t base;
+    collision_grid_t *grid;
+    mp_obj_t *masks; // the mask objects added, so they outlive the grid's use of them
+  } collision_grid_obj_t;
+
+  typedef struct _text_layout_obj_t {
+    mp_obj_base_t base;
+    text_layout_t *layout;
+    mp_obj_t text;
+    mp_obj_t font;
+    float size;
+    float line_spacing;
+    float word_spacing;
+    text_align_t align;
+  } text_layout_obj_t;
+
   typedef struct _rect_obj_t {
     mp_obj_base_t base;
     rect_t r;
@@ -92,6 +141,15 @@ extern "C" {
 
 extern rect_t mp_obj_get_rect(mp_obj_t rect_in);
 extern rect_t mp_obj_get_rect_from_xywh(const mp_obj_t *args);
+extern mp_obj_t mp_obj_new_rect(const rect_t &r);
+
+// font.measure() and pixel_font.measure() results, defined in font.cpp.
+// `measure` is called for each string if `text` is a list or tuple
+extern mp_obj_t mp_obj_new_text_metrics(const text_metrics_t &m);
+extern mp_obj_t mp_obj_measure_texts(mp_obj_t text, const std::function<text_metrics_t(const char *)> &measure);
+// font.render() and pixel_font.render() results, an A8 image of `bounds`
+// filled by `render` and the offset to blit it at from the pen
+extern mp_obj_t mp_obj_new_text_render(const rect_t &bounds, const std::function<void(image_t *)> &render);
 
 extern vec2_t mp_obj_get_vec2(mp_obj_t vec2_in);
 extern vec2_t mp_obj_get_vec2_from_xy(const mp_obj_t *args);
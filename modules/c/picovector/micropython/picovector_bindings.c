@@ -19,6 +19,12 @@ static const mp_rom_map_elem_t modpicovector_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR_algorithm),  MP_ROM_PTR(&type_algorithm) },
     { MP_ROM_QSTR(MP_QSTR_pixel_font),  MP_ROM_PTR(&type_pixel_font) },
     { MP_ROM_QSTR(MP_QSTR_mat3),  MP_ROM_PTR(&type_mat3) },
+    { MP_ROM_QSTR(MP_QSTR_tilemap),  MP_ROM_PTR(&type_tilemap) },
+    { MP_ROM_QSTR(MP_QSTR_sprite_batch),  MP_ROM_PTR(&type_sprite_batch) },
+    { MP_ROM_QSTR(MP_QSTR_particles),  MP_ROM_PTR(&type_particles) },
+    { MP_ROM_QSTR(MP_QSTR_collision_mask),  MP_ROM_PTR(&type_collision_mask) },
+    { MP_ROM_QSTR(MP_QSTR_collision_grid),  MP_ROM_PTR(&type_collision_grid) },
+    { MP_ROM_QSTR(MP_QSTR_text_layout),  MP_ROM_PTR(&type_text_layout) },
     { MP_ROM_QSTR(MP_QSTR_io),  MP_ROM_PTR(&mod_input) },
 };
 static MP_DEFINE_CONST_DICT(modpicovector_globals, modpicovector_globals_table);
@@ -12,92 +12,169 @@ extern "C" {
 
   MPY_BIND_DEL(pixel_font, {
     self(self_in, pixel_font_obj_t);
+    text_metrics_forget(self->font);
+    if(self->buffer) {
 #if MICROPY_MALLOC_USES_ALLOCATED_SIZE
-    m_free(self->glyph_buffer, self->glyph_buffer_size);
-    m_free(self->glyph_data_buffer, self->glyph_data_buffer_size);
+      m_free(self->buffer, self->buffer_size);
 #else
-    m_free(self->glyph_buffer);
-    m_free(self->glyph_data_buffer);
+      m_free(self->buffer);
 #endif
+      self->buffer = nullptr;
+    }
     return mp_const_none;
   })
 
+  // allocates (or grows) the buffer a font file is loaded into, in the
+  // version 2 layout
+  static uint8_t *pixel_font_alloc(pixel_font_obj_t *self, uint32_t size) {
+    if(self->buffer) {
+#if MICROPY_MALLOC_USES_ALLOCATED_SIZE
+      self->buffer = (uint8_t *)m_realloc(self->buffer, self->buffer_size, size);
+#else
+      self->buffer = (uint8_t *)m_realloc(self->buffer, size);
+#endif
+    } else {
+      self->buffer = (uint8_t *)m_malloc(size);
+    }
+    self->buffer_size = size;
+    if(!self->buffer) {
+      mp_raise_msg_varg(&mp_type_OSError, MP_ERROR_TEXT("couldn't allocate buffer for font data"));
+    }
+    return self->buffer;
+  }
+
+  static uint32_t pixel_font_bitmap_size(uint32_t glyph_count, uint16_t width, uint16_t height) {
+    uint32_t bpr = (width + 7) >> 3;
+    return sizeof(ppf2_header_t) + (sizeof(pixel_font_glyph_t) + bpr * height) * glyph_count;
+  }
+
+  // pixel_font.load(path or buffer)
+  //
+  // version 2 fonts are used in place wherever the data can be mapped, from
+  // romfs files or any object with the buffer protocol, costing no heap and
+  // no reads. anything else is read into a single buffer
   MPY_BIND_STATICMETHOD_ARGS1(load, path, {
     pixel_font_obj_t *result = mp_obj_malloc_with_finaliser(pixel_font_obj_t, &type_pixel_font);
+    result->font = m_new_class(pixel_font_t);
+    result->buffer = nullptr;
+    result->source = mp_const_none;
+
+    mp_obj_t source = path;
+    if(mp_obj_is_str(path)) {
+      mp_obj_t args[2];
+      args[0] = path;
+      args[1] = MP_ROM_QSTR(MP_QSTR_rb);
+      source = mp_vfs_open(MP_ARRAY_SIZE(args), args, (mp_map_t *)&mp_const_empty_map);
+    }
 
-    // open the file for binary reading
-    //mp_obj_t args[2] = {path, MP_ROM_QSTR(MP_QSTR_r)} // Brace enclosed initialiser lists don't work in the binding macros :(
-    mp_obj_t args[2];
-    args[0] = path;
-    args[1] = MP_ROM_QSTR(MP_QSTR_r);
-    mp_obj_t file = mp_vfs_open(MP_ARRAY_SIZE(args), args, (mp_map_t *)&mp_const_empty_map);
+    mp_buffer_info_t mapped;
+    if(mp_get_buffer(source, &mapped, MP_BUFFER_READ)) {
+      if(result->font->map((const uint8_t *)mapped.buf, mapped.len)) {
+        // keep the mapping alive for as long as the font
+        result->source = source;
+        return MP_OBJ_FROM_PTR(result);
+      }
+      if(!mp_obj_is_str(path)) {
+        mp_raise_msg_varg(&mp_type_ValueError, MP_ERROR_TEXT("failed to load font, buffer isn't a version 2 PPF"));
+      }
+    }
 
+    mp_obj_t file = source;
     int error;
 
-    //debug_printf("load pixel font\n");
-
-    // check for ppf file header
     char marker[4];
     mp_stream_read_exactly(file, &marker, sizeof(marker), &error);
-    if(memcmp(marker, "ppf!", 4) != 0) {
+
+    if(memcmp(marker, "ppf2", 4) == 0) {
+      // already in memory layout, read the rest of the header to size it
+      ppf2_header_t header;
+      memcpy(header.marker, marker, sizeof(marker));
+      mp_stream_read_exactly(file, (uint8_t *)&header + sizeof(marker), sizeof(header) - sizeof(marker), &error);
+
+      if(header.flags & PPF_FLAG_RLE) {
+        // the size of the run data is the last glyph offset, so the tables
+        // are read first and the buffer grown to fit the runs
+        uint32_t tables = sizeof(header) + (sizeof(pixel_font_glyph_t) + sizeof(uint32_t)) * header.glyph_count + sizeof(uint32_t);
+        uint8_t *buffer = pixel_font_alloc(result, tables);
+        memcpy(buffer, &header, sizeof(header));
+        mp_stream_read_exactly(file, buffer + sizeof(header), tables - sizeof(header), &error);
+
+        uint32_t runs;
+        memcpy(&runs, buffer + tables - sizeof(uint32_t), sizeof(runs));
+        buffer = pixel_font_alloc(result, tables + runs);
+        mp_stream_read_exactly(file, buffer + tables, runs, &error);
+      } else {
+        uint8_t *buffer = pixel_font_alloc(result, pixel_font_bitmap_size(header.glyph_count, header.width, header.height));
+        memcpy(buffer, &header, sizeof(header));
+        mp_stream_read_exactly(file, buffer + sizeof(header), result->buffer_size - sizeof(header), &error);
+      }
+    } else if(memcmp(marker, "ppf!", 4) == 0) {
+      // version 1 is big endian with 6 byte glyph entries, it's converted
+      // into the version 2 layout as it's read
+      ppf2_header_t header;
+      memcpy(header.marker, "ppf2", 4);
+      header.flags       = ru16(file) & ~PPF_FLAG_RLE;  // version 1 glyphs are always bitmaps
+      header.glyph_count = ru32(file);
+      header.width       = ru16(file);
+      header.height      = ru16(file);
+      header.reserved    = 0;
+      mp_stream_read_exactly(file, header.name, sizeof(header.name), &error);
+
+      uint8_t *buffer = pixel_font_alloc(result, pixel_font_bitmap_size(header.glyph_count, header.width, header.height));
+      memcpy(buffer, &header, sizeof(header));
+
+      // the packed entries are read into the end of the glyph table and
+      // widened front to back, each entry is read before it's overwritten
+      pixel_font_glyph_t *glyphs = (pixel_font_glyph_t *)(buffer + sizeof(header));
+      uint32_t count = header.glyph_count;
+      uint8_t *packed = (uint8_t *)glyphs + count * 2;
+      mp_stream_read_exactly(file, packed, count * 6, &error);
+      for(uint32_t i = 0; i < count; i++) {
+        const uint8_t *p = packed + i * 6;
+        uint32_t codepoint = (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+        uint16_t width = (p[4] << 8) | p[5];
+        glyphs[i].codepoint = codepoint;
+        glyphs[i].width = width;
+        glyphs[i].reserved = 0;
+      }
+
+      uint8_t *data = (uint8_t *)(glyphs + count);
+      mp_stream_read_exactly(file, data, result->buffer_size - (data - buffer), &error);
+    } else {
       mp_raise_msg_varg(&mp_type_OSError, MP_ERROR_TEXT("failed to load font, missing PPF header"));
     }
-    //debug_printf("- valid header\n");
 
-    uint16_t flags        = ru16(file);
-    uint32_t glyph_count  = ru32(file);
-    uint16_t glyph_width  = ru16(file);
-    uint16_t glyph_height = ru16(file);
-    //debug_printf("- glyph width = %d, height = %d, count = %" PRIu32 "\n", glyph_width, glyph_height, glyph_count);
-
-    char name[32];
-    mp_stream_read_exactly(file, name, sizeof(name), &error);
-    //debug_printf("- font name '%s'\n", name);
-
-    // calculate how much data needed to store each glyphs pixel data
-    uint32_t bpr = floor((glyph_width + 7) / 8);
-    uint32_t glyph_data_size = bpr * glyph_height;
-    //debug_printf("- glyph data size = %" PRIu32 " (%" PRIu32 " byes per row)\n", glyph_data_size, bpr);
-
-    // allocate buffers to store glyph and pixel data
-    result->glyph_buffer_size = sizeof(pixel_font_glyph_t) * glyph_count;
-    result->glyph_buffer = (uint8_t*)m_malloc(result->glyph_buffer_size);
-
-    result->glyph_data_buffer_size = glyph_data_size * glyph_count;
-    result->glyph_data_buffer = (uint8_t*)m_malloc(result->glyph_data_buffer_size);
-
-    //debug_printf("- glyph buffer at %p (%" PRIu32 " bytes)\n", result->glyph_buffer, result->glyph_buffer_size);
-    //debug_printf("- glyph data buffer at %p (%" PRIu32 " bytes)\n", result->glyph_data_buffer, result->glyph_data_buffer_size);
-
-    if(!result->glyph_buffer || !result->glyph_data_buffer) {
-      mp_raise_msg_varg(&mp_type_OSError, MP_ERROR_TEXT("couldn't allocate buffer for font data"));
-    }
+    mp_stream_close(file);
 
-    // read codepoint list
-    pixel_font_glyph_t *glyphs = (pixel_font_glyph_t*)result->glyph_buffer;
-    for(uint32_t i = 0; i < glyph_count; i++) {
-      glyphs[i].codepoint = ru32(file);
-      glyphs[i].width = ru16(file);
+    if(!result->font->map(result->buffer, result->buffer_size)) {
+      mp_raise_msg_varg(&mp_type_OSError, MP_ERROR_TEXT("failed to load font, invalid PPF data"));
     }
-    //debug_printf("- read codepoint list\n");
-
-    // read glyph data into buffer
-    //debug_printf("- writing into glyph data buffer\n");
-    mp_stream_read_exactly(file, result->glyph_data_buffer, result->glyph_data_buffer_size, &error);
-    //debug_printf("- read pixel data\n");
 
-    result->font = m_new_class(pixel_font_t);
-    result->font->glyph_count     = glyph_count;
-    result->font->width           = glyph_width;
-    result->font->height          = glyph_height;
-    result->font->glyph_data_size = glyph_data_size;
-    result->font->glyphs          = glyphs;
-    result->font->glyph_data      = result->glyph_data_buffer;
-    strcpy(result->font->name, name);
+    return MP_OBJ_FROM_PTR(result);
+  })
 
-    mp_stream_close(file);
+  // render(text), the text drawn once into an A8 image that can be blitted
+  // with any pen, cheaper than drawing it again every frame. returns
+  // (image, offset) as font.render() does
+  MPY_BIND_VAR(2, render, {
+    self(args[0], pixel_font_obj_t);
+    const char *text = mp_obj_str_get_str(args[1]);
+
+    rect_t bounds = self->font->render_bounds(text);
+    return mp_obj_new_text_render(bounds, [&](image_t *mask) {
+      self->font->render(mask, text, bounds);
+    });
+  })
 
-    return MP_OBJ_FROM_PTR(result);
+  // measure(text), the advance and ink rects of the text with the pen at
+  // the top left of the line. `text` can be a list of strings to measure
+  // them all at once, giving a list of results
+  MPY_BIND_VAR(2, measure, {
+    self(args[0], pixel_font_obj_t);
+    pixel_font_t *font = self->font;
+    return mp_obj_measure_texts(args[1], [font](const char *text) {
+      return font->measure(text);
+    });
   })
 
   static void pixel_font_attr(mp_obj_t self_in, qstr attr, mp_obj_t *dest) {
@@ -136,6 +213,8 @@ extern "C" {
   MPY_BIND_LOCALS_DICT(pixel_font,
       MPY_BIND_ROM_PTR_DEL(pixel_font),
       MPY_BIND_ROM_PTR_STATIC(load),
+      MPY_BIND_ROM_PTR(render),
+      MPY_BIND_ROM_PTR(measure),
   )
 
   MP_DEFINE_CONST_OBJ_TYPE(
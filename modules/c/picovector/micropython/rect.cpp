@@ -17,6 +17,12 @@ rect_t mp_obj_get_rect(mp_obj_t rect_in) {
   mp_raise_msg_varg(&mp_type_ValueError, MP_ERROR_TEXT("invalid parameters, expected rect(x, y, w, h)"));
 }
 
+mp_obj_t mp_obj_new_rect(const rect_t &r) {
+  rect_obj_t *result = mp_obj_malloc(rect_obj_t, &type_rect);
+  result->r = r;
+  return MP_OBJ_FROM_PTR(result);
+}
+
 rect_t mp_obj_get_rect_from_xywh(const mp_obj_t *args) {
     int x = mp_obj_get_float(args[0]);
     int y = mp_obj_get_float(args[1]);
@@ -0,0 +1,147 @@
+#include "mp_helpers.hpp"
+#include "picovector.hpp"
+
+extern "C" {
+  #include "py/runtime.h"
+
+  MPY_BIND_DEL(sprite_batch, {
+    self(self_in, sprite_batch_obj_t);
+    if(self->batch) {
+      m_del_class(sprite_batch_t, self->batch);
+      self->batch = nullptr;
+    }
+    return mp_const_none;
+  })
+
+  // sprite_batch(sheet, sprite_width, sprite_height, capacity)
+  MPY_BIND_NEW(sprite_batch, {
+    if(n_args != 4 || !mp_obj_is_type(args[0], &type_image)) {
+      mp_raise_msg_varg(&mp_type_TypeError, MP_ERROR_TEXT("invalid parameter, expected sprite_batch(image, sprite_width, sprite_height, capacity)"));
+    }
+
+    int sprite_width = mp_obj_get_int(args[1]);
+    int sprite_height = mp_obj_get_int(args[2]);
+    if(sprite_width <= 0 || sprite_height <= 0) {
+      mp_raise_msg_varg(&mp_type_ValueError, MP_ERROR_TEXT("sprite size must be greater than zero"));
+    }
+
+    int capacity = mp_obj_get_int(args[3]);
+    if(capacity <= 0 || capacity > 0xffff) {
+      mp_raise_msg_varg(&mp_type_ValueError, MP_ERROR_TEXT("capacity must be between 1 and 65535"));
+    }
+
+    sprite_batch_obj_t *self = mp_obj_malloc_with_finaliser(sprite_batch_obj_t, type);
+    image_obj_t *sheet = (image_obj_t *)MP_OBJ_TO_PTR(args[0]);
+    self->batch = m_new_class(sprite_batch_t, sheet->image, sprite_width, sprite_height, capacity);
+    self->sheet = args[0];
+    return MP_OBJ_FROM_PTR(self);
+  })
+
+  // add(index, x, y, [flip], [alpha])
+  MPY_BIND_VAR(4, add, {
+    self(args[0], sprite_batch_obj_t);
+    int flags = n_args > 4 ? mp_obj_get_int(args[4]) : 0;
+    int alpha = n_args > 5 ? mp_obj_get_int(args[5]) : 255;
+    if(!self->batch->add(mp_obj_get_int(args[1]), mp_obj_get_int(args[2]), mp_obj_get_int(args[3]), flags, alpha)) {
+      mp_raise_msg_varg(&mp_type_IndexError, MP_ERROR_TEXT("sprite batch is full"));
+    }
+    return mp_const_none;
+  })
+
+  MPY_BIND_VAR(1, clear, {
+    self(args[0], sprite_batch_obj_t);
+    self->batch->clear();
+    return mp_const_none;
+  })
+
+  // draw(target, [sort])
+  MPY_BIND_VAR(2, draw, {
+    self(args[0], sprite_batch_obj_t);
+    if(!mp_obj_is_type(args[1], &type_image)) {
+      mp_raise_msg_varg(&mp_type_TypeError, MP_ERROR_TEXT("invalid parameter, expected draw(image, [sort])"));
+    }
+    image_obj_t *target = (image_obj_t *)MP_OBJ_TO_PTR(args[1]);
+    bool sort = n_args > 2 ? mp_obj_is_true(args[2]) : true;
+    self->batch->draw(target->image, sort);
+    return mp_const_none;
+  })
+
+  MPY_BIND_ATTR(sprite_batch, {
+    self(self_in, sprite_batch_obj_t);
+
+    action_t action = m_attr_action(dest);
+
+    switch(attr) {
+      case MP_QSTR_count: {
+        if(action == GET) {
+          dest[0] = mp_obj_new_int(self->batch->count);
+          return;
+        }
+
+        if(action == SET) {
+          int count = mp_obj_get_int(dest[1]);
+          if(count < 0 || count > self->batch->capacity()) {
+            mp_raise_msg_varg(&mp_type_ValueError, MP_ERROR_TEXT("count must be between 0 and capacity"));
+          }
+          self->batch->count = count;
+          dest[0] = MP_OBJ_NULL;
+          return;
+        }
+      };
+
+      case MP_QSTR_capacity: {
+        if(action == GET) {
+          dest[0] = mp_obj_new_int(self->batch->capacity());
+          return;
+        }
+      };
+
+      case MP_QSTR_sheet: {
+        if(action == GET) {
+          dest[0] = self->sheet;
+          return;
+        }
+      };
+    }
+
+    // we didn't handle this, fall back to alternative methods
+    dest[1] = MP_OBJ_SENTINEL;
+  })
+
+  static void sprite_batch_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
+    self(self_in, sprite_batch_obj_t);
+    mp_printf(print, "sprite_batch(%d / %d)", self->batch->count, self->batch->capacity());
+  }
+
+  // the entries can be written directly, each is eight bytes packed as
+  // "<HhhBB" (index, x, y, flip, alpha). set count afterwards
+  static mp_int_t sprite_batch_get_buffer(mp_obj_t self_in, mp_buffer_info_t *bufinfo, mp_uint_t flags) {
+    self(self_in, sprite_batch_obj_t);
+    bufinfo->buf = self->batch->entries();
+    bufinfo->len = self->batch->capacity() * sizeof(sprite_batch_entry_t);
+    bufinfo->typecode = 'B';
+    return 0;
+  }
+
+  MPY_BIND_LOCALS_DICT(sprite_batch,
+    MPY_BIND_ROM_PTR_DEL(sprite_batch),
+    MPY_BIND_ROM_PTR(add),
+    MPY_BIND_ROM_PTR(clear),
+    MPY_BIND_ROM_PTR(draw),
+
+    MPY_BIND_ROM_INT(FLIP_H, SPRITE_FLIP_H),
+    MPY_BIND_ROM_INT(FLIP_V, SPRITE_FLIP_V),
+  )
+
+  MP_DEFINE_CONST_OBJ_TYPE(
+      type_sprite_batch,
+      MP_QSTR_sprite_batch,
+      MP_TYPE_FLAG_NONE,
+      make_new, (const void *)sprite_batch_new,
+      print, (const void *)sprite_batch_print,
+      attr, (const void *)sprite_batch_attr,
+      buffer, (const void *)sprite_batch_get_buffer,
+      locals_dict, &sprite_batch_locals_dict
+  );
+
+}
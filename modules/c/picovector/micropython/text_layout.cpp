@@ -0,0 +1,156 @@
+#include "mp_helpers.hpp"
+#include "picovector.hpp"
+
+extern "C" {
+  #include "py/runtime.h"
+
+  static void text_layout_update(text_layout_obj_t *self) {
+    font_t *font = nullptr;
+    pixel_font_t *pixel_font = nullptr;
+    if(mp_obj_is_type(self->font, &type_font)) {
+      font = &((font_obj_t *)MP_OBJ_TO_PTR(self->font))->font;
+    } else {
+      pixel_font = ((pixel_font_obj_t *)MP_OBJ_TO_PTR(self->font))->font;
+    }
+
+    const char *text = mp_obj_str_get_str(self->text);
+    self->layout->layout(text, font, pixel_font, self->layout->bounds, self->size,
+                         self->line_spacing, self->word_spacing, self->align);
+  }
+
+  MPY_BIND_DEL(text_layout, {
+    self(self_in, text_layout_obj_t);
+    if(self->layout) {
+      m_del_class(text_layout_t, self->layout);
+      self->layout = nullptr;
+    }
+    return mp_const_none;
+  })
+
+  // text_layout(text, font, bounds, [size], [line_spacing], [word_spacing], [align])
+  MPY_BIND_NEW(text_layout, {
+    if(n_args < 3 || n_args > 7 || !mp_obj_is_str(args[0]) ||
+       (!mp_obj_is_type(args[1], &type_font) && !mp_obj_is_type(args[1], &type_pixel_font))) {
+      mp_raise_msg_varg(&mp_type_TypeError, MP_ERROR_TEXT("invalid parameter, expected text_layout(text, font, rect, [size], [line_spacing], [word_spacing], [align])"));
+    }
+
+    int align = n_args > 6 ? mp_obj_get_int(args[6]) : (int)TEXT_ALIGN_LEFT;
+    if(align < TEXT_ALIGN_LEFT || align > TEXT_ALIGN_RIGHT) {
+      mp_raise_msg_varg(&mp_type_ValueError, MP_ERROR_TEXT("align must be LEFT, CENTER or RIGHT"));
+    }
+
+    text_layout_obj_t *self = mp_obj_malloc_with_finaliser(text_layout_obj_t, type);
+    self->text = args[0];
+    self->font = args[1];
+    self->size = n_args > 3 ? mp_obj_get_float(args[3]) : 24.0f;
+    self->line_spacing = n_args > 4 ? mp_obj_get_float(args[4]) : 1.0f;
+    self->word_spacing = n_args > 5 ? mp_obj_get_float(args[5]) : 1.0f;
+    self->align = (text_align_t)align;
+    self->layout = m_new_class(text_layout_t);
+    self->layout->bounds = mp_obj_get_rect(args[2]);
+    text_layout_update(self);
+    return MP_OBJ_FROM_PTR(self);
+  })
+
+  // draw(target)
+  MPY_BIND_VAR(2, draw, {
+    self(args[0], text_layout_obj_t);
+    if(!mp_obj_is_type(args[1], &type_image)) {
+      mp_raise_msg_varg(&mp_type_TypeError, MP_ERROR_TEXT("invalid parameter, expected draw(image)"));
+    }
+    image_obj_t *target = (image_obj_t *)MP_OBJ_TO_PTR(args[1]);
+    self->layout->draw(target->image);
+    return mp_const_none;
+  })
+
+  MPY_BIND_ATTR(text_layout, {
+    self(self_in, text_layout_obj_t);
+
+    action_t action = m_attr_action(dest);
+
+    switch(attr) {
+      // setting the text or bounds lays the text out again
+      case MP_QSTR_text: {
+        if(action == GET) {
+          dest[0] = self->text;
+          return;
+        }
+
+        if(action == SET) {
+          if(!mp_obj_is_str(dest[1])) {
+            mp_raise_TypeError(MP_ERROR_TEXT("value must be a string"));
+          }
+          self->text = dest[1];
+          text_layout_update(self);
+          dest[0] = MP_OBJ_NULL;
+          return;
+        }
+      };
+
+      case MP_QSTR_bounds: {
+        if(action == GET) {
+          rect_obj_t *result = mp_obj_malloc(rect_obj_t, &type_rect);
+          result->r = self->layout->bounds;
+          dest[0] = MP_OBJ_FROM_PTR(result);
+          return;
+        }
+
+        if(action == SET) {
+          self->layout->bounds = mp_obj_get_rect(dest[1]);
+          text_layout_update(self);
+          dest[0] = MP_OBJ_NULL;
+          return;
+        }
+      };
+
+      case MP_QSTR_width: {
+        if(action == GET) {
+          dest[0] = mp_obj_new_float(self->layout->width);
+          return;
+        }
+      };
+
+      case MP_QSTR_height: {
+        if(action == GET) {
+          dest[0] = mp_obj_new_float(self->layout->height);
+          return;
+        }
+      };
+
+      case MP_QSTR_count: {
+        if(action == GET) {
+          dest[0] = mp_obj_new_int(self->layout->glyphs.size());
+          return;
+        }
+      };
+    }
+
+    // we didn't handle this, fall back to alternative methods
+    dest[1] = MP_OBJ_SENTINEL;
+  })
+
+  static void text_layout_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
+    self(self_in, text_layout_obj_t);
+    mp_printf(print, "text_layout(%d glyphs, %f x %f)", int(self->layout->glyphs.size()), self->layout->width, self->layout->height);
+  }
+
+  MPY_BIND_LOCALS_DICT(text_layout,
+    MPY_BIND_ROM_PTR_DEL(text_layout),
+    MPY_BIND_ROM_PTR(draw),
+
+    { MP_ROM_QSTR(MP_QSTR_LEFT), MP_ROM_INT(TEXT_ALIGN_LEFT)},
+    { MP_ROM_QSTR(MP_QSTR_CENTER), MP_ROM_INT(TEXT_ALIGN_CENTER)},
+    { MP_ROM_QSTR(MP_QSTR_RIGHT), MP_ROM_INT(TEXT_ALIGN_RIGHT)},
+  )
+
+  MP_DEFINE_CONST_OBJ_TYPE(
+      type_text_layout,
+      MP_QSTR_text_layout,
+      MP_TYPE_FLAG_NONE,
+      make_new, (const void *)text_layout_new,
+      print, (const void *)text_layout_print,
+      attr, (const void *)text_layout_attr,
+      locals_dict, &text_layout_locals_dict
+  );
+
+}
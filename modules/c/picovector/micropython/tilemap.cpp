@@ -0,0 +1,152 @@
+#include "mp_helpers.hpp"
+#include "picovector.hpp"
+
+extern "C" {
+  #include "py/runtime.h"
+  #include "py/binary.h"
+
+  // the map's cells are bytes or, for tilesets of more than 255 tiles, an
+  // array("H"). bytearrays (and views of them) report their own typecode
+  // rather than 'B'
+  static void mp_obj_get_tilemap_map(mp_obj_t map_in, int map_width, mp_buffer_info_t *map, bool *wide, int *map_height) {
+    mp_get_buffer_raise(map_in, map, MP_BUFFER_READ);
+    switch(map->typecode) {
+      case BYTEARRAY_TYPECODE: case 'B': case 'b': *wide = false; break;
+      case 'H': case 'h': *wide = true; break;
+      default:
+        mp_raise_msg_varg(&mp_type_ValueError, MP_ERROR_TEXT("map must be a bytearray, bytes or an array of \"B\" or \"H\""));
+    }
+
+    if(map_width <= 0) {
+      mp_raise_msg_varg(&mp_type_ValueError, MP_ERROR_TEXT("map width must be greater than zero"));
+    }
+    *map_height = map->len / ((*wide ? 2 : 1) * map_width);
+  }
+
+  MPY_BIND_DEL(tilemap, {
+    self(self_in, tilemap_obj_t);
+    if(self->tilemap) {
+      m_del_class(tilemap_t, self->tilemap);
+      self->tilemap = nullptr;
+    }
+    return mp_const_none;
+  })
+
+  // tilemap(tileset, tile_width, tile_height, map, map_width, [cache])
+  MPY_BIND_NEW(tilemap, {
+    if(n_args < 5 || !mp_obj_is_type(args[0], &type_image)) {
+      mp_raise_msg_varg(&mp_type_TypeError, MP_ERROR_TEXT("invalid parameter, expected tilemap(image, tile_width, tile_height, map, map_width, [cache])"));
+    }
+
+    int tile_width = mp_obj_get_int(args[1]);
+    int tile_height = mp_obj_get_int(args[2]);
+    if(tile_width <= 0 || tile_height <= 0) {
+      mp_raise_msg_varg(&mp_type_ValueError, MP_ERROR_TEXT("tile size must be greater than zero"));
+    }
+
+    int map_width = mp_obj_get_int(args[4]);
+    mp_buffer_info_t map;
+    bool wide;
+    int map_height;
+    mp_obj_get_tilemap_map(args[3], map_width, &map, &wide, &map_height);
+
+    bool cache = n_args > 5 && mp_obj_is_true(args[5]);
+
+    tilemap_obj_t *self = mp_obj_malloc_with_finaliser(tilemap_obj_t, type);
+    image_obj_t *tileset = (image_obj_t *)MP_OBJ_TO_PTR(args[0]);
+    self->tilemap = m_new_class(tilemap_t, tileset->image, tile_width, tile_height, cache);
+    self->tileset = args[0];
+    self->map = args[3];
+    self->map_width = map_width;
+    return MP_OBJ_FROM_PTR(self);
+  })
+
+  // draw(target, [scroll])
+  MPY_BIND_VAR(2, draw, {
+    self(args[0], tilemap_obj_t);
+    if(!mp_obj_is_type(args[1], &type_image)) {
+      mp_raise_msg_varg(&mp_type_TypeError, MP_ERROR_TEXT("invalid parameter, expected draw(image, [vec2])"));
+    }
+    image_obj_t *target = (image_obj_t *)MP_OBJ_TO_PTR(args[1]);
+    vec2_t scroll = n_args > 2 ? mp_obj_get_vec2(args[2]) : vec2_t(0, 0);
+
+    // the map is looked up on every draw as its buffer may have moved
+    mp_buffer_info_t map;
+    bool wide;
+    int map_height;
+    mp_obj_get_tilemap_map(self->map, self->map_width, &map, &wide, &map_height);
+
+    self->tilemap->draw(target->image, map.buf, self->map_width, map_height, wide, scroll);
+    return mp_const_none;
+  })
+
+  MPY_BIND_VAR(1, invalidate, {
+    self(args[0], tilemap_obj_t);
+    self->tilemap->invalidate();
+    return mp_const_none;
+  })
+
+  MPY_BIND_ATTR(tilemap, {
+    self(self_in, tilemap_obj_t);
+
+    action_t action = m_attr_action(dest);
+
+    switch(attr) {
+      case MP_QSTR_map: {
+        if(action == GET) {
+          dest[0] = self->map;
+          return;
+        }
+
+        if(action == SET) {
+          mp_buffer_info_t map;
+          bool wide;
+          int map_height;
+          mp_obj_get_tilemap_map(dest[1], self->map_width, &map, &wide, &map_height);
+          self->map = dest[1];
+          dest[0] = MP_OBJ_NULL;
+          return;
+        }
+      };
+
+      case MP_QSTR_tileset: {
+        if(action == GET) {
+          dest[0] = self->tileset;
+          return;
+        }
+      };
+
+      case MP_QSTR_map_width: {
+        if(action == GET) {
+          dest[0] = mp_obj_new_int(self->map_width);
+          return;
+        }
+      };
+    }
+
+    // we didn't handle this, fall back to alternative methods
+    dest[1] = MP_OBJ_SENTINEL;
+  })
+
+  static void tilemap_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
+    self(self_in, tilemap_obj_t);
+    mp_printf(print, "tilemap(tile %d x %d)", self->tilemap->tile_w, self->tilemap->tile_h);
+  }
+
+  MPY_BIND_LOCALS_DICT(tilemap,
+    MPY_BIND_ROM_PTR_DEL(tilemap),
+    MPY_BIND_ROM_PTR(draw),
+    MPY_BIND_ROM_PTR(invalidate),
+  )
+
+  MP_DEFINE_CONST_OBJ_TYPE(
+      type_tilemap,
+      MP_QSTR_tilemap,
+      MP_TYPE_FLAG_NONE,
+      make_new, (const void *)tilemap_new,
+      print, (const void *)tilemap_print,
+      attr, (const void *)tilemap_attr,
+      locals_dict, &tilemap_locals_dict
+  );
+
+}
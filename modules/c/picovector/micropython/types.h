@@ -11,4 +11,10 @@ extern const mp_obj_type_t type_shape;
 extern const mp_obj_type_t type_rect;
 extern const mp_obj_type_t type_vec2;
 extern const mp_obj_type_t type_algorithm;
+extern const mp_obj_type_t type_tilemap;
+extern const mp_obj_type_t type_sprite_batch;
+extern const mp_obj_type_t type_particles;
+extern const mp_obj_type_t type_collision_mask;
+extern const mp_obj_type_t type_collision_grid;
+extern const mp_obj_type_t type_text_layout;
 extern const mp_obj_module_t mod_input;
@@ -0,0 +1,224 @@
+#include "particles.hpp"
+#include "blit.hpp"
+
+namespace picovector {
+
+  // age at which a particle dies, one in 16:16
+  static constexpr uint32_t PARTICLE_END = 0x10000;
+
+  // particles that stray further than this many pixels are dropped before
+  // their position can overflow
+  static constexpr int32_t PARTICLE_LIMIT = 0x4000 << 16;
+
+  // the shortest life a particle can have, about 4ms
+  static constexpr fx16_t PARTICLE_MIN_LIFE = 0x100;
+
+  static constexpr int PARTICLE_MAX_RADIUS = 32;
+
+  static inline fx16_t to_fx16(float v) {
+    return fx16_t(v * 65536.0f);
+  }
+
+  static inline bool out_of_range(fx16_t v) {
+    return v < -PARTICLE_LIMIT || v > PARTICLE_LIMIT;
+  }
+
+  particle_system_t::particle_system_t(int capacity) : _capacity(std::max(capacity, 0)) {
+    _pool.resize(_capacity * 6);
+    int32_t *p = _pool.data();
+    _x = p;
+    _y = p + _capacity;
+    _vx = p + _capacity * 2;
+    _vy = p + _capacity * 3;
+    _age = (uint32_t *)(p + _capacity * 4);
+    _rate = (uint32_t *)(p + _capacity * 5);
+    set_ramp(nullptr, 0);
+  }
+
+  // a random value between -spread and +spread (xorshift32)
+  int32_t particle_system_t::jitter(fx16_t spread) {
+    _seed ^= _seed << 13;
+    _seed ^= _seed >> 17;
+    _seed ^= _seed << 5;
+    int32_t r = int32_t(_seed >> 16) - 0x8000;
+    return int32_t((int64_t(spread) * r) >> 15);
+  }
+
+  void particle_system_t::set_ramp(const uint32_t *colors, int n) {
+    for(int i = 0; i < PARTICLE_RAMP_SIZE; i++) {
+      if(n <= 0) {
+        _ramp[i] = 0xffffffff;
+        continue;
+      }
+
+      // position along the list of colours in 8.8 fixed point
+      int t = (i * (n - 1) * 256) / (PARTICLE_RAMP_SIZE - 1);
+      int j = t >> 8;
+      _ramp[i] = j >= n - 1 ? colors[n - 1] : _lerp_rgba8888(colors[j], colors[j + 1], t & 0xff);
+    }
+  }
+
+  int particle_system_t::emit(int n, vec2_t p, vec2_t v, float spread, float life, float life_spread) {
+    n = std::clamp(n, 0, _capacity - count);
+
+    fx16_t px = to_fx16(p.x);
+    fx16_t py = to_fx16(p.y);
+    fx16_t vx = to_fx16(v.x);
+    fx16_t vy = to_fx16(v.y);
+    fx16_t s = to_fx16(fabsf(spread));
+    fx16_t l = to_fx16(life);
+    fx16_t ls = to_fx16(fabsf(life_spread));
+
+    for(int k = 0; k < n; k++) {
+      int i = count++;
+      _x[i] = px;
+      _y[i] = py;
+      _vx[i] = s ? vx + jitter(s) : vx;
+      _vy[i] = s ? vy + jitter(s) : vy;
+      _age[i] = 0;
+
+      // fraction of a life that passes each second, the only division a
+      // particle ever needs
+      fx16_t span = std::max(ls ? l + jitter(ls) : l, PARTICLE_MIN_LIFE);
+      _rate[i] = uint32_t((uint64_t(1) << 32) / uint32_t(span));
+    }
+
+    return n;
+  }
+
+  void particle_system_t::update(float dt) {
+    fx16_t step = to_fx16(std::max(dt, 0.0f));
+    fx16_t gx = to_fx16(gravity.x * dt);
+    fx16_t gy = to_fx16(gravity.y * dt);
+
+    int i = 0;
+    while(i < count) {
+      uint64_t age = _age[i] + ((uint64_t(_rate[i]) * uint32_t(step)) >> 16);
+      fx16_t vx = _vx[i] + gx;
+      fx16_t vy = _vy[i] + gy;
+      fx16_t x = _x[i] + fx16_t((int64_t(vx) * step) >> 16);
+      fx16_t y = _y[i] + fx16_t((int64_t(vy) * step) >> 16);
+
+      if(age >= PARTICLE_END || out_of_range(x) || out_of_range(y)) {
+        // move the last live particle into this slot and look at it next
+        int last = --count;
+        _x[i] = _x[last];
+        _y[i] = _y[last];
+        _vx[i] = _vx[last];
+        _vy[i] = _vy[last];
+        _age[i] = _age[last];
+        _rate[i] = _rate[last];
+        continue;
+      }
+
+      _age[i] = uint32_t(age);
+      _vx[i] = vx;
+      _vy[i] = vy;
+      _x[i] = x;
+      _y[i] = y;
+      i++;
+    }
+  }
+
+  void particle_system_t::draw(image_t *target, int radius) {
+    rect_t clip = target->clip().intersection(target->bounds());
+    int cx0 = ceilf(clip.x);
+    int cy0 = ceilf(clip.y);
+    int cx1 = floorf(clip.x + clip.w);
+    int cy1 = floorf(clip.y + clip.h);
+    if(count == 0 || cx0 >= cx1 || cy0 >= cy1) {
+      return;
+    }
+
+    // half width of each row of the disc
+    radius = std::clamp(radius, 0, PARTICLE_MAX_RADIUS);
+    int8_t half[PARTICLE_MAX_RADIUS * 2 + 1];
+    for(int dy = -radius; dy <= radius; dy++) {
+      half[dy + radius] = int8_t(sqrtf(float(radius * radius - dy * dy)) + 0.5f);
+    }
+
+    target->mark_dirty();
+
+    blend_func_t bf = target->_blend_func;
+    blit_dispatch_target(target, fetch_rgba8888_t(), 255, [&](const auto &, uint32_t, auto *dst_type) {
+      typedef typename std::remove_pointer<decltype(dst_type)>::type T;
+
+      for(int i = 0; i < count; i++) {
+        int px = _x[i] >> 16;
+        int py = _y[i] >> 16;
+        uint32_t c = color(i);
+        if(_a(c) == 0) {
+          continue;
+        }
+
+        if(radius == 0) {
+          if(px >= cx0 && px < cx1 && py >= cy0 && py < cy1) {
+            _blend_pixel((T *)target->ptr(px, py), bf, _r(c), _g(c), _b(c), _a(c));
+          }
+          continue;
+        }
+
+        int y0 = std::max(py - radius, cy0);
+        int y1 = std::min(py + radius + 1, cy1);
+        for(int y = y0; y < y1; y++) {
+          int h = half[y - py + radius];
+          int x0 = std::max(px - h, cx0);
+          int x1 = std::min(px + h + 1, cx1);
+          if(x0 >= x1) {
+            continue;
+          }
+
+          T *pd = (T *)target->ptr(x0, y);
+          for(int x = x0; x < x1; x++) {
+            _blend_pixel(pd++, bf, _r(c), _g(c), _b(c), _a(c));
+          }
+        }
+      }
+    });
+  }
+
+  void particle_system_t::draw(image_t *target, image_t *sprite) {
+    rect_t clip = target->clip().intersection(target->bounds());
+    int cx0 = ceilf(clip.x);
+    int cy0 = ceilf(clip.y);
+    int cx1 = floorf(clip.x + clip.w);
+    int cy1 = floorf(clip.y + clip.h);
+    int sw = sprite->bounds().w;
+    int sh = sprite->bounds().h;
+    if(count == 0 || cx0 >= cx1 || cy0 >= cy1 || sw <= 0 || sh <= 0) {
+      return;
+    }
+
+    target->mark_dirty();
+
+    opacity_t sprite_opacity = sprite->alpha() == 255 ? sprite->opacity() : OPACITY_GENERAL;
+    blend_func_t bf = target->_blend_func;
+
+    blit_dispatch(sprite, target, [&](const auto &fetch, uint32_t alpha, auto *dst_type) {
+      typedef typename std::remove_pointer<decltype(dst_type)>::type T;
+
+      for(int i = 0; i < count; i++) {
+        uint32_t a = (alpha * _a(color(i)) + 127) / 255;
+        if(a == 0) {
+          continue;
+        }
+
+        int sx = (_x[i] >> 16) - sw / 2;
+        int sy = (_y[i] >> 16) - sh / 2;
+        int x0 = std::max(sx, cx0);
+        int x1 = std::min(sx + sw, cx1);
+        int y0 = std::max(sy, cy0);
+        int y1 = std::min(sy + sh, cy1);
+        if(x0 >= x1 || y0 >= y1) {
+          continue;
+        }
+
+        opacity_t opacity = a == 255 ? sprite_opacity : OPACITY_GENERAL;
+        for(int y = y0; y < y1; y++) {
+          span_blit<T>(fetch, a, opacity, sprite, target, bf, x0 - sx, y - sy, x0, y, x1 - x0);
+        }
+      }
+    });
+  }
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "image.hpp"
+
+namespace picovector {
+
+  // entries in the colour ramp, sampled by how far through its life each
+  // particle is
+  static constexpr int PARTICLE_RAMP_SIZE = 64;
+
+  /*
+    a fixed size pool of particles that are integrated and drawn natively.
+
+    the pool is a structure of arrays in one allocation: position, velocity,
+    age and ageing rate per particle, all in 16:16 fixed point. age runs from
+    zero to one over a particle's life so the ramp index and the end of life
+    test need no division. dead particles are swapped with the last live one
+    so the live particles always fill the front of each array.
+  */
+  class particle_system_t {
+    public:
+      int count = 0;
+      vec2_t gravity = vec2_t(0.0f, 0.0f);  // pixels per second per second
+
+      particle_system_t(int capacity);
+
+      int capacity() { return _capacity; }
+
+      // spawns up to `n` particles at `p` moving at `v` pixels per second plus
+      // up to +/- `spread` on each axis, living `life` +/- `life_spread`
+      // seconds. returns how many fitted in the pool
+      int emit(int n, vec2_t p, vec2_t v, float spread, float life, float life_spread);
+      void update(float dt);
+      void clear() { count = 0; }
+
+      // the colour (and alpha) of a particle runs through `colors` over its
+      // life, an empty ramp is white throughout
+      void set_ramp(const uint32_t *colors, int n);
+
+      // draws each particle as a single pixel (radius 0) or a disc
+      void draw(image_t *target, int radius);
+      // draws `sprite` centred on each particle, faded by the ramp's alpha
+      void draw(image_t *target, image_t *sprite);
+
+    private:
+      int _capacity;
+      std::vector<int32_t, PV_STD_ALLOCATOR<int32_t>> _pool;
+      fx16_t *_x, *_y, *_vx, *_vy;
+      uint32_t *_age, *_rate;
+      uint32_t _ramp[PARTICLE_RAMP_SIZE];
+      uint32_t _seed = 0x2545f491;
+
+      int32_t jitter(fx16_t spread);
+      uint32_t color(int i) { return _ramp[_age[i] >> 10]; }
+  };
+
+}
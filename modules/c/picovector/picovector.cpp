@@ -282,14 +282,15 @@ namespace picovector {
   void build_glyph_nodes(glyph_path_t *path, rect_t *tb, mat3_t *transform, uint aa) {
     vec2_t offset = tb->tl();
     // start with the last point to close the loop, transform it, scale for antialiasing, and offset to tile origin
-    glyph_path_point_t *p = &path->points[path->point_count - 1];
+    glyph_path_point_t *points = path->points();
+    glyph_path_point_t *p = &points[path->point_count - 1];
     vec2_t last = vec2_t(p->x, p->y);
     if(transform) last = last.transform(transform);
     last *= (1 << aa);
     last -= offset;
 
     for(int i = 0; i < path->point_count; i++) {
-      p = &path->points[i];
+      p = &points[i];
       vec2_t next = vec2_t(p->x, p->y);
       if(transform) next = next.transform(transform);
       next *= (1 << aa);
@@ -301,27 +302,17 @@ namespace picovector {
     }
   }
 
-  void render_glyph(glyph_t *glyph, image_t *target, mat3_t *transform, brush_t *brush) {
-
-    if(!glyph->path_count) return;
-
-    // antialias level of target image
-    uint aa = (uint)target->antialias();
-
-
+  // rasterises a glyph a tile at a time within `clip`, calling
+  // `emit(x, y, w, mask)` with each row of coverage
+  template<typename F>
+  static void rasterise_glyph(glyph_t *glyph, rect_t clip, mat3_t *transform, uint aa, F emit) {
     uint8_t *p_alpha_map = alpha_map_none;
     if(aa == 1) p_alpha_map = alpha_map_x4;
     if(aa == 2) p_alpha_map = alpha_map_x16;
 
-    //printf("render shape\n");
-
     // determine bounds of shape to be rendered
     rect_t sb = glyph->bounds(transform).round();
 
-    rect_t clip = target->clip();
-
-    masked_span_func_t fn = target->_masked_span_func;
-
     //printf("- shape bounds %d, %d (%d x %d)\n", sbx, sby, sbw, sbh);
     //printf("- clip bounds %d, %d (%d x %d)\n", int(clip.x), int(clip.y), int(clip.w), int(clip.h));
 
@@ -361,7 +352,7 @@ namespace picovector {
 
         // build the nodes for each path
         for(int i = 0; i < glyph->path_count; i++) {
-          glyph_path_t *p = &glyph->paths[i];
+          glyph_path_t *p = &glyph->paths()[i];
           build_glyph_nodes(p, &tb, transform, aa);
         }
 
@@ -387,9 +378,35 @@ namespace picovector {
 
           // render tile span
           p = &tile_buffer[ty * TILE_WIDTH + rbx];
-          fn(target, brush, sx + rbx, sy + ty, rbw, p);
+          emit(sx + rbx, sy + ty, rbw, p);
         }
       }
     }
   }
+
+  void render_glyph(glyph_t *glyph, image_t *target, mat3_t *transform, brush_t *brush) {
+    if(!glyph->path_count) return;
+
+    masked_span_func_t fn = target->_masked_span_func;
+    rasterise_glyph(glyph, target->clip(), transform, (uint)target->antialias(), [&](int x, int y, int w, uint8_t *mask) {
+      fn(target, brush, x, y, w, mask);
+    });
+  }
+
+  void render_glyph_mask(glyph_t *glyph, mat3_t *transform, uint aa, const rect_t &bounds, uint8_t *mask) {
+    int bx = bounds.x;
+    int by = bounds.y;
+    int bw = bounds.w;
+    int bh = bounds.h;
+    memset(mask, 0, bw * bh);
+    if(!glyph->path_count) return;
+
+    rasterise_glyph(glyph, bounds, transform, aa, [&](int x, int y, int w, uint8_t *row) {
+      // keep to the mask
+      int x0 = max(x, bx);
+      int x1 = min(x + w, bx + bw);
+      if(y < by || y >= by + bh || x0 >= x1) return;
+      memcpy(mask + (y - by) * bw + (x0 - bx), row + (x0 - x), x1 - x0);
+    });
+  }
 }
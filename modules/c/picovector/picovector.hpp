@@ -26,6 +26,25 @@
 #define PV_REALLOC realloc
 #endif
 
+// bytes set aside for rasterised vector font glyphs, zero disables the cache
+#ifndef PV_GLYPH_CACHE_SIZE
+#define PV_GLYPH_CACHE_SIZE 8192
+#endif
+
+#ifndef PV_GLYPH_CACHE_ENTRIES
+#define PV_GLYPH_CACHE_ENTRIES 128
+#endif
+
+// columns raycast() casts and draws at a time, sizes its stack buffers
+#ifndef PV_RAYCAST_STRIP
+#define PV_RAYCAST_STRIP 80
+#endif
+
+// glyphs whose measurements are cached, a power of two or zero to disable
+#ifndef PV_TEXT_METRICS_ENTRIES
+#define PV_TEXT_METRICS_ENTRIES 128
+#endif
+
 // TODO: bring back AA support
 const size_t working_buffer_size = (50 + 20) * 1024;
 extern char __attribute__((aligned(4))) PicoVector_working_buffer[working_buffer_size];
@@ -40,6 +59,7 @@ namespace picovector {
   class shape_t;
   class glyph_t;
   class mat3_t;
+  struct rect_t;
 
   struct _rspan {
     int x; // span start x
@@ -53,5 +73,8 @@ namespace picovector {
 
   void render(shape_t *shape, image_t *target, mat3_t *transform, brush_t *brush);
   void render_glyph(glyph_t *shape, image_t *target, mat3_t *transform, brush_t *brush);
+  // rasterises a glyph's coverage into `mask`, an A8 buffer `bounds.w` wide
+  // covering the pixels in `bounds`
+  void render_glyph_mask(glyph_t *glyph, mat3_t *transform, uint aa, const rect_t &bounds, uint8_t *mask);
 
 }
\ No newline at end of file
@@ -1,4 +1,6 @@
 #include <algorithm>
+#include <limits.h>
+#include <string.h>
 
 #include "pixel_font.hpp"
 #include "image.hpp"
@@ -11,7 +13,109 @@ using std::max;
 
 namespace picovector {
 
+  // true if an RLE glyph's `bytes` of runs hold exactly the rows it says it
+  // has, each ending in a zero byte, and every run is within `width`
+  static bool glyph_rle_valid(const uint8_t *p, uint32_t bytes, int width, int height) {
+    if(bytes < 2 || p[0] + p[1] > height) {
+      return false;
+    }
+
+    const uint8_t *end = p + bytes;
+    int rows = p[1];
+    p += 2;
+    for(int r = 0; r < rows; r++) {
+      int x = 0;
+      while(true) {
+        if(p == end) {
+          return false;
+        }
+        uint8_t b = *p++;
+        if(!b) {
+          break;
+        }
+        x += (b >> 4) + (b & 0xf);
+        if(x > width) {
+          return false;
+        }
+      }
+    }
+    return p == end;
+  }
+
+  bool pixel_font_t::map(const uint8_t *data, size_t size) {
+    if(size < sizeof(ppf2_header_t) || (uintptr_t(data) & 3)) {
+      return false;
+    }
+
+    const ppf2_header_t *header = (const ppf2_header_t *)data;
+    if(memcmp(header->marker, "ppf2", 4) != 0) {
+      return false;
+    }
+
+    uint32_t count = header->glyph_count;
+    uint64_t table_size = uint64_t(count) * sizeof(pixel_font_glyph_t);
+    const uint8_t *tables = data + sizeof(ppf2_header_t) + table_size;
+
+    if(header->flags & PPF_FLAG_RLE) {
+      uint64_t offsets_size = (uint64_t(count) + 1) * sizeof(uint32_t);
+      if(sizeof(ppf2_header_t) + table_size + offsets_size > size) {
+        return false;
+      }
+
+      // each glyph's runs must lie within the run data and decode to its
+      // rows without reading past them
+      const uint32_t *offsets = (const uint32_t *)tables;
+      const uint8_t *runs = tables + offsets_size;
+      if(sizeof(ppf2_header_t) + table_size + offsets_size + offsets[count] > size) {
+        return false;
+      }
+      const pixel_font_glyph_t *glyphs = (const pixel_font_glyph_t *)(data + sizeof(ppf2_header_t));
+      for(uint32_t i = 0; i < count; i++) {
+        if(offsets[i] > offsets[i + 1] ||
+           !glyph_rle_valid(runs + offsets[i], offsets[i + 1] - offsets[i], glyphs[i].width, header->height)) {
+          return false;
+        }
+      }
+
+      this->glyph_data_size = 0;
+      this->glyph_data = runs;
+      this->glyph_offsets = offsets;
+    } else {
+      uint32_t bytes_per_row = (header->width + 7) >> 3;
+      uint64_t data_size = uint64_t(bytes_per_row) * header->height;
+      if(sizeof(ppf2_header_t) + table_size + data_size * count > size) {
+        return false;
+      }
+
+      this->glyph_data_size = data_size;
+      this->glyph_data = tables;
+      this->glyph_offsets = nullptr;
+    }
+
+    this->glyph_count = count;
+    this->width = header->width;
+    this->height = header->height;
+    memcpy(this->name, header->name, sizeof(this->name));
+    this->name[sizeof(this->name) - 1] = '\0';
+    this->glyphs = (const pixel_font_glyph_t *)(data + sizeof(ppf2_header_t));
+    build_index();
+    return true;
+  }
+
+  void pixel_font_t::build_index() {
+    std::fill(ascii, ascii + 128, 0);
+    for(uint32_t i = 0; i < glyph_count && i < 0xffff; i++) {
+      uint32_t codepoint = glyphs[i].codepoint;
+      if(codepoint < 128 && !ascii[codepoint]) {
+        ascii[codepoint] = i + 1;
+      }
+    }
+  }
+
   int pixel_font_t::glyph_index(int codepoint) {
+    if(codepoint >= 0 && codepoint < 128) {
+      return int(ascii[codepoint]) - 1;
+    }
 
     uint32_t low = 0;
     uint32_t high = this->glyph_count;
@@ -33,38 +137,76 @@ namespace picovector {
     return -1;  // not found
   }
 
-  rect_t pixel_font_t::measure(image_t *target, const char *text) {
-    rect_t tb = target->clip();
-    rect_t b(tb.x + tb.w, tb.y + tb.h, 0, this->height);
+  // calls `emit(x, w)` for each run of set pixels in a glyph row that falls
+  // within columns [x0, x1). rows are packed most significant bit first, so
+  // a 32 bit window is loaded at a time and the runs are found by counting
+  // leading zeros and ones rather than testing every bit
+  template<typename F>
+  static void glyph_row_runs(const uint8_t *row, int bytes, int x0, int x1, F emit) {
+    int start = 0, end = 0;  // run carried over from the previous window
 
-    vec2_t caret(0, 0);
-    while(*text != '\0') {
-      // special case for "space"
-      if(*text == 32) {
-        caret.x += this->width / 3;
-        text++;
-        continue;
+    for(int i = x0 >> 5; i << 5 < x1; i++) {
+      uint32_t bits = 0;
+      for(int b = 0; b < 4; b++) {
+        int j = (i << 2) + b;
+        bits = (bits << 8) | (j < bytes ? row[j] : 0);
       }
 
-      int glyph_index = this->glyph_index(*text);
-      if(glyph_index != -1) {
-        pixel_font_glyph_t *glyph = &this->glyphs[glyph_index];
-        caret.x += glyph->width + 1;
+      int pos = i << 5;
+      while(bits) {
+        int zeros = __builtin_clz(bits);
+        bits <<= zeros;
+        pos += zeros;
+        int ones = ~bits ? __builtin_clz(~bits) : 32;
+        bits = ones < 32 ? bits << ones : 0;
 
-        b.x = min(caret.x, b.x);
-        b.w = max(caret.x, b.w);
+        if(pos != end) {
+          if(end > start) emit(start, end - start);
+          start = pos;
+        }
+        pos += ones;
+        end = pos;
       }
-      text++;
     }
-    return b;
+    if(end > start) emit(start, end - start);
+  }
+
+  // calls `emit(x, w)` for each run in a row of an RLE glyph and leaves `p`
+  // at the start of the next row. runs split by the encoding are joined
+  // back together
+  template<typename F>
+  static void glyph_rle_row_runs(const uint8_t *&p, F emit) {
+    int x = 0, start = 0, end = 0;
+    while(uint8_t b = *p++) {
+      x += b >> 4;
+      int w = b & 0xf;
+      if(!w) {
+        continue;
+      }
+
+      if(x != end) {
+        if(end > start) emit(start, end - start);
+        start = x;
+      }
+      x += w;
+      end = x;
+    }
+    if(end > start) emit(start, end - start);
+  }
+
+  template<typename T>
+  static void store_span(image_t *target, int x, int y, int w, uint32_t c) {
+    T v;
+    _store_pixel(&v, c);
+    std::fill_n((T *)target->ptr(x, y), w, v);
   }
 
-  void pixel_font_t::draw_glyph(image_t *target, const pixel_font_glyph_t *glyph, uint8_t *data, brush_t *brush, const rect_t &bounds, int x, int y) {
+  void pixel_font_t::draw_glyph(image_t *target, const pixel_font_glyph_t *glyph, const uint8_t *data, brush_t *brush, const rect_t &bounds, int x, int y) {
     // calculate the number of bytes per glyph pixel data row
     uint32_t bytes_per_row = (this->width + 7) >> 3;
 
     // clip the x and y ranges to within bounds
-    int yoff = 0;//max(0, int(bounds.y - y));
+    int yoff = 0;
     if(y < bounds.y) {
       yoff = bounds.y - y;
     }
@@ -76,45 +218,138 @@ namespace picovector {
     int xf = x + xoff;
     int xc = glyph->width - xoff;
     xc = min(xc, int(bounds.x + bounds.w - xf));
+    if(xc <= 0 || yc <= 0) {
+      return;
+    }
 
-    //uint32_t *dst = (uint32_t *)target->ptr(0, yf);
-    uint32_t row_stride = target->row_stride() / 4;
-
+    // solid colors are written straight into the target, one fill per run,
+    // anything else is drawn with a span call per run
     span_func_t fn = target->_span_func;
+    void (*store)(image_t *, int, int, int, uint32_t) = nullptr;
+    uint32_t c;
+    if(brush->solid_color(&c) && target->alpha() == 255 && !target->has_palette()) {
+      switch(target->pixel_format()) {
+        case RGBA8888: store = store_span<uint32_t>; break;
+        case RGB565:   store = store_span<uint16_t>; break;
+        case A8:       store = store_span<uint8_t>;  break;
+        default: break;
+      }
+    }
 
-    data += yoff * bytes_per_row;
-    for(int yo = yf; yo < yf + yc; yo++) {
-      for(int xo = xf; xo < xf + xc; xo++) {
-        int bit = xo - x;
-        uint8_t b = data[bit >> 3];
-        if(b & (0b1 << (7 - (bit & 0b111)))) {
-          //brush->pixel(&dst[xo]);
-          //brush->render_span(target, xo, yo, 1);
-          fn(target, brush, xo, yo, 1);
+    // clip the runs to the visible columns
+    int x0 = xoff, x1 = xoff + xc;
+    auto run = [&](int yo, int rx, int rw) {
+      int r0 = max(rx, x0);
+      int r1 = min(rx + rw, x1);
+      if(r0 >= r1) return;
+      if(store) {
+        store(target, x + r0, yo, r1 - r0, c);
+      } else {
+        fn(target, brush, x + r0, yo, r1 - r0);
+      }
+    };
+
+    if(glyph_offsets) {
+      // RLE glyphs are drawn straight from their runs, rows above the clip
+      // are skipped over and empty rows above and below aren't stored
+      int top = data[0], rows = data[1];
+      const uint8_t *p = data + 2;
+      for(int r = top; r < top + rows && r < yoff + yc; r++) {
+        if(r < yoff) {
+          while(*p++);
+          continue;
         }
+        int yo = y + r;
+        glyph_rle_row_runs(p, [&](int rx, int rw) { run(yo, rx, rw); });
       }
+      return;
+    }
 
-      //dst += row_stride;
+    data += yoff * bytes_per_row;
+    for(int yo = yf; yo < yf + yc; yo++) {
+      glyph_row_runs(data, bytes_per_row, x0, x1, [&](int rx, int rw) { run(yo, rx, rw); });
       data += bytes_per_row;
     }
   }
 
+  glyph_metrics_t pixel_font_t::glyph_metrics(int codepoint) {
+    glyph_metrics_t m = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+
+    // special case for "space"
+    if(codepoint == 32) {
+      m.advance = this->width / 3;
+      return m;
+    }
+
+    int glyph_index = this->glyph_index(codepoint);
+    if(glyph_index == -1) {
+      return m;
+    }
+
+    // the extent of the glyph's set pixels, clipped to its width as it's
+    // drawn
+    const pixel_font_glyph_t *glyph = &this->glyphs[glyph_index];
+    const uint8_t *data = glyph_pixels(glyph_index);
+    int x0 = INT_MAX, y0 = INT_MAX, x1 = INT_MIN, y1 = INT_MIN;
+    auto run = [&](int row, int rx, int rw) {
+      int r0 = rx, r1 = min(rx + rw, int(glyph->width));
+      if(r0 >= r1) return;
+      x0 = min(x0, r0);
+      x1 = max(x1, r1);
+      y0 = min(y0, row);
+      y1 = max(y1, row + 1);
+    };
+
+    if(glyph_offsets) {
+      int top = data[0], rows = data[1];
+      const uint8_t *p = data + 2;
+      for(int r = top; r < top + rows; r++) {
+        glyph_rle_row_runs(p, [&](int rx, int rw) { run(r, rx, rw); });
+      }
+    } else {
+      uint32_t bytes_per_row = (this->width + 7) >> 3;
+      for(int r = 0; r < this->height; r++, data += bytes_per_row) {
+        glyph_row_runs(data, bytes_per_row, 0, glyph->width, [&](int rx, int rw) { run(r, rx, rw); });
+      }
+    }
+
+    m.advance = glyph->width + 1;
+    if(x1 > x0) {
+      m.x0 = x0;
+      m.y0 = y0;
+      m.x1 = x1;
+      m.y1 = y1;
+    }
+    return m;
+  }
+
+  text_metrics_t pixel_font_t::measure(const char *text) {
+    text_metrics_builder_t metrics(this->height);
+
+    while(*text != '\0') {
+      int codepoint = *text++;
+      metrics.add(text_metrics_get(this, codepoint, 0, [&]() { return glyph_metrics(codepoint); }));
+    }
+
+    return metrics.result();
+  }
+
   void pixel_font_t::draw(image_t *target, const char *text, int x, int y) {
-    // check if text is within clipping area
-    rect_t text_bounds = this->measure(target, text);
-    text_bounds.x = x;
-    text_bounds.y = y;
+    rect_t bounds = target->clip();
 
-    // text isn't within the target bounds at all, escape early
-    if(!text_bounds.intersects(target->clip())) {
+    // text is entirely above or below the clipping area, escape early
+    if(y >= bounds.y + bounds.h || y + this->height <= bounds.y) {
       return;
     }
 
-    rect_t bounds = target->clip();
+    target->mark_dirty();
 
     brush_t *brush = target->brush();
+    int right = bounds.x + bounds.w;
 
-    while(*text != '\0') {
+    // glyphs are clipped one at a time as they're laid out, nothing past the
+    // right edge of the clipping area can be seen
+    while(*text != '\0' && x < right) {
       // special case for "space"
       if(*text == 32) {
         x += this->width / 3;
@@ -124,17 +359,32 @@ namespace picovector {
 
       int glyph_index = this->glyph_index(*text);
       if(glyph_index != -1) {
-        pixel_font_glyph_t *glyph = &this->glyphs[glyph_index];
-        uint8_t *data = &this->glyph_data[this->glyph_data_size * glyph_index];
+        const pixel_font_glyph_t *glyph = &this->glyphs[glyph_index];
 
-        draw_glyph(target, glyph, data, brush, bounds, x, y);
+        if(x + glyph->width > bounds.x) {
+          draw_glyph(target, glyph, glyph_pixels(glyph_index), brush, bounds, x, y);
+        }
 
         x += glyph->width + 1;
       }
 
       text++;
     }
+  }
+
+  rect_t pixel_font_t::render_bounds(const char *text) {
+    return measure(text).pixel_bounds();
+  }
+
+  void pixel_font_t::render(image_t *mask, const char *text, const rect_t &bounds) {
+    memset(mask->ptr(0, 0), 0, mask->buffer_size());
 
+    brush_t *pen = mask->brush();
+    rgb_color_t white(255, 255, 255, 255);
+    color_brush_t brush(white);
+    mask->brush(&brush);
+    draw(mask, text, -bounds.x, -bounds.y);
+    mask->brush(pen);
   }
 
-}
\ No newline at end of file
+}
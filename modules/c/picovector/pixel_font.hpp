@@ -8,6 +8,7 @@
 #include "shape.hpp"
 #include "types.hpp"
 #include "mat3.hpp"
+#include "text_metrics.hpp"
 
 using std::vector;
 using std::pair;
@@ -20,8 +21,41 @@ namespace picovector {
   struct pixel_font_glyph_t {
     uint32_t codepoint;
     uint16_t width;
+    uint16_t reserved;
   };
 
+  /*
+    version 2 PPF, laid out so a font can be used straight from flash or a
+    memory mapped file. everything is little endian and the tables are
+    aligned to their types: the header is followed by `glyph_count`
+    pixel_font_glyph_t and then the glyph bitmaps. version 1 files ("ppf!")
+    are big endian with packed 6 byte glyph entries and have to be loaded
+    into this layout first.
+
+    fonts flagged PPF_FLAG_RLE store runs instead of bitmaps, which is far
+    smaller for large, sparse glyphs. the glyph table is followed by
+    `glyph_count + 1` uint32_t offsets into the run data, glyph i's runs
+    being offsets[i] to offsets[i + 1]. a glyph starts with its first
+    non-empty row and its number of rows, a byte each, then each row is a
+    byte per run of (gap << 4 | length), the gap counted from the end of
+    the previous run, ending with a zero byte. longer gaps and runs are
+    split, a run with no length only moves along
+  */
+  struct ppf2_header_t {
+    char marker[4];         // "ppf2"
+    uint16_t flags;
+    uint16_t width;
+    uint16_t height;
+    uint16_t reserved;
+    uint32_t glyph_count;
+    char name[32];
+  };
+
+  static constexpr uint16_t PPF_FLAG_RLE = 0b1;
+
+  static_assert(sizeof(pixel_font_glyph_t) == 8, "PPF glyph entries are 8 bytes");
+  static_assert(sizeof(ppf2_header_t) == 48, "PPF v2 header is 48 bytes");
+
   class pixel_font_t {
   public:
     uint32_t glyph_count;
@@ -30,14 +64,36 @@ namespace picovector {
     uint16_t height;
     char name[32];
 
-    pixel_font_glyph_t *glyphs;
-    uint8_t *glyph_data;
+    const pixel_font_glyph_t *glyphs;
+    const uint8_t *glyph_data;
+    const uint32_t *glyph_offsets = nullptr;  // into glyph_data for RLE fonts, null for bitmaps
 
+    // glyph index + 1 of each ASCII codepoint, zero if the font lacks it
+    uint16_t ascii[128];
+
+    // uses a version 2 font in place, `data` must stay valid for the life
+    // of the font and be 4 byte aligned. returns false if it isn't a valid
+    // version 2 font
+    bool map(const uint8_t *data, size_t size);
+    // fills the ASCII table, call once the glyphs are loaded
+    void build_index();
     int glyph_index(int codepoint);
+    // the bitmap or runs of a glyph, as draw_glyph() takes them
+    const uint8_t *glyph_pixels(int index) {
+      return glyph_offsets ? glyph_data + glyph_offsets[index] : glyph_data + glyph_data_size * index;
+    }
 
     void draw(image_t *target, const char *text, int x, int y);
-    void draw_glyph(image_t *target, const pixel_font_glyph_t *glyph, uint8_t *data, brush_t *brush, const rect_t &bounds, int x, int y);
-    rect_t measure(image_t *target, const char *text);
+    void draw_glyph(image_t *target, const pixel_font_glyph_t *glyph, const uint8_t *data, brush_t *brush, const rect_t &bounds, int x, int y);
+    // the advance and ink boxes of `text`, as draw() would place it with the
+    // pen at the origin. the advance is the font's height tall
+    text_metrics_t measure(const char *text);
+    // one character's metrics, uncached
+    glyph_metrics_t glyph_metrics(int codepoint);
+
+    // draws `text` once into an A8 image as coverage, see font_t::render()
+    rect_t render_bounds(const char *text);
+    void render(image_t *mask, const char *text, const rect_t &bounds);
   };
 
 }
\ No newline at end of file
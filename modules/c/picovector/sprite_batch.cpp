@@ -0,0 +1,95 @@
+#include "sprite_batch.hpp"
+#include "blit.hpp"
+
+namespace picovector {
+
+  sprite_batch_t::sprite_batch_t(image_t *sheet, int sprite_w, int sprite_h, int capacity)
+    : sheet(sheet), sprite_w(sprite_w), sprite_h(sprite_h) {
+    // entry indices have to fit in the bottom half of an _order key
+    capacity = std::clamp(capacity, 0, 0xffff);
+    _entries.resize(capacity);
+    _order.resize(capacity);
+  }
+
+  bool sprite_batch_t::add(int index, int x, int y, int flags, int alpha) {
+    if(count >= capacity()) {
+      return false;
+    }
+
+    _entries[count++] = {uint16_t(index), int16_t(x), int16_t(y), uint8_t(flags), uint8_t(alpha)};
+    return true;
+  }
+
+  void sprite_batch_t::draw(image_t *target, bool sort) {
+    int n = std::clamp(count, 0, capacity());
+    if(n == 0 || sprite_w <= 0 || sprite_h <= 0) {
+      return;
+    }
+
+    int per_row = sheet->bounds().w / sprite_w;
+    int total = per_row * int(sheet->bounds().h / sprite_h);
+    if(total == 0) {
+      return;
+    }
+
+    rect_t clip = target->clip().intersection(target->bounds());
+    int cx0 = ceilf(clip.x);
+    int cy0 = ceilf(clip.y);
+    int cx1 = floorf(clip.x + clip.w);
+    int cy1 = floorf(clip.y + clip.h);
+    if(cx0 >= cx1 || cy0 >= cy1) {
+      return;
+    }
+
+    const sprite_batch_entry_t *entries = _entries.data();
+    uint32_t *order = _order.data();
+    for(int i = 0; i < n; i++) {
+      order[i] = (uint32_t(entries[i].y + 0x8000) << 16) | i;
+    }
+    if(sort) {
+      std::sort(order, order + n);
+    }
+
+    target->mark_dirty();
+
+    opacity_t sheet_opacity = sheet->alpha() == 255 ? sheet->opacity() : OPACITY_GENERAL;
+    blend_func_t bf = target->_blend_func;
+
+    blit_dispatch(sheet, target, [&](const auto &fetch, uint32_t alpha, auto *dst_type) {
+      typedef typename std::remove_pointer<decltype(dst_type)>::type T;
+
+      for(int i = 0; i < n; i++) {
+        const sprite_batch_entry_t &e = entries[order[i] & 0xffff];
+        if(e.index >= total || e.alpha == 0) {
+          continue;
+        }
+
+        int x0 = std::max(int(e.x), cx0);
+        int x1 = std::min(e.x + sprite_w, cx1);
+        int y0 = std::max(int(e.y), cy0);
+        int y1 = std::min(e.y + sprite_h, cy1);
+        if(x0 >= x1 || y0 >= y1) {
+          continue;
+        }
+
+        int sx = (e.index % per_row) * sprite_w;
+        int sy = (e.index / per_row) * sprite_h;
+        uint32_t a = e.alpha == 255 ? alpha : (alpha * e.alpha + 127) / 255;
+        opacity_t opacity = a == 255 ? sheet_opacity : OPACITY_GENERAL;
+        bool flip_h = e.flags & SPRITE_FLIP_H;
+        bool flip_v = e.flags & SPRITE_FLIP_V;
+
+        for(int dy = y0; dy < y1; dy++) {
+          int row = sy + (flip_v ? e.y + sprite_h - 1 - dy : dy - e.y);
+          if(flip_h) {
+            fx16_t u = (sx + (e.x + sprite_w - 1 - x0)) << 16;
+            span_blit_scale<T>(fetch, a, opacity, sheet, target, bf, u, -0x10000, row << 16, x0, dy, x1 - x0);
+          } else {
+            span_blit<T>(fetch, a, opacity, sheet, target, bf, sx + (x0 - e.x), row, x0, dy, x1 - x0);
+          }
+        }
+      }
+    });
+  }
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "image.hpp"
+
+namespace picovector {
+
+  enum sprite_flip_t {
+    SPRITE_FLIP_H = 1,
+    SPRITE_FLIP_V = 2,
+  };
+
+  // one sprite in a batch, `index` counts sprites left to right, top to
+  // bottom across the sheet
+  struct sprite_batch_entry_t {
+    uint16_t index;
+    int16_t x;
+    int16_t y;
+    uint8_t flags; // sprite_flip_t
+    uint8_t alpha;
+  };
+
+  /*
+    a fixed size list of sprites cut from one sheet, drawn in a single call.
+
+    the sheet's pixel reader, opacity and the target's clip rect are only
+    worked out once per draw rather than per sprite. sprites are drawn in
+    order of their y position (stable, so sprites on the same row keep the
+    order they were added in), which walks the target top to bottom and is
+    the usual back to front order for top down games.
+  */
+  class sprite_batch_t {
+    public:
+      image_t *sheet;
+      int sprite_w;
+      int sprite_h;
+      int count = 0;
+
+      sprite_batch_t(image_t *sheet, int sprite_w, int sprite_h, int capacity);
+
+      int capacity() { return _entries.size(); }
+      sprite_batch_entry_t *entries() { return _entries.data(); }
+
+      bool add(int index, int x, int y, int flags=0, int alpha=255);
+      void clear() { count = 0; }
+      void draw(image_t *target, bool sort=true);
+
+    private:
+      std::vector<sprite_batch_entry_t, PV_STD_ALLOCATOR<sprite_batch_entry_t>> _entries;
+      // draw order, y in the top half and the entry index in the bottom half
+      std::vector<uint32_t, PV_STD_ALLOCATOR<uint32_t>> _order;
+  };
+
+}
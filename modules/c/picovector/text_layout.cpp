@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <string.h>
+
+#include "text_layout.hpp"
+#include "image.hpp"
+#include "brush.hpp"
+#include "color.hpp"
+#include "utf8.hpp"
+
+using std::min;
+using std::max;
+
+namespace picovector {
+
+  static void skip_spaces(const char *&s) {
+    while(*s == ' ') s++;
+  }
+
+  // parses a `[pen:r,g,b]` or `[pen:r,g,b,a]` escape at `p`, moving `p` past
+  // it. anything else is left alone to be drawn as text
+  static bool parse_pen(const char *&p, uint32_t &rgba) {
+    if(strncmp(p, "[pen:", 5) != 0) {
+      return false;
+    }
+
+    const char *s = p + 5;
+    int v[4] = {0, 0, 0, 255};
+    int n = 0;
+    while(n < 4) {
+      skip_spaces(s);
+      if(*s < '0' || *s > '9') {
+        return false;
+      }
+      int c = 0;
+      while(*s >= '0' && *s <= '9') {
+        c = min(c * 10 + (*s - '0'), 255);
+        s++;
+      }
+      v[n++] = c;
+      skip_spaces(s);
+      if(*s != ',') {
+        break;
+      }
+      s++;
+    }
+
+    if(*s != ']' || n < 3) {
+      return false;
+    }
+
+    rgba = v[0] | (v[1] << 8) | (v[2] << 16) | (v[3] << 24);
+    p = s + 1;
+    return true;
+  }
+
+  void text_layout_t::layout(const char *text, font_t *font, pixel_font_t *pixel_font, rect_t bounds, float size,
+                             float line_spacing, float word_spacing, text_align_t align) {
+    glyphs.clear();
+    colors.clear();
+    _font = font;
+    _pixel_font = pixel_font;
+    this->bounds = bounds;
+
+    float scale = 0.0f;
+    float line_height;
+    if(font) {
+      _size_key = font_t::size_key(size);
+      line_height = _size_key / 16.0f;
+      scale = line_height / 128.0f;
+    } else {
+      line_height = pixel_font->height;
+    }
+    float space = line_height / 3.0f * word_spacing;
+    float line_advance = line_height * line_spacing;
+
+    // positions are stored in quarters of a pixel, whole pixels for pixel
+    // fonts which can't be drawn between them
+    auto quarters = [pixel_font](float x) -> int {
+      int q = pixel_font ? int(floorf(x)) * 4 : int(floorf(x * 4.0f));
+      return std::clamp(q, -32768, 32767);
+    };
+
+    // shifts the glyphs of a finished line into alignment
+    size_t line_start = 0;
+    auto end_line = [&](size_t end, float line_width) {
+      width = max(width, line_width);
+      if(align != TEXT_ALIGN_LEFT) {
+        float offset = (bounds.w - line_width) * (align == TEXT_ALIGN_CENTER ? 0.5f : 1.0f);
+        int q = quarters(offset);
+        for(size_t i = line_start; i < end; i++) {
+          glyphs[i].x = std::clamp(glyphs[i].x + q, -32768, 32767);
+        }
+      }
+      line_start = end;
+    };
+
+    width = 0.0f;
+    float x = 0.0f, y = 0.0f;
+    float pending = 0.0f;  // space owed before the next word on the line
+    uint8_t color = 0;
+
+    // switches the colour of the glyphs that follow, up to 255 distinct
+    // colours per layout
+    auto pen = [&](uint32_t rgba) {
+      auto i = std::find(colors.begin(), colors.end(), rgba);
+      if(i != colors.end()) {
+        color = (i - colors.begin()) + 1;
+      } else if(colors.size() < 255) {
+        colors.push_back(rgba);
+        color = colors.size();
+      }
+    };
+
+    const char *p = text;
+    while(*p) {
+      uint32_t rgba;
+      if(*p == '\n') {
+        end_line(glyphs.size(), x);
+        x = 0.0f;
+        pending = 0.0f;
+        y += line_advance;
+        p++;
+        continue;
+      }
+
+      if(*p == ' ') {
+        pending += space;
+        p++;
+        continue;
+      }
+
+      if(*p == '[' && parse_pen(p, rgba)) {
+        pen(rgba);
+        continue;
+      }
+
+      // a word runs up to the next space or newline, escapes included, and
+      // its glyphs are placed relative to its start until it's known which
+      // line it goes on
+      size_t word_start = glyphs.size();
+      float w = 0.0f;
+      while(*p && *p != ' ' && *p != '\n') {
+        if(*p == '[' && parse_pen(p, rgba)) {
+          pen(rgba);
+          continue;
+        }
+
+        int index;
+        float advance;
+        if(font) {
+          glyph_t *glyph = font->glyph(utf8_next(p));
+          if(!glyph) {
+            continue;
+          }
+          index = glyph - font->glyphs;
+          advance = glyph->advance * scale;
+        } else {
+          index = pixel_font->glyph_index(*p++);
+          if(index == -1) {
+            continue;
+          }
+          advance = pixel_font->glyphs[index].width + 1;
+        }
+
+        glyphs.push_back({int16_t(quarters(w)), 0, uint16_t(index), color});
+        w += advance;
+      }
+
+      // the word moves to a new line if it would cross the right edge,
+      // unless it's the first on its line and would never fit
+      if(word_start > line_start && x + pending + w > bounds.w) {
+        end_line(word_start, x);
+        x = 0.0f;
+        y += line_advance;
+      } else {
+        x += pending;
+      }
+      pending = 0.0f;
+
+      int qx = quarters(x);
+      int16_t qy = std::clamp(int(floorf(y + 0.5f)), -32768, 32767);
+      for(size_t i = word_start; i < glyphs.size(); i++) {
+        glyphs[i].x = std::clamp(glyphs[i].x + qx, -32768, 32767);
+        glyphs[i].y = qy;
+      }
+      x += w;
+    }
+
+    end_line(glyphs.size(), x);
+    height = y + line_height;
+  }
+
+  void text_layout_t::draw(image_t *target) {
+    if(glyphs.empty()) {
+      return;
+    }
+
+    rect_t old_clip = target->clip();
+    target->clip(old_clip.intersection(bounds));
+    rect_t clip = target->clip();
+    if(clip.empty()) {
+      target->clip(old_clip);
+      return;
+    }
+
+    target->mark_dirty();
+
+    brush_t *pen = target->brush();
+    rgb_color_t c(255, 255, 255, 255);
+    color_brush_t escape(c);
+    uint8_t current = 0;
+
+    rect_t pixel_clip = font_t::pixel_clip(target);
+    int ox = floorf(bounds.x);
+    int oy = floorf(bounds.y + 0.5f);
+    // whole lines above or below the clip are skipped, vector glyphs are
+    // given a line's grace either side for accents and descenders
+    int line_height = _font ? (_size_key + 15) / 16 : _pixel_font->height;
+    int margin = _font ? line_height : 0;
+    int top = pixel_clip.y - oy - line_height - margin;
+    int bottom = pixel_clip.y + pixel_clip.h - oy + margin;
+
+    for(const text_glyph_t &g : glyphs) {
+      if(g.y <= top || g.y >= bottom) {
+        continue;
+      }
+
+      if(g.color != current) {
+        current = g.color;
+        if(current) {
+          uint32_t rgba = colors[current - 1];
+          escape.c = rgb_color_t(rgba & 0xff, (rgba >> 8) & 0xff, (rgba >> 16) & 0xff, rgba >> 24);
+          target->brush(&escape);
+        } else {
+          target->brush(pen);
+        }
+      }
+
+      brush_t *brush = target->brush();
+      if(!brush) {
+        continue;
+      }
+
+      if(_font) {
+        _font->draw_glyph(target, &_font->glyphs[g.index], ox + g.x / 4.0f, oy + g.y, _size_key, pixel_clip);
+      } else {
+        const pixel_font_glyph_t *glyph = &_pixel_font->glyphs[g.index];
+        _pixel_font->draw_glyph(target, glyph, _pixel_font->glyph_pixels(g.index), brush, clip, ox + g.x / 4, oy + g.y);
+      }
+    }
+
+    target->brush(pen);
+    target->clip(old_clip);
+  }
+
+}
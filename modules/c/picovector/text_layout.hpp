@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "picovector.hpp"
+#include "font.hpp"
+#include "pixel_font.hpp"
+
+namespace picovector {
+
+  enum text_align_t {
+    TEXT_ALIGN_LEFT   = 0,
+    TEXT_ALIGN_CENTER = 1,
+    TEXT_ALIGN_RIGHT  = 2
+  };
+
+  // a glyph placed by the layout, relative to the top left of its bounds
+  struct text_glyph_t {
+    int16_t x;        // in quarters of a pixel
+    int16_t y;
+    uint16_t index;   // into the font's glyphs
+    uint8_t color;    // index + 1 into the layout's colors, zero for the pen
+  };
+
+  /*
+    word wrapped text, laid out once and then drawn as often as needed.
+
+    lines break at newlines and between words that would cross the right
+    edge of the bounds. `[pen:r,g,b]` or `[pen:r,g,b,a]` anywhere in the
+    text switches the colour of the glyphs that follow it, glyphs before
+    the first escape are drawn with the target's pen.
+  */
+  class text_layout_t {
+    public:
+      rect_t bounds;
+      float width = 0.0f;   // of the longest line
+      float height = 0.0f;  // from the top of the first line to the bottom of the last
+
+      std::vector<text_glyph_t, PV_STD_ALLOCATOR<text_glyph_t>> glyphs;
+      std::vector<uint32_t, PV_STD_ALLOCATOR<uint32_t>> colors;  // r | g << 8 | b << 16 | a << 24
+
+      // exactly one of `font` or `pixel_font` is set, `size` only applies to
+      // vector fonts
+      void layout(const char *text, font_t *font, pixel_font_t *pixel_font, rect_t bounds, float size,
+                  float line_spacing, float word_spacing, text_align_t align);
+
+      // draws the text in its bounds, clipped to them
+      void draw(image_t *target);
+
+    private:
+      font_t *_font = nullptr;
+      pixel_font_t *_pixel_font = nullptr;
+      uint16_t _size_key = 0;
+  };
+
+}
@@ -0,0 +1,54 @@
+#include "text_metrics.hpp"
+
+namespace picovector {
+
+#if PV_TEXT_METRICS_ENTRIES > 0
+
+  static_assert((PV_TEXT_METRICS_ENTRIES & (PV_TEXT_METRICS_ENTRIES - 1)) == 0, "PV_TEXT_METRICS_ENTRIES must be a power of two");
+
+  struct text_metrics_entry_t {
+    const void *font;
+    uint32_t codepoint;
+    uint16_t size;
+    glyph_metrics_t metrics;
+  };
+
+  static text_metrics_entry_t text_metrics_entries[PV_TEXT_METRICS_ENTRIES];
+
+  glyph_metrics_t &text_metrics_slot(const void *font, uint32_t codepoint, uint16_t size, bool &hit) {
+    uint32_t h = uint32_t(uintptr_t(font)) >> 2;
+    h ^= codepoint * 0x9e3779b1u;
+    h ^= size * 0x85ebu;
+    h ^= h >> 16;
+
+    text_metrics_entry_t &e = text_metrics_entries[h & (PV_TEXT_METRICS_ENTRIES - 1)];
+    hit = e.font == font && e.codepoint == codepoint && e.size == size;
+    if(!hit) {
+      e.font = font;
+      e.codepoint = codepoint;
+      e.size = size;
+    }
+    return e.metrics;
+  }
+
+  void text_metrics_forget(const void *font) {
+    for(int i = 0; i < PV_TEXT_METRICS_ENTRIES; i++) {
+      if(text_metrics_entries[i].font == font) {
+        text_metrics_entries[i].font = nullptr;
+      }
+    }
+  }
+
+#else
+
+  glyph_metrics_t &text_metrics_slot(const void *font, uint32_t codepoint, uint16_t size, bool &hit) {
+    static glyph_metrics_t scratch;
+    hit = false;
+    return scratch;
+  }
+
+  void text_metrics_forget(const void *font) {}
+
+#endif
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "picovector.hpp"
+#include "types.hpp"
+
+namespace picovector {
+
+  // a glyph's advance and ink box at one size in pixels, relative to the pen
+  // at the top of the line. glyphs with no ink have x1 <= x0
+  struct glyph_metrics_t {
+    float advance;
+    float x0, y0, x1, y1;
+  };
+
+  // a string's metrics relative to the pen at the top left of the line,
+  // `advance` is the pen's travel by the line height and `ink` the box the
+  // glyphs actually cover, empty if they cover nothing
+  struct text_metrics_t {
+    rect_t advance;
+    rect_t ink;
+
+    // the whole pixels covering both boxes, the image needed to draw the
+    // text into. its top left is above or left of the pen where ink reaches
+    // past it
+    rect_t pixel_bounds() const {
+      int x0 = floorf(std::min(advance.x, ink.x));
+      int y0 = floorf(std::min(advance.y, ink.y));
+      int x1 = ceilf(std::max(advance.x + advance.w, ink.x + ink.w));
+      int y1 = ceilf(std::max(advance.y + advance.h, ink.y + ink.h));
+      return rect_t(x0, y0, x1 - x0, y1 - y0);
+    }
+  };
+
+  /*
+    glyph metrics are cached per font, codepoint and size so measuring the
+    same text again skips the glyph lookups and the walk over each glyph's
+    points or pixels.
+
+    the cache is a fixed table of PV_TEXT_METRICS_ENTRIES slots, each
+    glyph can only live in one of them and evicts whatever was there.
+  */
+
+  // the slot for a glyph, `hit` is false if it has to be measured into it
+  glyph_metrics_t &text_metrics_slot(const void *font, uint32_t codepoint, uint16_t size, bool &hit);
+
+  // drops every glyph of a font, needed before the font is freed
+  void text_metrics_forget(const void *font);
+
+  // a glyph's metrics, calling `measure()` for them on a miss
+  template<typename F>
+  const glyph_metrics_t &text_metrics_get(const void *font, uint32_t codepoint, uint16_t size, F measure) {
+    bool hit;
+    glyph_metrics_t &m = text_metrics_slot(font, codepoint, size, hit);
+    if(!hit) {
+      m = measure();
+    }
+    return m;
+  }
+
+  // accumulates glyph metrics along a line into text metrics
+  class text_metrics_builder_t {
+    public:
+      text_metrics_builder_t(float line_height) : _line_height(line_height) {}
+
+      void add(const glyph_metrics_t &m) {
+        if(m.x1 > m.x0) {
+          _x0 = std::min(_x0, _pen + m.x0);
+          _y0 = std::min(_y0, m.y0);
+          _x1 = std::max(_x1, _pen + m.x1);
+          _y1 = std::max(_y1, m.y1);
+        }
+        _pen += m.advance;
+      }
+
+      text_metrics_t result() const {
+        text_metrics_t r;
+        r.advance = rect_t(0, 0, _pen, _line_height);
+        r.ink = _x1 > _x0 ? rect_t(_x0, _y0, _x1 - _x0, _y1 - _y0) : rect_t(0, 0, 0, 0);
+        return r;
+      }
+
+    private:
+      float _line_height;
+      float _pen = 0.0f;
+      float _x0 = FLT_MAX, _y0 = FLT_MAX, _x1 = -FLT_MAX, _y1 = -FLT_MAX;
+  };
+
+}
@@ -0,0 +1,279 @@
+#include "tilemap.hpp"
+#include "blit.hpp"
+
+namespace picovector {
+
+  // cache cells that need drawing whatever the map holds
+  static constexpr uint32_t TILEMAP_STALE = 0xffffffff;
+
+  static inline int floor_div(int a, int b) {
+    return a >= 0 ? a / b : -((b - 1 - a) / b);
+  }
+
+  static inline int floor_mod(int a, int b) {
+    int m = a % b;
+    return m < 0 ? m + b : m;
+  }
+
+  static inline uint32_t map_value(const void *map, bool wide, int i) {
+    return wide ? ((const uint16_t *)map)[i] : ((const uint8_t *)map)[i];
+  }
+
+  tilemap_t::tilemap_t(image_t *tileset, int tile_w, int tile_h, bool cache)
+    : tileset(tileset), tile_w(tile_w), tile_h(tile_h), _cache_enabled(cache) {
+  }
+
+  void tilemap_t::invalidate() {
+    std::fill(_cache_values.begin(), _cache_values.end(), TILEMAP_STALE);
+  }
+
+  bool tilemap_t::tile_origin(uint32_t value, int &x, int &y) {
+    int per_row = tileset->bounds().w / tile_w;
+    uint32_t count = per_row * int(tileset->bounds().h / tile_h);
+    if(value == 0 || value > count) {
+      return false;
+    }
+
+    value--;
+    x = (value % per_row) * tile_w;
+    y = (value / per_row) * tile_h;
+    return true;
+  }
+
+  /*
+    calls `f(sx, sy, dx, dy, w)` for each visible row of each tile, working
+    down the viewport a row of pixels at a time. the tileset origin of every
+    tile in a row of the map is looked up once and only the first and last
+    tile of a row can need clipping.
+  */
+  template<typename F>
+  void tilemap_t::walk(const viewport_t &vp, const void *map, int map_w, int map_h, bool wide, int sx, int sy, F f) {
+    int tx0 = floor_div(sx, tile_w);
+    int ty0 = floor_div(sy, tile_h);
+    int ox = vp.x0 - (sx - tx0 * tile_w);
+    int oy = vp.y0 - (sy - ty0 * tile_h);
+    int cols = (vp.x1 - ox + tile_w - 1) / tile_w;
+
+    _origins.resize(cols);
+    origin_t *origins = _origins.data();
+
+    for(int ty = ty0, top = oy; top < vp.y1; ty++, top += tile_h) {
+      bool row_in_map = ty >= 0 && ty < map_h;
+      for(int c = 0; c < cols; c++) {
+        int tx = tx0 + c;
+        uint32_t value = row_in_map && tx >= 0 && tx < map_w ? map_value(map, wide, ty * map_w + tx) : 0;
+        int x, y;
+        if(tile_origin(value, x, y)) {
+          origins[c] = {int16_t(x), int16_t(y)};
+        } else {
+          origins[c] = {-1, 0};
+        }
+      }
+
+      int y0 = std::max(top, vp.y0);
+      int y1 = std::min(top + tile_h, vp.y1);
+      for(int y = y0; y < y1; y++) {
+        int line = y - top;
+        for(int c = 0; c < cols; c++) {
+          const origin_t &o = origins[c];
+          if(o.x < 0) {
+            continue;
+          }
+
+          int dx = ox + c * tile_w;
+          int x0 = dx;
+          int x1 = dx + tile_w;
+          if(c == 0 || c == cols - 1) {
+            x0 = std::max(x0, vp.x0);
+            x1 = std::min(x1, vp.x1);
+          }
+          f(o.x + x0 - dx, o.y + line, x0, y, x1 - x0);
+        }
+      }
+    }
+  }
+
+  void tilemap_t::draw_direct(image_t *target, const viewport_t &vp, const void *map, int map_w, int map_h, bool wide, int sx, int sy) {
+    // A8 tiles are coverage masks for the target's brush
+    if(tileset->pixel_format() == A8 && !tileset->has_palette()) {
+      walk(vp, map, map_w, map_h, wide, sx, sy, [&](int tsx, int tsy, int dx, int dy, int w) {
+        span_blit_mask(tileset, target, tsx, tsy, dx, dy, w);
+      });
+      return;
+    }
+
+    opacity_t opacity = tileset->alpha() == 255 ? tileset->opacity() : OPACITY_GENERAL;
+
+    // opaque tiles can be copied as-is into a target of the same format
+    if(opacity == OPACITY_OPAQUE && !tileset->has_palette() && !target->has_palette() &&
+       tileset->pixel_format() == target->pixel_format() && !tileset->shares_buffer(target)) {
+      size_t bpp = tileset->bytes_per_pixel();
+      walk(vp, map, map_w, map_h, wide, sx, sy, [&](int tsx, int tsy, int dx, int dy, int w) {
+        memcpy(target->ptr(dx, dy), tileset->ptr(tsx, tsy), w * bpp);
+      });
+      return;
+    }
+
+    blend_func_t bf = target->_blend_func;
+    blit_dispatch(tileset, target, [&](const auto &fetch, uint32_t alpha, auto *dst_type) {
+      typedef typename std::remove_pointer<decltype(dst_type)>::type T;
+      walk(vp, map, map_w, map_h, wide, sx, sy, [&](int tsx, int tsy, int dx, int dy, int w) {
+        span_blit<T>(fetch, alpha, opacity, tileset, target, bf, tsx, tsy, dx, dy, w);
+      });
+    });
+  }
+
+  /*
+    the cache is a ring buffer of tiles one larger than the viewport in each
+    direction, map cell (tx, ty) always lives in cache cell (tx mod cols,
+    ty mod rows) so scrolling only has to draw the cells coming into view.
+
+    opaque tilesets are cached in the target's pixel format so the cache can
+    be copied to the target a row at a time, anything else is cached as
+    RGBA8888 and blended. empty cells must be transparent, which only RGBA8888
+    can hold, so once one has been in view the cache stays RGBA8888 rather
+    than being rebuilt each time they scroll in and out. returns false if the
+    direct path has to be used.
+  */
+  bool tilemap_t::draw_cached(image_t *target, const viewport_t &vp, const void *map, int map_w, int map_h, bool wide, int sx, int sy) {
+    // tilesets that can change without bumping their generation can't be
+    // cached either
+    if((tileset->pixel_format() == A8 && !tileset->has_palette()) || !tileset->tracked() ||
+       target->pixel_format() == RGBA4444 || target->has_palette()) {
+      return false;
+    }
+
+    int tx0 = floor_div(sx, tile_w);
+    int ty0 = floor_div(sy, tile_h);
+    int tx1 = floor_div(sx + (vp.x1 - vp.x0) - 1, tile_w);
+    int ty1 = floor_div(sy + (vp.y1 - vp.y0) - 1, tile_h);
+
+    for(int ty = ty0; ty <= ty1 && !_has_empty; ty++) {
+      for(int tx = tx0; tx <= tx1 && !_has_empty; tx++) {
+        bool in_map = tx >= 0 && ty >= 0 && tx < map_w && ty < map_h;
+        int x, y;
+        _has_empty = !in_map || !tile_origin(map_value(map, wide, ty * map_w + tx), x, y);
+      }
+    }
+
+    opacity_t opacity = tileset->alpha() == 255 ? tileset->opacity() : OPACITY_GENERAL;
+    pixel_format_t format = opacity == OPACITY_OPAQUE && !_has_empty ? target->pixel_format() : RGBA8888;
+    int cols = (vp.x1 - vp.x0 + tile_w - 1) / tile_w + 1;
+    int rows = (vp.y1 - vp.y0 + tile_h - 1) / tile_h + 1;
+
+    if(!_cache || _cache_cols != cols || _cache_rows != rows || _cache->pixel_format() != format) {
+      _cache.reset();
+      _cache.emplace(cols * tile_w, rows * tile_h, format);
+      _cache_cols = cols;
+      _cache_rows = rows;
+      _cache_values.assign(cols * rows, TILEMAP_STALE);
+    }
+
+    if(tileset->generation() != _tileset_generation || tileset->alpha() != _tileset_alpha) {
+      invalidate();
+      _tileset_generation = tileset->generation();
+      _tileset_alpha = tileset->alpha();
+    }
+
+    image_t *cache = &*_cache;
+    bool has_empty = false;
+
+    cache->mark_dirty();
+    blit_dispatch(tileset, cache, [&](const auto &fetch, uint32_t alpha, auto *dst_type) {
+      typedef typename std::remove_pointer<decltype(dst_type)>::type T;
+      typedef typename std::remove_reference<decltype(fetch)>::type::pixel_t pixel_t;
+
+      for(int ty = ty0; ty <= ty1; ty++) {
+        for(int tx = tx0; tx <= tx1; tx++) {
+          bool in_map = tx >= 0 && ty >= 0 && tx < map_w && ty < map_h;
+          uint32_t value = in_map ? map_value(map, wide, ty * map_w + tx) : 0;
+          int x, y;
+          bool solid = tile_origin(value, x, y);
+          has_empty |= !solid;
+
+          int cx = floor_mod(tx, cols);
+          int cy = floor_mod(ty, rows);
+          uint32_t &cached = _cache_values[cy * cols + cx];
+          if(cached == value) {
+            continue;
+          }
+          cached = value;
+
+          for(int line = 0; line < tile_h; line++) {
+            T *pd = (T *)cache->ptr(cx * tile_w, cy * tile_h + line);
+            if(!solid) {
+              memset(pd, 0, tile_w * sizeof(T));
+              continue;
+            }
+
+            const pixel_t *ps = (const pixel_t *)tileset->ptr(x, y + line);
+            for(int i = 0; i < tile_w; i++) {
+              uint32_t c = fetch(ps[i]);
+              if(alpha != 255) c = _premul_mul_alpha(c, alpha);
+              _store_pixel(pd + i, c);
+            }
+          }
+        }
+      }
+    });
+
+    opacity_t cache_opacity = opacity == OPACITY_GENERAL ? OPACITY_GENERAL : (has_empty ? OPACITY_BINARY : OPACITY_OPAQUE);
+    bool copy = cache_opacity == OPACITY_OPAQUE && format == target->pixel_format();
+    size_t bpp = cache->bytes_per_pixel();
+    int cw = cols * tile_w;
+    int ch = rows * tile_h;
+    blend_func_t bf = target->_blend_func;
+
+    // the viewport wraps around the cache at most once in each direction
+    blit_dispatch(cache, target, [&](const auto &fetch, uint32_t alpha, auto *dst_type) {
+      typedef typename std::remove_pointer<decltype(dst_type)>::type T;
+      int cy = floor_mod(sy, ch);
+      for(int y = vp.y0; y < vp.y1; ) {
+        int h = std::min(vp.y1 - y, ch - cy);
+        int cx = floor_mod(sx, cw);
+        for(int x = vp.x0; x < vp.x1; ) {
+          int w = std::min(vp.x1 - x, cw - cx);
+          for(int i = 0; i < h; i++) {
+            if(copy) {
+              memcpy(target->ptr(x, y + i), cache->ptr(cx, cy + i), w * bpp);
+            } else {
+              span_blit<T>(fetch, alpha, cache_opacity, cache, target, bf, cx, cy + i, x, y + i, w);
+            }
+          }
+          x += w;
+          cx = 0;
+        }
+        y += h;
+        cy = 0;
+      }
+    });
+
+    return true;
+  }
+
+  void tilemap_t::draw(image_t *target, const void *map, int map_w, int map_h, bool wide, vec2_t scroll) {
+    if(tile_w <= 0 || tile_h <= 0 || tileset->bounds().w < tile_w || tileset->bounds().h < tile_h) {
+      return;
+    }
+
+    rect_t clip = target->clip().intersection(target->bounds());
+    viewport_t vp;
+    vp.x0 = ceilf(clip.x);
+    vp.y0 = ceilf(clip.y);
+    vp.x1 = floorf(clip.x + clip.w);
+    vp.y1 = floorf(clip.y + clip.h);
+    if(vp.x0 >= vp.x1 || vp.y0 >= vp.y1) {
+      return;
+    }
+
+    target->mark_dirty();
+
+    int sx = floorf(scroll.x);
+    int sy = floorf(scroll.y);
+    if(_cache_enabled && draw_cached(target, vp, map, map_w, map_h, wide, sx, sy)) {
+      return;
+    }
+    draw_direct(target, vp, map, map_w, map_h, wide, sx, sy);
+  }
+
+}
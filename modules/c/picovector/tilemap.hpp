@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+#include <optional>
+
+#include "image.hpp"
+
+namespace picovector {
+
+  /*
+    draws a grid of tiles cut from a tileset image.
+
+    tiles are `tile_w` by `tile_h` pixels and numbered left to right, top to
+    bottom across the tileset. map values are a tile number plus one, zero is
+    an empty cell (the same convention as Tiled).
+
+    with caching enabled the tiles behind the viewport are kept in a ring
+    buffer image between draws. only cells whose value changed, or that have
+    just scrolled into view, are redrawn into it before it's copied to the
+    target.
+  */
+  class tilemap_t {
+    public:
+      image_t *tileset;
+      int tile_w;
+      int tile_h;
+
+      tilemap_t(image_t *tileset, int tile_w, int tile_h, bool cache=false);
+
+      // `map` is `map_w` by `map_h` cells of uint8_t (or uint16_t if `wide`),
+      // `scroll` is the map pixel that lands in the top left corner of the
+      // target's clip rect
+      void draw(image_t *target, const void *map, int map_w, int map_h, bool wide, vec2_t scroll);
+
+      // forget the cached tiles, needed after changing the tileset's palette
+      void invalidate();
+
+      // where the tile for map value `value` starts in the tileset, false for
+      // empty cells
+      bool tile_origin(uint32_t value, int &x, int &y);
+
+    private:
+      // whole target pixels inside the clip rect
+      struct viewport_t {
+        int x0, y0, x1, y1;
+      };
+
+      // tileset position of each tile in the row being drawn, x < 0 if empty
+      struct origin_t {
+        int16_t x, y;
+      };
+
+      bool _cache_enabled;
+      std::optional<image_t> _cache;
+      int _cache_cols = 0;
+      int _cache_rows = 0;
+      // map value last drawn into each cache cell, or TILEMAP_STALE
+      std::vector<uint32_t, PV_STD_ALLOCATOR<uint32_t>> _cache_values;
+      uint32_t _tileset_generation = 0;
+      uint8_t _tileset_alpha = 255;
+      // set once an empty cell has been in view, see draw_cached()
+      bool _has_empty = false;
+      std::vector<origin_t, PV_STD_ALLOCATOR<origin_t>> _origins;
+
+      template<typename F>
+      void walk(const viewport_t &vp, const void *map, int map_w, int map_h, bool wide, int sx, int sy, F f);
+      bool draw_cached(image_t *target, const viewport_t &vp, const void *map, int map_w, int map_h, bool wide, int sx, int sy);
+      void draw_direct(image_t *target, const viewport_t &vp, const void *map, int map_w, int map_h, bool wide, int sx, int sy);
+  };
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace picovector {
+
+  static constexpr uint32_t UTF8_REPLACEMENT = 0xfffd;
+
+  // decodes the codepoint at `p` and moves `p` past it. malformed, overlong
+  // and surrogate sequences decode as U+FFFD one byte at a time, a sequence
+  // cut short by the terminator is malformed so `p` never passes it
+  static inline uint32_t utf8_next(const char *&p) {
+    const uint8_t *s = (const uint8_t *)p;
+    uint32_t c = s[0];
+    if(c < 0x80) {
+      p++;
+      return c;
+    }
+
+    int n;
+    uint32_t lowest;
+    if((c & 0xe0) == 0xc0) {
+      n = 1; c &= 0x1f; lowest = 0x80;
+    } else if((c & 0xf0) == 0xe0) {
+      n = 2; c &= 0x0f; lowest = 0x800;
+    } else if((c & 0xf8) == 0xf0) {
+      n = 3; c &= 0x07; lowest = 0x10000;
+    } else {
+      p++;
+      return UTF8_REPLACEMENT;
+    }
+
+    for(int i = 1; i <= n; i++) {
+      if((s[i] & 0xc0) != 0x80) {
+        p++;
+        return UTF8_REPLACEMENT;
+      }
+      c = (c << 6) | (s[i] & 0x3f);
+    }
+
+    if(c < lowest || c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff)) {
+      p++;
+      return UTF8_REPLACEMENT;
+    }
+
+    p += n + 1;
+    return c;
+  }
+
+}
@@ -1,15 +1,18 @@
 #include "st7789.hpp"
+#include "st7789_scanout.hpp"
 
 
 namespace pimoroni {
 
-  uint32_t __attribute__((section(".uninitialized_data"))) __attribute__ ((aligned (4))) framebuffer[320 * 240];
-  uint16_t __attribute__((section(".uninitialized_data"))) __attribute__ ((aligned (4))) linebuffer[240 * 4];
+  // native RGB565 framebuffer, drawn into directly by picovector
+  uint16_t __attribute__((section(".uninitialized_data"))) __attribute__ ((aligned (4))) framebuffer[320 * 240];
+  // two stripes of panel columns, one is converted while the other is DMA'd
+  uint16_t __attribute__((section(".uninitialized_data"))) __attribute__ ((aligned (4))) linebuffer[240 * SCANOUT_STRIPE_COLUMNS * 2];
 
-  // If we configure MicroPython's main.c to skip the first 320 * 240 * sizeof(uint32_t)
+  // If we configure MicroPython's main.c to skip the first 320 * 240 * sizeof(uint16_t)
   // bytes we can steal this as a backbuffer.
-  // auto backbuffer = new((uintptr_t *)XIP_PSRAM_CACHED) uint32_t[320 * 240];
-  // auto backbuffer_nocache = new((uintptr_t *)XIP_PSRAM_NOCACHE) uint32_t[320 * 240];
+  // auto backbuffer = new((uintptr_t *)XIP_PSRAM_CACHED) uint16_t[320 * 240];
+  // auto backbuffer_nocache = new((uintptr_t *)XIP_PSRAM_NOCACHE) uint16_t[320 * 240];
 
   enum MADCTL : uint8_t {
     ROW_ORDER   = 0b10000000,
@@ -137,7 +140,7 @@ namespace pimoroni {
     set_backlight(230); // Turn backlight on now surprises have passed, 180 = about half perceptual brightness
   }
 
-  uint32_t *ST7789::get_framebuffer() {
+  uint16_t *ST7789::get_framebuffer() {
     return framebuffer;
   }
 
@@ -201,39 +204,30 @@ namespace pimoroni {
     gpio_put(dc, 1); // data mode
 
     // Take an "a" and a "b" pointer into the linebuffer, we will swap between
-    // these, converting pixels into one while the other is DMA'd to the screen.
+    // these, copying a stripe of columns into one while the other is DMA'd
+    // to the screen.
     uint16_t *buf_a = linebuffer;
-    uint16_t *buf_b = linebuffer + 240 * 2;
+    uint16_t *buf_b = linebuffer + fullres_height * SCANOUT_STRIPE_COLUMNS;
 
     // The copy from framebuffer to linebuffer also serves to rotate the image
     // 90 degrees to match the scan orientation and prevent diagonal tearing.
     if(fullres) {
-      for(int x = 0; x < fullres_width; x++) {
-        for(int y = 0; y < fullres_height; y++) {
-          uint32_t src = framebuffer[y * fullres_width + x];
-          buf_a[y] = __builtin_bswap16(((src & 0xf8) << 8) | ((src & 0xfc00) >> 5) | ((src & 0xf80000) >> 19));
-        }
-        // Transfer a single full res (full 240 pixel height) column
+      for(int x = 0; x < fullres_width; x += SCANOUT_STRIPE_COLUMNS) {
+        scanout_columns(framebuffer, fullres_width, fullres_height, x, SCANOUT_STRIPE_COLUMNS, buf_a);
+        // Transfer a stripe of full res (full 240 pixel height) columns
         // In full-res we can "chase the beam" as it were, replacing pixels
         // behind the outgoing DMA transfer.
         wait_for_dma();
-        start_dma((uint8_t *)buf_a, fullres_height * 2);
+        start_dma((uint8_t *)buf_a, fullres_height * SCANOUT_STRIPE_COLUMNS * 2);
         std::swap(buf_a, buf_b);
       }
     } else {
-      for(int x = 0; x < width; x++) {
-        for(int y = 0; y < height; y++) {
-          uint32_t src = framebuffer[y * width + x];
-          uint16_t pixel = __builtin_bswap16(((src & 0xf8) << 8) | ((src & 0xfc00) >> 5) | ((src & 0xf80000) >> 19));
-          buf_a[y * 2] = pixel;
-          buf_a[y * 2 + 1] = pixel;
-          // It's slightly faster to prepare to rows, rather than prepare
-          // a single row and copy it twice.
-          buf_a[(height + y) * 2] = pixel;
-          buf_a[(height + y) * 2 + 1] = pixel;
-        }
+      // each lores column is doubled into two panel columns
+      const int stripe = SCANOUT_STRIPE_COLUMNS / 2;
+      for(int x = 0; x < width; x += stripe) {
+        scanout_columns_doubled(framebuffer, width, height, x, stripe, buf_a);
         wait_for_dma();
-        start_dma((uint8_t *)buf_a, fullres_height * 2 * 2);
+        start_dma((uint8_t *)buf_a, fullres_height * SCANOUT_STRIPE_COLUMNS * 2);
         std::swap(buf_a, buf_b);
       }
     }
@@ -108,7 +108,7 @@ namespace pimoroni {
 
     void update(bool fullres);
     void set_backlight(uint8_t brightness);
-    uint32_t *get_framebuffer();
+    uint16_t *get_framebuffer();
     void command(uint8_t command, size_t len = 0, const char *data = NULL);
     void set_max_pio_clock(uint32_t hz);
 
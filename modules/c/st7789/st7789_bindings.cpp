@@ -86,7 +86,7 @@ mp_int_t st7789_get_framebuffer(mp_obj_t self_in, mp_buffer_info_t *bufinfo, mp_
     (void)self_in;
     (void)flags;
     bufinfo->buf = display->get_framebuffer();
-    bufinfo->len = 320 * 240 * 4;
+    bufinfo->len = 320 * 240 * sizeof(uint16_t);
     bufinfo->typecode = 'B';
     return 0;
 }
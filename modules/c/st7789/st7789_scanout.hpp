@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdint.h>
+
+// Framebuffer -> display scanout.
+//
+// The framebuffer holds native RGB565 pixels stored row major, but the panel
+// is scanned column by column (to prevent diagonal tearing) so every update
+// has to rotate the image by 90 degrees and byte swap each pixel into the big
+// endian order the ST7789 expects on the wire.
+//
+// Rather than walk each framebuffer column top to bottom (one strided read
+// per pixel) these kernels transpose a vertical stripe of columns at a time.
+// Each pass reads one 32-bit word (two pixels) from a pair of rows and emits
+// one 32-bit word (two output pixels) into each of the two columns covered.
+//
+// These functions have no hardware dependencies so they can be built and
+// checked on the host.
+
+namespace pimoroni {
+
+  // number of panel columns converted (and DMA'd) in one go
+  constexpr int SCANOUT_STRIPE_COLUMNS = 8;
+
+  // swap the bytes of both 16-bit halves of a word (a single REV16 on ARM)
+  static inline __attribute__((always_inline))
+  uint32_t scanout_rev16(uint32_t v) {
+    return ((v & 0x00ff00ffu) << 8) | ((v >> 8) & 0x00ff00ffu);
+  }
+
+  // Copy `count` framebuffer columns starting at column `x` into `dst` in
+  // panel scan order, each column being `height` pixels long.
+  //
+  // - `height`, `x` and `count` must be even
+  // - `src` and `dst` must be 32-bit aligned, `dst` must hold `count * height`
+  //   pixels
+  static inline void scanout_columns(const uint16_t *src, int stride, int height, int x, int count, uint16_t *dst) {
+    uint32_t *out = (uint32_t *)dst;
+    int column_words = height >> 1;
+
+    const uint16_t *row = src + x;
+    for(int y = 0; y < column_words; y++) {
+      const uint32_t *r0 = (const uint32_t *)row;
+      const uint32_t *r1 = (const uint32_t *)(row + stride);
+      uint32_t *o = out + y;
+
+      // transpose a 2x2 block of pixels per iteration
+      for(int c = count >> 1; c > 0; c--) {
+        uint32_t a = *r0++;
+        uint32_t b = *r1++;
+        o[0]            = scanout_rev16((a & 0xffffu) | (b << 16));
+        o[column_words] = scanout_rev16((a >> 16) | (b & 0xffff0000u));
+        o += column_words * 2;
+      }
+
+      row += stride << 1;
+    }
+  }
+
+  // As scanout_columns() but for pixel doubled (lores) framebuffers. Every
+  // source pixel becomes a 2x2 block so each source column produces two
+  // identical panel columns of `height * 2` pixels.
+  //
+  // - `x` and `count` must be even
+  // - `dst` must be 32-bit aligned and hold `count * height * 4` pixels
+  static inline void scanout_columns_doubled(const uint16_t *src, int stride, int height, int x, int count, uint16_t *dst) {
+    uint32_t *out = (uint32_t *)dst;
+    // a doubled panel column is `height * 2` pixels, or `height` words
+    int column_words = height;
+
+    const uint16_t *row = src + x;
+    for(int y = 0; y < height; y++) {
+      const uint32_t *r = (const uint32_t *)row;
+      uint32_t *o = out + y;
+
+      for(int c = count >> 1; c > 0; c--) {
+        uint32_t a = *r++;
+        uint32_t p0 = a & 0xffffu;
+        uint32_t p1 = a >> 16;
+        p0 = scanout_rev16(p0 | (p0 << 16));
+        p1 = scanout_rev16(p1 | (p1 << 16));
+        o[0]                = p0;
+        o[column_words]     = p0;
+        o[column_words * 2] = p1;
+        o[column_words * 3] = p1;
+        o += column_words * 4;
+      }
+
+      row += stride;
+    }
+  }
+
+}
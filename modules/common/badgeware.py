@@ -148,6 +148,12 @@ def text_tokenise(image, text, glyph_renderers=None, size=24):
     return tokens
 
 
+# the layouts text_draw() built most recently, newest first, so text that's
+# redrawn every frame isn't laid out again each time
+_TEXT_LAYOUT_CACHE_SIZE = 4
+_text_layouts = []
+
+
 def text_draw(image, text, bounds=None, line_spacing=1, word_spacing=1, size=24):
     WORD = 1
     SPACE = 2
@@ -158,10 +164,23 @@ def text_draw(image, text, bounds=None, line_spacing=1, word_spacing=1, size=24)
     else:
         bounds = rect(int(bounds.x), int(bounds.y), int(bounds.w), int(bounds.h))
 
+    # plain strings only need [pen:r,g,b] escapes, which the native layout
+    # engine handles
     if isinstance(text, str):
-        tokens = text_tokenise(image, text, size=size)
-    else:
-        tokens = text
+        key = (text, image.font, bounds.x, bounds.y, bounds.w, bounds.h, size, line_spacing, word_spacing)
+        for i, (k, layout) in enumerate(_text_layouts):
+            if k == key:
+                del _text_layouts[i]
+                break
+        else:
+            layout = text_layout(text, image.font, bounds, size, line_spacing, word_spacing)
+            if len(_text_layouts) >= _TEXT_LAYOUT_CACHE_SIZE:
+                _text_layouts.pop()
+        _text_layouts.insert(0, (key, layout))
+        layout.draw(image)
+        return rect(0, 0, bounds.x + layout.width, bounds.y + layout.height)
+
+    tokens = text
 
     old_clip = image.clip
     image.clip = bounds
@@ -231,7 +250,7 @@ def is_dir(path):
 
 
 class SpriteSheet:
-    def __init__(self, file, columns, rows):
+    def __init__(self, file, columns, rows, compile=True):
         self.image = image.load(file)
         self.sw = int(self.image.width / columns)
         self.sh = int(self.image.height / rows)
@@ -241,12 +260,19 @@ class SpriteSheet:
             column = []
             for y in range(rows):
                 sprite = self.image.window(self.sw * x, self.sh * y, self.sw, self.sh)
+                # precompute the visible runs so drawing skips transparent pixels
+                if compile:
+                    sprite.compile()
                 column.append(sprite)
             self.sprites.append(column)
 
     def sprite(self, x, y):
         return self.sprites[x][y]
 
+    def batch(self, capacity):
+        # sprites are added by index, counting left to right then top to bottom
+        return sprite_batch(self.image, self.sw, self.sh, capacity)
+
     def animation(self, x=0, y=0, count=None, horizontal=True):
         if not count:
             count = int(self.image.width / self.sw)
@@ -438,7 +464,7 @@ def mode(mode, force=False):
     font = getattr(getattr(builtins, "screen", None), "font", None)
     brush = getattr(getattr(builtins, "screen", None), "pen", None)
     resolution = (320, 240) if mode == HIRES else (160, 120)
-    builtins.screen = image(*resolution, memoryview(display))
+    builtins.screen = image(*resolution, memoryview(display), image.RGB565)
     screen.font = font if font is not None else DEFAULT_FONT
     screen.pen = brush if brush is not None else BG
 
@@ -495,10 +521,7 @@ def scroll_text(text, font_face=None, bg=None, fg=None, target=None, speed=25, c
     target = target or screen.window(0, 0, screen.width, screen.height)
     target.font = font_face
 
-    tw, th = target.measure_text(text, font_size) if isinstance(font_face, font) else target.measure_text(text)
-
-    if is_vector_font:
-        th = font_size
+    tw, th = target.measure_text(text, font_size) if is_vector_font else target.measure_text(text)
 
     scroll_distance = tw + (0 if continuous else target.width)
 
@@ -506,6 +529,11 @@ def scroll_text(text, font_face=None, bg=None, fg=None, target=None, speed=25, c
 
     offset = vec2(0, (target.height - th) // 2)
 
+    # render the text once as a coverage mask, each frame is then just a
+    # blit of the mask with the foreground pen. the mask can start above or
+    # left of the pen if glyphs reach past it
+    strip, strip_offset = font_face.render(text, font_size) if is_vector_font else font_face.render(text)
+
     def update():
         timedelta = io.ticks - t_start
         timedelta /= 1000 / speed
@@ -518,17 +546,15 @@ def scroll_text(text, font_face=None, bg=None, fg=None, target=None, speed=25, c
         else:
             offset.x = target.width - (scroll_distance * timedelta)
 
-        target.font = font_face
         if bg is not None:
             target.pen = bg
             target.clear()
         target.pen = fg
 
-        # The "font_size" argument is ignored for vector text
-        target.text(text, offset, font_size)
+        target.blit(strip, offset + strip_offset)
 
         if continuous:
-            target.text(text, offset + vec2(tw, 0), font_size)
+            target.blit(strip, offset + strip_offset + vec2(tw, 0))
 
         return progress
 
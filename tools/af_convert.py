@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""Convert vector fonts from AF version 1 ("af!?") to version 2 ("af!2").
+
+Version 2 is the layout font.load() uses in memory: little endian, every
+table aligned to its entries and glyphs and paths linked by byte offsets
+relative to themselves, so it can be read in one go or used in place from
+romfs without copying it:
+
+    header   "af!2", flags u16, glyph count u16, path count u16,
+             reserved u16, point count u32
+    glyphs   codepoint u16, x s8, y s8, w u8, h u8, advance u8,
+             path count u8, offset to first path s32 (per glyph)
+    paths    point count u16, reserved u16, offset to first point s32
+             (per path)
+    points   x s8, y s8 (per point), unchanged from version 1
+
+Usage: af_convert.py FONT.af [FONT.af ...]
+
+Fonts are converted in place, version 2 fonts are left alone.
+"""
+
+import struct
+import sys
+
+HEADER_SIZE = 16
+GLYPH_SIZE = 12
+PATH_SIZE = 8
+POINT_SIZE = 2
+
+
+def convert(data):
+    if data[:4] == b"af!2":
+        return data
+
+    if data[:4] != b"af!?":
+        raise ValueError("not an AF font")
+
+    flags, glyph_count, path_count, point_count = struct.unpack_from(">HHHH", data, 4)
+    offset = 12
+
+    glyphs = []
+    for _ in range(glyph_count):
+        glyphs.append(struct.unpack_from(">HbbBBBB", data, offset))
+        offset += 8
+
+    count_format = ">H" if flags & 0b1 else ">B"
+    count_size = struct.calcsize(count_format)
+    path_points = []
+    for _ in range(path_count):
+        path_points.append(struct.unpack_from(count_format, data, offset)[0])
+        offset += count_size
+
+    points = data[offset:offset + point_count * POINT_SIZE]
+    if len(points) != point_count * POINT_SIZE or sum(path_points) != point_count:
+        raise ValueError("truncated AF font")
+
+    glyphs_start = HEADER_SIZE
+    paths_start = glyphs_start + glyph_count * GLYPH_SIZE
+    points_start = paths_start + path_count * PATH_SIZE
+
+    out = bytearray(b"af!2")
+    out += struct.pack("<HHHHI", flags, glyph_count, path_count, 0, point_count)
+
+    path = 0
+    for i, (codepoint, x, y, w, h, advance, paths) in enumerate(glyphs):
+        here = glyphs_start + i * GLYPH_SIZE
+        there = paths_start + path * PATH_SIZE
+        out += struct.pack("<HbbBBBBi", codepoint, x, y, w, h, advance, paths, there - here)
+        path += paths
+
+    point = 0
+    for i, count in enumerate(path_points):
+        here = paths_start + i * PATH_SIZE
+        there = points_start + point * POINT_SIZE
+        out += struct.pack("<HHi", count, 0, there - here)
+        point += count
+
+    out += points
+    return bytes(out)
+
+
+def main(paths):
+    for path in paths:
+        with open(path, "rb") as f:
+            data = f.read()
+        converted = convert(data)
+        if converted is data:
+            print(f"{path}: already version 2")
+            continue
+        with open(path, "wb") as f:
+            f.write(converted)
+        print(f"{path}: {len(data)} -> {len(converted)} bytes")
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(1)
+    main(sys.argv[1:])
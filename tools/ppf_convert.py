@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+"""Convert pixel fonts from PPF version 1 ("ppf!") to version 2 ("ppf2").
+
+Version 2 is little endian with 8 byte, 4 byte aligned glyph entries so
+pixel_font.load() can use it in place from romfs without copying it:
+
+    header   "ppf2", flags u16, width u16, height u16, reserved u16,
+             glyph count u32, name 32 bytes
+    glyphs   codepoint u32, width u16, reserved u16 (per glyph)
+    data     glyph bitmaps, unchanged from version 1
+
+With --rle the bitmaps are replaced by runs of set pixels and flag bit 0
+is set, which is much smaller for large, sparse fonts:
+
+    offsets  glyph count + 1 u32 offsets into the runs, one per glyph
+             and one for the end
+    runs     per glyph: first non-empty row u8, row count u8, then per
+             row a byte per run of (gap << 4 | length), the gap counted
+             from the end of the last run, and a zero byte
+
+Fonts only get compressed where it makes them smaller, small fonts are
+often smaller as bitmaps.
+
+Usage: ppf_convert.py [--rle] FONT.ppf [FONT.ppf ...]
+
+Fonts are converted in place, version 2 fonts are left alone unless they
+can be compressed.
+"""
+
+import struct
+import sys
+
+FLAG_RLE = 0b1
+HEADER_SIZE = 48
+
+
+def convert(data):
+    if data[:4] == b"ppf2":
+        return data
+
+    if data[:4] != b"ppf!":
+        raise ValueError("not a PPF font")
+
+    flags, count, width, height = struct.unpack_from(">HIHH", data, 4)
+    name = data[14:46]
+
+    out = bytearray(b"ppf2")
+    out += struct.pack("<HHHHI", flags & ~FLAG_RLE, width, height, 0, count)
+    out += name
+
+    offset = 46
+    for _ in range(count):
+        codepoint, glyph_width = struct.unpack_from(">IH", data, offset)
+        out += struct.pack("<IHH", codepoint, glyph_width, 0)
+        offset += 6
+
+    glyph_data_size = ((width + 7) // 8) * height
+    out += data[offset:offset + glyph_data_size * count]
+    return bytes(out)
+
+
+def glyph_runs(bitmap, bytes_per_row, height):
+    rows = []
+    for y in range(height):
+        bits = int.from_bytes(bitmap[y * bytes_per_row:(y + 1) * bytes_per_row], "big")
+        width = bytes_per_row * 8
+        runs = []
+        x = 0
+        while x < width:
+            if bits & (1 << (width - 1 - x)):
+                start = x
+                while x < width and bits & (1 << (width - 1 - x)):
+                    x += 1
+                runs.append((start, x - start))
+            else:
+                x += 1
+        rows.append(runs)
+
+    top = 0
+    while top < height and not rows[top]:
+        top += 1
+    bottom = height
+    while bottom > top and not rows[bottom - 1]:
+        bottom -= 1
+
+    out = bytearray([top, bottom - top])
+    for runs in rows[top:bottom]:
+        x = 0
+        for start, length in runs:
+            gap = start - x
+            x = start + length
+            while gap > 15:
+                out.append(0xf0)
+                gap -= 15
+            while length > 15:
+                out.append((gap << 4) | 15)
+                length -= 15
+                gap = 0
+            out.append((gap << 4) | length)
+        out.append(0)
+    return out
+
+
+def compress(data):
+    flags, width, height, _, count = struct.unpack_from("<HHHHI", data, 4)
+    if flags & FLAG_RLE:
+        return data
+
+    table_end = HEADER_SIZE + count * 8
+    bytes_per_row = (width + 7) // 8
+    glyph_data_size = bytes_per_row * height
+
+    runs = bytearray()
+    offsets = []
+    for i in range(count):
+        offsets.append(len(runs))
+        bitmap = data[table_end + i * glyph_data_size:table_end + (i + 1) * glyph_data_size]
+        runs += glyph_runs(bitmap, bytes_per_row, height)
+    offsets.append(len(runs))
+
+    out = bytearray(data[:table_end])
+    struct.pack_into("<H", out, 4, flags | FLAG_RLE)
+    out += struct.pack(f"<{count + 1}I", *offsets)
+    out += runs
+    return bytes(out) if len(out) < len(data) else data
+
+
+def main(args):
+    rle = "--rle" in args
+    paths = [arg for arg in args if arg != "--rle"]
+    for path in paths:
+        with open(path, "rb") as f:
+            data = f.read()
+        converted = convert(data)
+        if rle:
+            converted = compress(converted)
+        if converted is data:
+            print(f"{path}: unchanged")
+            continue
+        with open(path, "wb") as f:
+            f.write(converted)
+        print(f"{path}: {len(data)} -> {len(converted)} bytes")
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(1)
+    main(sys.argv[1:])
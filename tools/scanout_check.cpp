@@ -0,0 +1,119 @@
+// Host check and benchmark for the ST7789 scanout kernels.
+//
+// Builds the byte stream ST7789::update() sends to the panel for a random
+// framebuffer, once with the original per-pixel loops and once with the
+// stripe kernels in st7789_scanout.hpp, and fails unless both are bit-exact
+// for full res and pixel doubled (lores) modes. It then times each.
+//
+//   g++ -O2 -std=c++17 -Imodules/c/st7789 tools/scanout_check.cpp -o scanout_check
+//   ./scanout_check
+//
+// The original code converted RGBA8888 framebuffers, so the reference packs
+// 888 to 565 per pixel and the kernels are fed the same image as native
+// RGB565, as the screen now stores it.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "st7789_scanout.hpp"
+
+using namespace pimoroni;
+
+static const int FULLRES_WIDTH = 320;
+static const int FULLRES_HEIGHT = 240;
+static const int WIDTH = 160;
+static const int HEIGHT = 120;
+
+static uint16_t pack565(uint32_t src) {
+  return ((src & 0xf8) << 8) | ((src & 0xfc00) >> 5) | ((src & 0xf80000) >> 19);
+}
+
+// the panel stream as the per-pixel loops produced it
+static void reference(const uint32_t *framebuffer, bool fullres, std::vector<uint16_t> &stream) {
+  stream.clear();
+  uint16_t column[FULLRES_HEIGHT * 2];
+  if(fullres) {
+    for(int x = 0; x < FULLRES_WIDTH; x++) {
+      for(int y = 0; y < FULLRES_HEIGHT; y++) {
+        column[y] = __builtin_bswap16(pack565(framebuffer[y * FULLRES_WIDTH + x]));
+      }
+      stream.insert(stream.end(), column, column + FULLRES_HEIGHT);
+    }
+  } else {
+    for(int x = 0; x < WIDTH; x++) {
+      for(int y = 0; y < HEIGHT; y++) {
+        uint16_t pixel = __builtin_bswap16(pack565(framebuffer[y * WIDTH + x]));
+        column[y * 2] = pixel;
+        column[y * 2 + 1] = pixel;
+        column[(HEIGHT + y) * 2] = pixel;
+        column[(HEIGHT + y) * 2 + 1] = pixel;
+      }
+      stream.insert(stream.end(), column, column + FULLRES_HEIGHT * 2);
+    }
+  }
+}
+
+// the panel stream as ST7789::update() now produces it
+static void stripes(const uint16_t *framebuffer, bool fullres, std::vector<uint16_t> &stream) {
+  stream.clear();
+  alignas(4) uint16_t buffer[FULLRES_HEIGHT * SCANOUT_STRIPE_COLUMNS];
+  if(fullres) {
+    for(int x = 0; x < FULLRES_WIDTH; x += SCANOUT_STRIPE_COLUMNS) {
+      scanout_columns(framebuffer, FULLRES_WIDTH, FULLRES_HEIGHT, x, SCANOUT_STRIPE_COLUMNS, buffer);
+      stream.insert(stream.end(), buffer, buffer + FULLRES_HEIGHT * SCANOUT_STRIPE_COLUMNS);
+    }
+  } else {
+    const int stripe = SCANOUT_STRIPE_COLUMNS / 2;
+    for(int x = 0; x < WIDTH; x += stripe) {
+      scanout_columns_doubled(framebuffer, WIDTH, HEIGHT, x, stripe, buffer);
+      stream.insert(stream.end(), buffer, buffer + FULLRES_HEIGHT * SCANOUT_STRIPE_COLUMNS);
+    }
+  }
+}
+
+template<typename F>
+static double time_us(F f) {
+  const int runs = 200;
+  auto start = std::chrono::steady_clock::now();
+  for(int i = 0; i < runs; i++) f();
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / runs;
+}
+
+int main() {
+  srand(1);
+  int failed = 0;
+
+  for(bool fullres : {true, false}) {
+    int w = fullres ? FULLRES_WIDTH : WIDTH;
+    int h = fullres ? FULLRES_HEIGHT : HEIGHT;
+
+    std::vector<uint32_t> rgba(w * h);
+    std::vector<uint16_t> rgb565(w * h);
+    for(int i = 0; i < w * h; i++) {
+      rgba[i] = uint32_t(rand()) ^ (uint32_t(rand()) << 16);
+      rgb565[i] = pack565(rgba[i]);
+    }
+
+    std::vector<uint16_t> expected, actual;
+    reference(rgba.data(), fullres, expected);
+    stripes(rgb565.data(), fullres, actual);
+
+    const char *mode = fullres ? "fullres" : "lores";
+    if(expected != actual) {
+      size_t i = 0;
+      while(i < expected.size() && i < actual.size() && expected[i] == actual[i]) i++;
+      printf("%s: FAIL, streams differ at pixel %zu (%zu vs %zu pixels)\n", mode, i, expected.size(), actual.size());
+      failed++;
+      continue;
+    }
+
+    double per_pixel = time_us([&] { reference(rgba.data(), fullres, expected); });
+    double striped = time_us([&] { stripes(rgb565.data(), fullres, actual); });
+    printf("%s: ok, per pixel %.1fus, stripes %.1fus\n", mode, per_pixel, striped);
+  }
+
+  return failed ? 1 : 0;
+}